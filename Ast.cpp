@@ -0,0 +1,63 @@
+#include "Ast.h"
+#include "StringInterner.h"
+
+using namespace std;
+
+static const char* const AST_KIND_NAMES[AST_KIND_COUNT] = {
+    "Program",
+    "Decl",
+    "Block",
+    "Assign",
+    "If",
+    "While",
+    "Binary",
+    "VarRef",
+    "ArrayRef",
+    "NumLit",
+    "error",
+};
+
+const char* astKindName(AstKind kind) {
+    return kind < AST_KIND_COUNT ? AST_KIND_NAMES[kind] : "?";
+}
+
+void astLabel(const AstNode* node, const StringInterner& symbols, string& out) {
+    out = astKindName(node->kind);
+    switch (node->kind) {
+        case AST_PROGRAM:
+            out += ": ";
+            out += symbols.str(static_cast<const AstProgram*>(node)->name);
+            break;
+        case AST_DECL: {
+            const AstDecl* d = static_cast<const AstDecl*>(node);
+            out += ": ";
+            out += tokenName(static_cast<TokenType>(d->type));
+            out += ' ';
+            out += symbols.str(d->name);
+            if (d->isArray) {
+                out += '[';
+                out += symbols.str(d->size);
+                out += ']';
+            }
+            break;
+        }
+        case AST_BINARY:
+            out += ": ";
+            out += tokenName(static_cast<TokenType>(static_cast<const AstBinary*>(node)->op));
+            break;
+        case AST_VAR_REF:
+            out += ": ";
+            out += symbols.str(static_cast<const AstVarRef*>(node)->name);
+            break;
+        case AST_ARRAY_REF:
+            out += ": ";
+            out += symbols.str(static_cast<const AstArrayRef*>(node)->name);
+            break;
+        case AST_NUM_LIT:
+            out += ": ";
+            out += symbols.str(static_cast<const AstNumLit*>(node)->text);
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,182 @@
+#ifndef AST_H
+#define AST_H
+
+#include "ParseTree.h"
+#include <cstdint>
+#include <string>
+
+/*
+ * Abstract syntax tree built directly by Parser::parseAst().
+ *
+ * Only what later passes need is kept: the ' rules, epsilons, wrapper
+ * nonterminals and punctuation of the concrete tree are gone. Each kind has
+ * its own struct with named fields; the kind tag tells which one a node is.
+ * Statements and declarations form lists through next. Names and numerals
+ * are symbols of the parser's StringInterner, and every node records the
+ * source line of its first token.
+ *
+ * Nodes live in the parser's NodeArena, like parse tree nodes.
+ */
+
+enum AstKind : uint8_t {
+    AST_PROGRAM,
+    AST_DECL,
+    AST_BLOCK,
+    AST_ASSIGN,
+    AST_IF,
+    AST_WHILE,
+    AST_BINARY,
+    AST_VAR_REF,
+    AST_ARRAY_REF,
+    AST_NUM_LIT,
+    AST_ERROR,          // A statement or declaration skipped by error recovery
+    AST_KIND_COUNT
+};
+
+class StringInterner;
+
+// Display name of a kind: "Program", "Decl", "Binary", ...
+const char* astKindName(AstKind kind);
+
+struct AstNode {
+    AstKind kind;
+    uint32_t line;
+    AstNode* next;          // Next declaration or statement in a list
+
+    AstNode(AstKind k, uint32_t l) : kind(k), line(l), next(nullptr) {}
+};
+
+// Program ID { decls body } .
+struct AstProgram : AstNode {
+    uint32_t name;
+    AstNode* decls;         // AstDecl list
+    AstNode* body;          // Statement list
+
+    AstProgram(uint32_t l, uint32_t n) : AstNode(AST_PROGRAM, l), name(n), decls(nullptr), body(nullptr) {}
+};
+
+// int x;  float a[10];
+struct AstDecl : AstNode {
+    uint16_t type;          // TokenType: INT or FLOAT
+    bool isArray;
+    uint32_t name;
+    uint32_t size;          // Numeral of the array size, arrays only
+
+    AstDecl(uint32_t l, TokenType t, uint32_t n)
+        : AstNode(AST_DECL, l), type(static_cast<uint16_t>(t)), isArray(false), name(n), size(0) {}
+};
+
+// { body }
+struct AstBlock : AstNode {
+    AstNode* body;
+
+    explicit AstBlock(uint32_t l) : AstNode(AST_BLOCK, l), body(nullptr) {}
+};
+
+// target = value
+struct AstAssign : AstNode {
+    AstNode* target;        // AstVarRef or AstArrayRef
+    AstNode* value;
+
+    AstAssign(uint32_t l, AstNode* t, AstNode* v) : AstNode(AST_ASSIGN, l), target(t), value(v) {}
+};
+
+// if (cond) thenStmt else elseStmt
+struct AstIf : AstNode {
+    AstNode* cond;
+    AstNode* thenStmt;
+    AstNode* elseStmt;      // nullptr without else
+
+    AstIf(uint32_t l, AstNode* c, AstNode* t, AstNode* e)
+        : AstNode(AST_IF, l), cond(c), thenStmt(t), elseStmt(e) {}
+};
+
+// while (cond) body
+struct AstWhile : AstNode {
+    AstNode* cond;
+    AstNode* body;
+
+    AstWhile(uint32_t l, AstNode* c, AstNode* b) : AstNode(AST_WHILE, l), cond(c), body(b) {}
+};
+
+// left op right, op one of + - * / < <= > >= == !=
+struct AstBinary : AstNode {
+    uint16_t op;            // TokenType of the operator
+    AstNode* left;
+    AstNode* right;
+
+    AstBinary(uint32_t l, TokenType o, AstNode* lhs, AstNode* rhs)
+        : AstNode(AST_BINARY, l), op(static_cast<uint16_t>(o)), left(lhs), right(rhs) {}
+};
+
+struct AstVarRef : AstNode {
+    uint32_t name;
+
+    AstVarRef(uint32_t l, uint32_t n) : AstNode(AST_VAR_REF, l), name(n) {}
+};
+
+// name[index]
+struct AstArrayRef : AstNode {
+    uint32_t name;
+    AstNode* index;
+
+    AstArrayRef(uint32_t l, uint32_t n, AstNode* i) : AstNode(AST_ARRAY_REF, l), name(n), index(i) {}
+};
+
+struct AstNumLit : AstNode {
+    uint32_t text;          // Interned numeral as written
+
+    AstNumLit(uint32_t l, uint32_t t) : AstNode(AST_NUM_LIT, l), text(t) {}
+};
+
+struct AstError : AstNode {
+    explicit AstError(uint32_t l) : AstNode(AST_ERROR, l) {}
+};
+
+// Label shown for a node: the kind name and the operator, name, numeral
+// or declaration it carries ("Binary: +", "Decl: int a[10]"). Written into
+// out, so one string can be reused for every node.
+void astLabel(const AstNode* node, const StringInterner& symbols, std::string& out);
+
+// Call f(child) for each child of node in source order. List members
+// (declarations, statements) are children of the node owning the list.
+template <typename F>
+void forEachAstChild(const AstNode* node, F f) {
+    switch (node->kind) {
+        case AST_PROGRAM: {
+            const AstProgram* p = static_cast<const AstProgram*>(node);
+            for (const AstNode* d = p->decls; d; d = d->next) f(d);
+            for (const AstNode* s = p->body; s; s = s->next) f(s);
+            break;
+        }
+        case AST_BLOCK:
+            for (const AstNode* s = static_cast<const AstBlock*>(node)->body; s; s = s->next) f(s);
+            break;
+        case AST_ASSIGN:
+            f(static_cast<const AstAssign*>(node)->target);
+            f(static_cast<const AstAssign*>(node)->value);
+            break;
+        case AST_IF: {
+            const AstIf* i = static_cast<const AstIf*>(node);
+            f(i->cond);
+            f(i->thenStmt);
+            if (i->elseStmt) f(i->elseStmt);
+            break;
+        }
+        case AST_WHILE:
+            f(static_cast<const AstWhile*>(node)->cond);
+            f(static_cast<const AstWhile*>(node)->body);
+            break;
+        case AST_BINARY:
+            f(static_cast<const AstBinary*>(node)->left);
+            f(static_cast<const AstBinary*>(node)->right);
+            break;
+        case AST_ARRAY_REF:
+            f(static_cast<const AstArrayRef*>(node)->index);
+            break;
+        default:
+            break;
+    }
+}
+
+#endif /* AST_H */
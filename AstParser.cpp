@@ -0,0 +1,308 @@
+// Direct AST construction: the Parser members that build an AST (Ast.h)
+// while parsing, in place of the concrete tree built in Parser.cpp. The
+// rules are the same; ' rules become loops that fold their elements into
+// left-associative AstBinary nodes or next-linked lists.
+
+#include "Parser.h"
+
+using namespace std;
+
+AstNode* Parser::parseAst() {
+    if (tokens) {
+        currentToken = tokens->type(0);
+        currentLexeme = tokens->lexeme(0);
+    } else {
+        nextToken();
+    }
+    AstNode* tree = astProgram();
+
+    if (hasError && !recovering()) {
+        return nullptr;
+    }
+
+    if (currentToken != ENDOFFILE) {
+        reportError("Expected end of file but found '" + std::string(currentLexeme) + "'");
+        if (!recovering()) {
+            return nullptr;
+        }
+        skipTo(0, nullptr);
+    }
+
+    return tree;
+}
+
+// Recover inside a list of the AST: skip to sync and stand in for the
+// broken element with an error node. Returns nullptr when recovery is off.
+AstNode* Parser::astRecover(TokenSet sync) {
+    if (!recovering()) {
+        return nullptr;
+    }
+    AstNode* error = arena.create<AstError>(tokenLine());
+    skipTo(sync, nullptr);
+    return error;
+}
+
+// Counterpart of expect(): a missing fixed token is assumed present when
+// recovering
+bool Parser::astExpect(TokenType expected) {
+    return skip(expected) || recovering();
+}
+
+// program ::= Program ID "{" declaration-list statement-list "}" "."
+AstNode* Parser::astProgram() {
+    STATS_RULE(counters);
+    uint32_t line = tokenLine();
+    if (!astExpect(PROGRAM)) return nullptr;
+
+    uint32_t name;
+    if (match(ID)) {
+        name = take();
+    } else {
+        reportMissing(ID);
+        if (!recovering()) return nullptr;
+        name = symbols.intern("");
+    }
+    if (!astExpect(LBRACE)) return nullptr;
+
+    auto program = arena.create<AstProgram>(line, name);
+    if (!astDeclarationList(program->decls)) return nullptr;
+    if (!astStatementList(program->body)) return nullptr;
+
+    if (!astExpect(RBRACE)) return nullptr;
+    if (!astExpect(DOT)) return nullptr;
+
+    return program;
+}
+
+// declaration-list ::= declaration declaration-list'
+// declaration-list' ::= declaration declaration-list' | empty
+bool Parser::astDeclarationList(AstNode*& head) {
+    STATS_RULE(counters);
+    AstNode** link = &head;
+    do {
+        AstNode* decl = astDeclaration();
+        if (!decl) {
+            decl = astRecover(DECLARATION_SYNC);
+            if (!decl) return false;
+            if (match(SEMI)) nextToken();
+        }
+        *link = decl;
+        link = &decl->next;
+    } while (match(INT) || match(FLOAT));
+
+    return true;
+}
+
+// declaration ::= type-specifier ID var-declaration'
+// var-declaration' ::= ";" | "[" NUM "]" ";"
+AstNode* Parser::astDeclaration() {
+    STATS_RULE(counters);
+    uint32_t line = tokenLine();
+    TokenType type = currentToken;
+    if (!match(INT) && !match(FLOAT)) {
+        reportError("Expected 'int' or 'float'");
+        return nullptr;
+    }
+    nextToken();
+
+    if (!match(ID)) {
+        reportMissing(ID);
+        return nullptr;
+    }
+    auto decl = arena.create<AstDecl>(line, type, take());
+
+    if (match(LBRACKET)) {
+        nextToken();
+        if (!match(NUM)) {
+            reportMissing(NUM);
+            return nullptr;
+        }
+        decl->isArray = true;
+        decl->size = take();
+        if (!skip(RBRACKET)) return nullptr;
+    } else if (!match(SEMI)) {
+        reportError("Expected ';' or '[' in variable declaration");
+        return nullptr;
+    }
+    if (!skip(SEMI)) return nullptr;
+
+    return decl;
+}
+
+// statement-list ::= statement-list'
+// statement-list' ::= statement statement-list' | empty
+bool Parser::astStatementList(AstNode*& head) {
+    STATS_RULE(counters);
+    AstNode** link = &head;
+    for (;;) {
+        AstNode* stmt;
+        if (match(ID) || match(IF) || match(WHILE) || match(LBRACE)) {
+            stmt = astStatement();
+            if (!stmt) {
+                stmt = astRecover(STATEMENT_SYNC);
+                if (!stmt) return false;
+            }
+        } else if (recovering() && !match(RBRACE) && !match(ENDOFFILE)) {
+            // Same as parseStatementListPrime()
+            reportMissing(RBRACE);
+            stmt = astRecover(STATEMENT_SYNC);
+        } else {
+            break;
+        }
+        *link = stmt;
+        link = &stmt->next;
+    }
+
+    return true;
+}
+
+// statement ::= assignment-stmt | compound-stmt | selection-stmt | iteration-stmt
+AstNode* Parser::astStatement() {
+    STATS_RULE(counters);
+    if (match(ID)) {
+        return astAssignmentStmt();
+    } else if (match(LBRACE)) {
+        return astCompoundStmt();
+    } else if (match(IF)) {
+        return astSelectionStmt();
+    } else if (match(WHILE)) {
+        return astIterationStmt();
+    }
+    reportError("Expected statement");
+    return nullptr;
+}
+
+// compound-stmt ::= "{" statement-list "}"
+AstNode* Parser::astCompoundStmt() {
+    STATS_RULE(counters);
+    auto block = arena.create<AstBlock>(tokenLine());
+    if (!skip(LBRACE)) return nullptr;
+    if (!astStatementList(block->body)) return nullptr;
+    if (!astExpect(RBRACE)) return nullptr;
+    return block;
+}
+
+// selection-stmt ::= if "(" expression ")" statement selection-stmt'
+// selection-stmt' ::= empty | else statement
+AstNode* Parser::astSelectionStmt() {
+    STATS_RULE(counters);
+    uint32_t line = tokenLine();
+    if (!skip(IF)) return nullptr;
+    if (!skip(LPAREN)) return nullptr;
+
+    AstNode* cond = astExpression();
+    if (!cond) return nullptr;
+    if (!skip(RPAREN)) return nullptr;
+
+    AstNode* thenStmt = astStatement();
+    if (!thenStmt) return nullptr;
+
+    AstNode* elseStmt = nullptr;
+    if (match(ELSE)) {
+        nextToken();
+        elseStmt = astStatement();
+        if (!elseStmt) return nullptr;
+    }
+
+    return arena.create<AstIf>(line, cond, thenStmt, elseStmt);
+}
+
+// iteration-stmt ::= while "(" expression ")" statement
+AstNode* Parser::astIterationStmt() {
+    STATS_RULE(counters);
+    uint32_t line = tokenLine();
+    if (!skip(WHILE)) return nullptr;
+    if (!skip(LPAREN)) return nullptr;
+
+    AstNode* cond = astExpression();
+    if (!cond) return nullptr;
+    if (!skip(RPAREN)) return nullptr;
+
+    AstNode* body = astStatement();
+    if (!body) return nullptr;
+
+    return arena.create<AstWhile>(line, cond, body);
+}
+
+// assignment-stmt ::= var "=" expression
+AstNode* Parser::astAssignmentStmt() {
+    STATS_RULE(counters);
+    AstNode* target = astVar();
+    if (!target) return nullptr;
+    if (!skip(ASSIGN)) return nullptr;
+
+    AstNode* value = astExpression();
+    if (!value) return nullptr;
+
+    return arena.create<AstAssign>(target->line, target, value);
+}
+
+// var ::= ID var'
+// var' ::= empty | "[" expression "]"
+AstNode* Parser::astVar() {
+    STATS_RULE(counters);
+    uint32_t line = tokenLine();
+    if (!match(ID)) {
+        reportMissing(ID);
+        return nullptr;
+    }
+    uint32_t name = take();
+
+    if (!match(LBRACKET)) {
+        return arena.create<AstVarRef>(line, name);
+    }
+    nextToken();
+    AstNode* index = astExpression();
+    if (!index) return nullptr;
+    if (!skip(RBRACKET)) return nullptr;
+
+    return arena.create<AstArrayRef>(line, name, index);
+}
+
+// expression ::= additive-expression expression'
+// expression' ::= relop additive-expression expression' | empty
+AstNode* Parser::astExpression() {
+    return astBinary(1);
+}
+
+// additive-expression and term (and expression, from minPower 1) by
+// precedence climbing: each operator binding at least minPower is folded
+// into a left-associative AstBinary, and its right operand only takes
+// tighter operators. Recursion depth is bounded by the number of levels,
+// not by the length of a chain.
+AstNode* Parser::astBinary(unsigned minPower) {
+    STATS_RULE(counters);
+    AstNode* left = astFactor();
+    if (!left) return nullptr;
+
+    for (unsigned power = bindingPower(currentToken); power >= minPower && power > 0;
+         power = bindingPower(currentToken)) {
+        TokenType op = currentToken;
+        nextToken();
+        AstNode* right = astBinary(power + 1);
+        if (!right) return nullptr;
+        left = arena.create<AstBinary>(left->line, op, left, right);
+    }
+
+    return left;
+}
+
+// factor ::= "(" expression ")" | var | NUM
+AstNode* Parser::astFactor() {
+    STATS_RULE(counters);
+    if (match(LPAREN)) {
+        nextToken();
+        AstNode* expr = astExpression();
+        if (!expr) return nullptr;
+        if (!skip(RPAREN)) return nullptr;
+        return expr;
+    } else if (match(ID)) {
+        return astVar();
+    } else if (match(NUM)) {
+        uint32_t line = tokenLine();
+        return arena.create<AstNumLit>(line, take());
+    }
+
+    reportError("Expected '(', identifier, or number");
+    return nullptr;
+}
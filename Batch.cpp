@@ -0,0 +1,138 @@
+#include "Batch.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+using namespace std;
+
+static BatchResult parseOneFile(const string& path, const ParserOptions& options, bool useMmap,
+                                ParseCache* cache) {
+    BatchResult result;
+    result.file = path;
+    result.ok = false;
+    result.cached = false;
+
+    SourceFile source;
+    if (!source.open(path, useMmap)) {
+        result.message = "Cannot open file";
+        return result;
+    }
+
+    // The cache needs the whole text to hash it, so streamed input is read
+    // into memory first
+    InputBuffer streamed;
+    const InputBuffer* input = source.isMapped() ? &source.buffer() : nullptr;
+    uint64_t key = 0;
+    if (cache) {
+        if (!input) {
+            if (!streamed.readStream(source.file())) {
+                result.message = "Cannot read file";
+                return result;
+            }
+            input = &streamed;
+        }
+        key = cache->key(input->data(), input->size(), options);
+
+        CachedResult hit;
+        if (cache->lookup(key, input->size(), hit)) {
+            result.ok = hit.ok;
+            result.message = hit.message;
+            result.cached = true;
+            return result;
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    unique_ptr<Parser> parserPtr(input ? new Parser(*input, options)
+                                       : new Parser(source.file(), options));
+    Parser& parser = *parserPtr;
+    parser.getLexer()->setPrintErrors(false);
+    // Only a cache that keeps trees needs one built; otherwise recognizing
+    // the input gives the same result and diagnostics
+    ParseTreeNode* tree = nullptr;
+    bool valid;
+    if (cache && cache->storesTrees()) {
+        tree = parser.parse();
+        valid = tree && !parser.hadError();
+    } else {
+        valid = parser.check();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (!valid) {
+        result.message = parser.getLexer()->errorMessage();
+        for (const Diagnostic& d : parser.getDiagnostics()) {
+            if (!result.message.empty()) {
+                result.message += "; ";
+            }
+            result.message += d.message;
+        }
+    } else {
+        result.ok = true;
+    }
+
+    if (cache) {
+        cache->store(key, input->size(), result.ok, result.message, seconds, tree, &parser.getSymbols());
+    }
+    return result;
+}
+
+vector<BatchResult> parseBatch(const vector<string>& files, const ParserOptions& options,
+                               unsigned jobs, bool useMmap, ParseCache* cache) {
+    vector<BatchResult> results(files.size());
+    WorkStealingPool pool(jobs);
+    pool.run(files.size(), [&](size_t index, unsigned) {
+        results[index] = parseOneFile(files[index], options, useMmap, cache);
+    });
+    return results;
+}
+
+bool readFileList(const string& listFile, vector<string>& files) {
+    ifstream in(listFile);
+    if (!in.is_open()) {
+        return false;
+    }
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+        if (!line.empty()) {
+            files.push_back(line);
+        }
+    }
+    return true;
+}
+
+int runBatch(const vector<string>& files, const ParserOptions& options, unsigned jobs, bool useMmap,
+             ParseCache* cache) {
+    unsigned threads = jobs == 0 ? WorkStealingPool::hardwareThreads() : jobs;
+
+    auto start = chrono::steady_clock::now();
+    vector<BatchResult> results = parseBatch(files, options, threads, useMmap, cache);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t failed = 0;
+    for (const auto& r : results) {
+        if (r.ok) {
+            cout << "OK    " << r.file << "\n";
+        } else {
+            cout << "FAIL  " << r.file << ": " << r.message << "\n";
+            failed++;
+        }
+    }
+
+    cout << "\n" << files.size() << " files parsed with " << threads << " threads in "
+         << seconds << " s: " << (files.size() - failed) << " ok, " << failed << " failed\n";
+
+    if (cache) {
+        cout << "Parse cache: " << cache->hits() << " hits, " << cache->misses() << " misses, "
+             << cache->savedSeconds() << " s of parsing skipped\n";
+        cache->trim();
+    }
+
+    return failed == 0 ? 0 : 1;
+}
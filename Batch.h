@@ -0,0 +1,34 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "Parser.h"
+#include "ParseCache.h"
+#include <string>
+#include <vector>
+
+/* Outcome of parsing one file in batch mode */
+struct BatchResult {
+    std::string file;
+    bool ok;
+    std::string message;    // Error text when !ok
+    bool cached;            // Result came from the parse cache
+};
+
+// Parse every file on a work-stealing thread pool (jobs == 0: one thread
+// per hardware thread), memory-mapping inputs when useMmap is set. With a
+// cache, inputs whose content was parsed before are not parsed again.
+// Returns one result per file, in input order.
+std::vector<BatchResult> parseBatch(const std::vector<std::string>& files,
+                                    const ParserOptions& options, unsigned jobs, bool useMmap,
+                                    ParseCache* cache = nullptr);
+
+// Read a file list: one path per line, blank lines ignored
+bool readFileList(const std::string& listFile, std::vector<std::string>& files);
+
+// Run batch mode and print a status line per file plus a summary (and the
+// cache counters when a cache is used, which is trimmed afterwards).
+// Returns the process exit code (0 when every file parsed).
+int runBatch(const std::vector<std::string>& files, const ParserOptions& options,
+             unsigned jobs, bool useMmap, ParseCache* cache = nullptr);
+
+#endif /* BATCH_H */
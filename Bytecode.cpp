@@ -0,0 +1,547 @@
+#include "Bytecode.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+
+static const char* const OPCODE_NAMES[] = {
+    "mov",  "i2f",  "f2i",  "addi", "subi", "muli", "divi", "addf", "subf", "mulf", "divf",
+    "lti",  "lei",  "gti",  "gei",  "eqi",  "nei",  "ltf",  "lef",  "gtf",  "gef",  "eqf",
+    "nef",  "load", "store", "jmp", "jz",   "jnz",  "jlti", "jlei", "jgti", "jgei", "jeqi",
+    "jnei", "jltf", "jlef", "jgtf", "jgef", "jeqf", "jnef", "halt"};
+static_assert(sizeof(OPCODE_NAMES) / sizeof(OPCODE_NAMES[0]) == OP_COUNT, "one name per opcode");
+
+const char* opcodeName(Opcode op) {
+    return op < OP_COUNT ? OPCODE_NAMES[op] : "?";
+}
+
+// Operands of an opcode that name registers, as bits 1 (a), 2 (b) and 4 (c)
+static unsigned registerOperands(uint32_t op) {
+    switch (op) {
+        case OP_MOV:
+        case OP_I2F:
+        case OP_F2I:
+            return 1 | 2;
+        case OP_LOAD:
+            return 1 | 4;
+        case OP_STORE:
+            return 2 | 4;
+        case OP_JMP:
+        case OP_HALT:
+            return 0;
+        case OP_JZ:
+        case OP_JNZ:
+            return 1;
+        default:
+            return op >= OP_JLTI ? 1 | 2 : 1 | 2 | 4;
+    }
+}
+
+// The operand holding an opcode's jump target
+static uint32_t& jumpTarget(Instruction& instruction) {
+    switch (instruction.op) {
+        case OP_JMP:
+            return instruction.a;
+        case OP_JZ:
+        case OP_JNZ:
+            return instruction.b;
+        default:
+            return instruction.c;
+    }
+}
+
+void BytecodeProgram::clear() {
+    code.clear();
+    tokens.clear();
+    constants.clear();
+    variables.clear();
+    arrays.clear();
+    constantBase = 0;
+    registerCount = 0;
+    arrayElements = 0;
+}
+
+void BytecodeProgram::disassemble(ostream& out) const {
+    char line[96];
+    for (size_t i = 0; i < code.size(); i++) {
+        const Instruction& in = code[i];
+        unsigned regs = registerOperands(in.op);
+        uint32_t operands[3] = {in.a, in.b, in.c};
+        int n = snprintf(line, sizeof(line), "%6zu  %-6s", i, opcodeName(static_cast<Opcode>(in.op)));
+        for (unsigned k = 0; k < 3; k++) {
+            bool isJump = (in.op == OP_JMP && k == 0) || ((in.op == OP_JZ || in.op == OP_JNZ) && k == 1) ||
+                          (in.op >= OP_JLTI && in.op <= OP_JNEF && k == 2);
+            bool isArray = (in.op == OP_LOAD && k == 1) || (in.op == OP_STORE && k == 0);
+            const char* prefix = (regs & (1u << k)) ? " r" : isJump ? " @" : isArray ? " array" : nullptr;
+            if (prefix) {
+                n += snprintf(line + n, sizeof(line) - n, "%s%u", prefix, operands[k]);
+            }
+        }
+        out << line << '\n';
+    }
+}
+
+// Visit the elements of a list rule in order, whether it is built as a
+// chain of ' nodes ending in epsilon or flattened into the owner
+template <typename Visit>
+static void forEachElement(const FlatTree& tree, uint32_t owner, RuleId primeRule, Visit visit) {
+    uint32_t child = tree.firstChild(owner);
+    while (child != FlatTree::NO_NODE) {
+        if (tree.kind(child) == NODE_NONTERMINAL && tree.rule(child) == primeRule) {
+            // The ' node is the last child, holding the rest of the list
+            child = tree.firstChild(child);
+            continue;
+        }
+        if (tree.kind(child) != NODE_EPSILON) {
+            visit(child);
+        }
+        child = tree.nextSibling(child);
+    }
+}
+
+static RuleId primeRule(RuleId rule) {
+    switch (rule) {
+        case RULE_EXPRESSION:          return RULE_EXPRESSION_PRIME;
+        case RULE_ADDITIVE_EXPRESSION: return RULE_ADDITIVE_EXPRESSION_PRIME;
+        default:                       return RULE_TERM_PRIME;
+    }
+}
+
+// Opcode of an operator token for int operands; the float opcode follows
+// at a fixed distance
+static Opcode intOpcode(TokenType op) {
+    switch (op) {
+        case PLUS:   return OP_ADDI;
+        case MINUS:  return OP_SUBI;
+        case TIMES:  return OP_MULI;
+        case DIVIDE: return OP_DIVI;
+        case LT:     return OP_LTI;
+        case LTE:    return OP_LEI;
+        case GT:     return OP_GTI;
+        case GTE:    return OP_GEI;
+        case EQ:     return OP_EQI;
+        default:     return OP_NEI;
+    }
+}
+
+static Opcode floatOpcode(Opcode intOp) {
+    return static_cast<Opcode>(intOp + (intOp <= OP_DIVI ? OP_ADDF - OP_ADDI : OP_LTF - OP_LTI));
+}
+
+static bool isComparison(Opcode op) {
+    return op >= OP_LTI && op <= OP_NEI;
+}
+
+// Compare-and-branch for an int comparison, and the one taken when it is
+// false (exact for ints; float comparisons are not negated, for NaN)
+static Opcode branchOpcode(Opcode compare) {
+    return static_cast<Opcode>(OP_JLTI + (compare - OP_LTI));
+}
+
+static Opcode negatedBranch(Opcode compare) {
+    static const Opcode NEGATED[] = {OP_JGEI, OP_JGTI, OP_JLEI, OP_JLTI, OP_JNEI, OP_JEQI};
+    return NEGATED[compare - OP_LTI];
+}
+
+// Arrays may hold this many elements in all (2 GB)
+static const uint64_t MAX_ARRAY_ELEMENTS = 1u << 28;
+
+void BytecodeCompiler::report(uint32_t token, const string& message) {
+    Diagnostic d;
+    d.line = 0;
+    d.col = 0;
+    ostringstream oss;
+    oss << "SEMANTIC ERROR";
+    if (tokens && token < tokens->size()) {
+        tokens->position(token, d.line, d.col);
+        oss << " at Line " << d.line << ", Col " << d.col;
+    }
+    oss << ": " << message;
+    d.message = oss.str();
+    diagnostics.push_back(d);
+}
+
+uint32_t BytecodeCompiler::emit(Opcode op, uint32_t a, uint32_t b, uint32_t c) {
+    out->code.push_back(Instruction{op, a, b, c});
+    out->tokens.push_back(source);
+    return static_cast<uint32_t>(out->code.size() - 1);
+}
+
+uint32_t BytecodeCompiler::temp() {
+    uint32_t reg = TEMP_TAG | nextTemp++;
+    maxTemps = max(maxTemps, nextTemp);
+    return reg;
+}
+
+uint32_t BytecodeCompiler::constant(ValueType type, Value value) {
+    uint32_t reg = CONSTANT_TAG | static_cast<uint32_t>(out->constants.size());
+    if (type == TYPE_INT) {
+        auto result = intConstants.emplace(value.i, reg);
+        if (!result.second) {
+            return result.first->second;
+        }
+    } else {
+        uint64_t bits;
+        memcpy(&bits, &value.f, sizeof(bits));
+        auto result = floatConstants.emplace(bits, reg);
+        if (!result.second) {
+            return result.first->second;
+        }
+    }
+    out->constants.push_back(value);
+    return reg;
+}
+
+// A NUM is an int if it is all digits and fits in 64 bits, otherwise a
+// float
+BytecodeCompiler::Operand BytecodeCompiler::literal(uint32_t node) {
+    string text(symbols->str(tree->symbol(node)));
+    Value value;
+    if (text.find_first_not_of("0123456789") == string::npos) {
+        errno = 0;
+        value.i = strtoll(text.c_str(), nullptr, 10);
+        if (errno == 0) {
+            return Operand{constant(TYPE_INT, value), TYPE_INT};
+        }
+    }
+    value.f = strtod(text.c_str(), nullptr);
+    return Operand{constant(TYPE_FLOAT, value), TYPE_FLOAT};
+}
+
+BytecodeCompiler::Operand BytecodeCompiler::convert(Operand operand, ValueType type) {
+    if (operand.type == type) {
+        return operand;
+    }
+    // An int constant becomes a float constant (a float one is converted
+    // at run time, where out-of-range values are caught)
+    if ((operand.reg & CONSTANT_TAG) && !(operand.reg & TEMP_TAG) && type == TYPE_FLOAT) {
+        Value value;
+        value.f = static_cast<double>(out->constants[operand.reg & ~CONSTANT_TAG].i);
+        return Operand{constant(TYPE_FLOAT, value), TYPE_FLOAT};
+    }
+    uint32_t reg = (operand.reg & TEMP_TAG) ? operand.reg : temp();
+    emit(type == TYPE_FLOAT ? OP_I2F : OP_F2I, reg, operand.reg);
+    return Operand{reg, type};
+}
+
+// var-declaration ::= type-specifier ID var-declaration', at the offsets
+// SemanticChecker::declare() reads
+void BytecodeCompiler::declare(uint32_t node) {
+    uint32_t symbol = tree->symbol(node + 3);
+    const SymbolInfo* info = checker.getSymbolTable().find(symbol);
+    VariableInfo variable{symbol, info->type, 0, info->arraySize != 0};
+    if (variable.isArray) {
+        if (out->arrayElements + static_cast<uint64_t>(info->arraySize) > MAX_ARRAY_ELEMENTS) {
+            report(tokenBefore[node] + 3, "arrays need more than " + to_string(MAX_ARRAY_ELEMENTS) + " elements");
+            return;
+        }
+        variable.slot = static_cast<uint32_t>(out->arrays.size());
+        out->arrays.push_back(ArrayInfo{symbol, info->type, out->arrayElements, info->arraySize});
+        out->arrayElements += info->arraySize;
+    } else {
+        variable.slot = out->constantBase++;
+    }
+    variableOf[symbol] = static_cast<uint32_t>(out->variables.size());
+    out->variables.push_back(variable);
+}
+
+// Temporaries only live within a statement
+void BytecodeCompiler::statement(uint32_t node) {
+    nextTemp = 0;
+    source = tokenBefore[node];
+    uint32_t child = tree->firstChild(node);
+    switch (tree->rule(child)) {
+        case RULE_ASSIGNMENT_STMT:
+            assignment(child);
+            break;
+        case RULE_COMPOUND_STMT:
+            // "{" statement-list "}"
+            statementList(child + 2);
+            break;
+        case RULE_SELECTION_STMT:
+            selection(child);
+            break;
+        default:
+            iteration(child);
+            break;
+    }
+}
+
+void BytecodeCompiler::statementList(uint32_t node) {
+    forEachElement(*tree, node, RULE_STATEMENT_LIST_PRIME, [this](uint32_t element) { statement(element); });
+}
+
+// assignment-stmt ::= var "=" expression
+void BytecodeCompiler::assignment(uint32_t node) {
+    uint32_t var = node + 1;
+    uint32_t value = tree->nextSibling(tree->nextSibling(var));
+    uint32_t symbol = tree->symbol(var + 1);
+    const VariableInfo& variable = out->variables[variableOf[symbol]];
+    if (!variable.isArray) {
+        into(value, Operand{variable.slot, variable.type});
+        return;
+    }
+    Operand at = index(var, symbol);
+    Operand result = convert(level(value), variable.type);
+    source = tokenBefore[var];
+    emit(OP_STORE, variable.slot, at.reg, result.reg);
+}
+
+// Evaluate an expression into target, converting if needed. The last
+// instruction writing a temporary result writes target instead.
+void BytecodeCompiler::into(uint32_t node, Operand target) {
+    size_t start = out->code.size();
+    Operand result = level(node);
+    if (result.type != target.type && (result.reg & CONSTANT_TAG) && !(result.reg & TEMP_TAG)) {
+        result = convert(result, target.type);
+    }
+    if (result.type != target.type) {
+        emit(target.type == TYPE_FLOAT ? OP_I2F : OP_F2I, target.reg, result.reg);
+    } else if ((result.reg & TEMP_TAG) && out->code.size() > start && out->code.back().a == result.reg) {
+        out->code.back().a = target.reg;
+    } else if (result.reg != target.reg) {
+        emit(OP_MOV, target.reg, result.reg);
+    }
+}
+
+// The index of an indexed var, an int
+BytecodeCompiler::Operand BytecodeCompiler::index(uint32_t var, uint32_t symbol) {
+    uint32_t expression = tree->subtreeEnd(var + 1) + 2;
+    Operand at = level(expression);
+    if (at.type != TYPE_INT) {
+        report(tokenBefore[var], "index of '" + string(symbols->str(symbol)) + "' is a float");
+    }
+    return at;
+}
+
+// expression, additive-expression and term: the first operand, then each
+// operator with the next operand, folded left to right into one register
+BytecodeCompiler::Operand BytecodeCompiler::level(uint32_t node) {
+    if (tree->rule(node) == RULE_FACTOR) {
+        return factor(node);
+    }
+    Operand result{0, TYPE_INT};
+    bool first = true;
+    TokenType op = ERROR;
+    uint32_t opToken = 0;
+    forEachElement(*tree, node, primeRule(tree->rule(node)), [&](uint32_t element) {
+        RuleId rule = tree->rule(element);
+        if (rule == RULE_RELOP || rule == RULE_ADDOP || rule == RULE_MULOP) {
+            op = tree->token(element + 1);
+            opToken = tokenBefore[element];
+            return;
+        }
+        if (first) {
+            result = level(element);
+            first = false;
+            return;
+        }
+
+        // The result accumulates in a temporary; the right operand's own
+        // temporaries are free again once it is combined
+        uint32_t dest = (result.reg & TEMP_TAG) ? result.reg : temp();
+        uint32_t mark = nextTemp;
+        Operand right = level(element);
+        ValueType type = result.type == TYPE_FLOAT || right.type == TYPE_FLOAT ? TYPE_FLOAT : TYPE_INT;
+        if (result.type != type) {
+            emit(OP_I2F, dest, result.reg);
+            result.reg = dest;
+        }
+        right = convert(right, type);
+        Opcode opcode = intOpcode(op);
+        source = opToken;
+        emit(type == TYPE_FLOAT ? floatOpcode(opcode) : opcode, dest, result.reg, right.reg);
+        nextTemp = mark;
+        result = Operand{dest, isComparison(opcode) ? TYPE_INT : type};
+    });
+    return result;
+}
+
+// factor ::= "(" expression ")" | var | NUM
+BytecodeCompiler::Operand BytecodeCompiler::factor(uint32_t node) {
+    uint32_t child = node + 1;
+    if (tree->kind(child) == NODE_TERMINAL) {
+        return tree->token(child) == NUM ? literal(child) : level(child + 1);
+    }
+    uint32_t symbol = tree->symbol(child + 1);
+    const VariableInfo& variable = out->variables[variableOf[symbol]];
+    if (!variable.isArray) {
+        return Operand{variable.slot, variable.type};
+    }
+    Operand at = index(child, symbol);
+    uint32_t reg = (at.reg & TEMP_TAG) ? at.reg : temp();
+    source = tokenBefore[child];
+    emit(OP_LOAD, reg, variable.slot, at.reg);
+    return Operand{reg, variable.type};
+}
+
+// Jump to a target patched in later when the condition is true (or
+// false). A single comparison becomes one compare-and-branch.
+void BytecodeCompiler::branch(uint32_t condition, bool whenTrue, vector<uint32_t>& jumps) {
+    uint32_t elements[3];
+    size_t count = 0;
+    forEachElement(*tree, condition, RULE_EXPRESSION_PRIME, [&](uint32_t element) {
+        if (count < 3) {
+            elements[count] = element;
+        }
+        count++;
+    });
+
+    source = tokenBefore[condition];
+    if (count == 3) {
+        Operand left = level(elements[0]);
+        Operand right = level(elements[2]);
+        ValueType type = left.type == TYPE_FLOAT || right.type == TYPE_FLOAT ? TYPE_FLOAT : TYPE_INT;
+        left = convert(left, type);
+        right = convert(right, type);
+        Opcode compare = intOpcode(tree->token(elements[1] + 1));
+        if (type == TYPE_INT) {
+            jumps.push_back(emit(whenTrue ? branchOpcode(compare) : negatedBranch(compare), left.reg, right.reg));
+        } else if (whenTrue) {
+            jumps.push_back(emit(floatOpcode(branchOpcode(compare)), left.reg, right.reg));
+        } else {
+            uint32_t flag = temp();
+            emit(floatOpcode(compare), flag, left.reg, right.reg);
+            jumps.push_back(emit(OP_JZ, flag));
+        }
+        return;
+    }
+
+    // Any other value: true when not zero
+    Operand value = level(condition);
+    if (value.type == TYPE_FLOAT) {
+        Value zero;
+        zero.f = 0.0;
+        uint32_t flag = temp();
+        emit(OP_NEF, flag, value.reg, constant(TYPE_FLOAT, zero));
+        value = Operand{flag, TYPE_INT};
+    }
+    jumps.push_back(emit(whenTrue ? OP_JNZ : OP_JZ, value.reg));
+}
+
+void BytecodeCompiler::patch(const vector<uint32_t>& jumps, uint32_t target) {
+    for (uint32_t jump : jumps) {
+        jumpTarget(out->code[jump]) = target;
+    }
+}
+
+// selection-stmt ::= if "(" expression ")" statement selection-stmt'
+// selection-stmt' ::= empty | else statement
+void BytecodeCompiler::selection(uint32_t node) {
+    uint32_t condition = node + 3;
+    uint32_t thenStmt = tree->nextSibling(tree->nextSibling(condition));
+    uint32_t prime = tree->nextSibling(thenStmt);
+    vector<uint32_t> toElse;
+    branch(condition, false, toElse);
+    statement(thenStmt);
+    if (tree->kind(prime + 1) == NODE_TERMINAL) {
+        uint32_t skip = emit(OP_JMP);
+        patch(toElse, static_cast<uint32_t>(out->code.size()));
+        statement(prime + 2);
+        patch(vector<uint32_t>(1, skip), static_cast<uint32_t>(out->code.size()));
+    } else {
+        patch(toElse, static_cast<uint32_t>(out->code.size()));
+    }
+}
+
+// iteration-stmt ::= while "(" expression ")" statement, with the test
+// after the body: jump to the test once, then branch back while it holds
+void BytecodeCompiler::iteration(uint32_t node) {
+    uint32_t condition = node + 3;
+    uint32_t body = tree->nextSibling(tree->nextSibling(condition));
+    uint32_t enter = emit(OP_JMP);
+    uint32_t top = static_cast<uint32_t>(out->code.size());
+    statement(body);
+    patch(vector<uint32_t>(1, enter), static_cast<uint32_t>(out->code.size()));
+    nextTemp = 0;
+    vector<uint32_t> back;
+    branch(condition, true, back);
+    patch(back, top);
+}
+
+// Give constants and temporaries their registers after the variables
+void BytecodeCompiler::relocate() {
+    uint32_t temps = out->constantBase + static_cast<uint32_t>(out->constants.size());
+    for (Instruction& in : out->code) {
+        unsigned regs = registerOperands(in.op);
+        uint32_t* operands[3] = {&in.a, &in.b, &in.c};
+        for (unsigned k = 0; k < 3; k++) {
+            if (!(regs & (1u << k))) {
+                continue;
+            }
+            uint32_t& reg = *operands[k];
+            if (reg & TEMP_TAG) {
+                reg = temps + (reg & ~TEMP_TAG);
+            } else if (reg & CONSTANT_TAG) {
+                reg = out->constantBase + (reg & ~CONSTANT_TAG);
+            }
+        }
+    }
+    out->registerCount = temps + maxTemps;
+}
+
+bool BytecodeCompiler::compile(const FlatTree& flatTree, const StringInterner& symbolTable,
+                               const TokenBuffer* tokenBuffer, BytecodeProgram& program) {
+    program.clear();
+    diagnostics.clear();
+    if (!checker.check(flatTree, symbolTable, tokenBuffer)) {
+        diagnostics = checker.getDiagnostics();
+        return false;
+    }
+
+    tree = &flatTree;
+    symbols = &symbolTable;
+    tokens = tokenBuffer;
+    out = &program;
+    variableOf.assign(symbolTable.size(), UINT32_MAX);
+    intConstants.clear();
+    floatConstants.clear();
+    nextTemp = 0;
+    maxTemps = 0;
+    source = 0;
+
+    tokenBefore.resize(flatTree.size());
+    uint32_t token = 0;
+    for (uint32_t i = 0; i < flatTree.size(); i++) {
+        tokenBefore[i] = token;
+        token += flatTree.kind(i) == NODE_TERMINAL;
+    }
+
+    // program ::= Program ID "{" declaration-list statement-list "}" "."
+    for (uint32_t child : flatTree.children(0)) {
+        if (flatTree.kind(child) != NODE_NONTERMINAL) {
+            continue;
+        }
+        if (flatTree.rule(child) == RULE_DECLARATION_LIST) {
+            // declaration ::= var-declaration
+            forEachElement(flatTree, child, RULE_DECLARATION_LIST_PRIME,
+                           [this](uint32_t declaration) { declare(declaration + 1); });
+        } else if (flatTree.rule(child) == RULE_STATEMENT_LIST && diagnostics.empty()) {
+            statementList(child);
+        }
+    }
+    source = token > 0 ? token - 1 : 0;
+    emit(OP_HALT);
+    relocate();
+
+    if (!diagnostics.empty()) {
+        program.clear();
+        return false;
+    }
+    return true;
+}
+
+bool BytecodeCompiler::compile(const ParseTreeNode* root, const StringInterner& symbolTable,
+                               const TokenBuffer* tokenBuffer, BytecodeProgram& program) {
+    if (!flat.build(root)) {
+        program.clear();
+        diagnostics.clear();
+        Diagnostic d{0, 0, "SEMANTIC ERROR: tree too large to compile"};
+        diagnostics.push_back(d);
+        return false;
+    }
+    return compile(flat, symbolTable, tokenBuffer, program);
+}
@@ -0,0 +1,197 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "FlatTree.h"
+#include "Parser.h"
+#include "Semantic.h"
+#include "StringInterner.h"
+#include "TokenBuffer.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Register bytecode for C- programs.
+ *
+ * Every instruction is four 32-bit words: the opcode and up to three
+ * operands. Register operands index the frame, which holds the program's
+ * scalar variables, then its constants, then the temporaries expressions
+ * need; constants are registers too, so no instruction carries an
+ * immediate. Arrays live in one separate block of elements and are named
+ * by their index in BytecodeProgram::arrays.
+ *
+ * int is a 64-bit two's complement integer that wraps on overflow, float a
+ * double. Operations are typed; the compiler inserts the conversions.
+ */
+enum Opcode : uint32_t {
+    OP_MOV,     // a = b
+    OP_I2F,     // a = float(b)
+    OP_F2I,     // a = int(b), truncating; out of range is a runtime error
+    OP_ADDI,    // a = b op c, int
+    OP_SUBI,
+    OP_MULI,
+    OP_DIVI,    // Division by zero is a runtime error
+    OP_ADDF,    // a = b op c, float
+    OP_SUBF,
+    OP_MULF,
+    OP_DIVF,
+    OP_LTI,     // a = b relop c as int 0 or 1, int operands
+    OP_LEI,
+    OP_GTI,
+    OP_GEI,
+    OP_EQI,
+    OP_NEI,
+    OP_LTF,     // The same with float operands
+    OP_LEF,
+    OP_GTF,
+    OP_GEF,
+    OP_EQF,
+    OP_NEF,
+    OP_LOAD,    // a = arrays[b][c], bounds checked
+    OP_STORE,   // arrays[a][b] = c, bounds checked
+    OP_JMP,     // Jump to a
+    OP_JZ,      // Jump to b if int a is 0
+    OP_JNZ,     // Jump to b if int a is not 0
+    OP_JLTI,    // Jump to c if a relop b, int operands
+    OP_JLEI,
+    OP_JGTI,
+    OP_JGEI,
+    OP_JEQI,
+    OP_JNEI,
+    OP_JLTF,    // The same with float operands
+    OP_JLEF,
+    OP_JGTF,
+    OP_JGEF,
+    OP_JEQF,
+    OP_JNEF,
+    OP_HALT,
+    OP_COUNT
+};
+
+// Mnemonic of an opcode, e.g. "addi"
+const char* opcodeName(Opcode op);
+
+struct Instruction {
+    uint32_t op;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+};
+
+union Value {
+    int64_t i;
+    double f;
+};
+
+struct ArrayInfo {
+    uint32_t symbol;
+    ValueType type;
+    uint32_t base;          // First element in the array block
+    uint32_t size;
+};
+
+// A declared variable: a frame register, or an array
+struct VariableInfo {
+    uint32_t symbol;
+    ValueType type;
+    uint32_t slot;          // Register, or index in arrays
+    bool isArray;
+};
+
+struct BytecodeProgram {
+    std::vector<Instruction> code;
+    std::vector<uint32_t> tokens;       // Token index of the source of each instruction
+    std::vector<Value> constants;       // Initial values of registers constantBase...
+    std::vector<VariableInfo> variables;
+    std::vector<ArrayInfo> arrays;
+    uint32_t constantBase;              // Registers: variables, constants, temporaries
+    uint32_t registerCount;
+    uint32_t arrayElements;
+
+    BytecodeProgram() : constantBase(0), registerCount(0), arrayElements(0) {}
+
+    void clear();
+
+    // One instruction per line: index, mnemonic and operands, with
+    // registers as r<n> and jump targets as @<index>
+    void disassemble(std::ostream& out) const;
+};
+
+/*
+ * Lowers the tree of a successful parse to a BytecodeProgram.
+ *
+ * The program is checked by SemanticChecker first. Declarations become
+ * registers (scalars) or ranges of the array block, in order. Expressions
+ * are folded left to right into temporaries that are reused after each
+ * operand, and the last instruction of an assigned expression writes the
+ * variable directly, so x = x * 2 is one muli. A condition that is one
+ * comparison becomes a compare-and-branch; while loops test at the bottom,
+ * so an iteration runs the body plus one branch.
+ */
+class BytecodeCompiler {
+public:
+    BytecodeCompiler()
+        : tree(nullptr), symbols(nullptr), tokens(nullptr), out(nullptr), nextTemp(0), maxTemps(0), source(0) {}
+
+    // Compile a parse tree into program; false with diagnostics on a
+    // semantic error. tokens, the buffer the tree was parsed from, gives
+    // the error positions.
+    bool compile(const ParseTreeNode* root, const StringInterner& symbolTable, const TokenBuffer* tokenBuffer,
+                 BytecodeProgram& program);
+    bool compile(const FlatTree& flatTree, const StringInterner& symbolTable, const TokenBuffer* tokenBuffer,
+                 BytecodeProgram& program);
+
+    const std::vector<Diagnostic>& getDiagnostics() const { return diagnostics; }
+
+private:
+    // A register and the type of its value
+    struct Operand {
+        uint32_t reg;
+        ValueType type;
+    };
+
+    // Constants and temporaries are numbered apart while compiling and
+    // moved after the variables at the end
+    static const uint32_t CONSTANT_TAG = 0x40000000;
+    static const uint32_t TEMP_TAG = 0x80000000;
+
+    SemanticChecker checker;
+    FlatTree flat;
+    std::vector<Diagnostic> diagnostics;
+    const FlatTree* tree;
+    const StringInterner* symbols;
+    const TokenBuffer* tokens;
+    BytecodeProgram* out;
+    std::vector<uint32_t> variableOf;   // By symbol ID: index in out->variables
+    std::vector<uint32_t> tokenBefore;  // By node: terminals before it in preorder
+    std::unordered_map<int64_t, uint32_t> intConstants;     // Value to tagged register
+    std::unordered_map<uint64_t, uint32_t> floatConstants;  // Bits to tagged register
+    uint32_t nextTemp;
+    uint32_t maxTemps;
+    uint32_t source;                    // Token index recorded with each instruction
+
+    uint32_t emit(Opcode op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0);
+    uint32_t temp();
+    uint32_t constant(ValueType type, Value value);
+    Operand literal(uint32_t node);
+    Operand convert(Operand operand, ValueType type);
+
+    void declare(uint32_t node);
+    void statement(uint32_t node);
+    void statementList(uint32_t node);
+    void assignment(uint32_t node);
+    void selection(uint32_t node);
+    void iteration(uint32_t node);
+    Operand level(uint32_t node);
+    Operand factor(uint32_t node);
+    Operand index(uint32_t var, uint32_t symbol);
+    void into(uint32_t node, Operand target);
+    void branch(uint32_t condition, bool whenTrue, std::vector<uint32_t>& jumps);
+    void patch(const std::vector<uint32_t>& jumps, uint32_t target);
+    void relocate();
+    void report(uint32_t token, const std::string& message);
+};
+
+#endif /* BYTECODE_H */
@@ -0,0 +1,26 @@
+#include "CMinus.h"
+
+// Created on a thread's first call and kept until the thread exits
+static Parser& threadParser(const ParserOptions& options) {
+    thread_local Parser parser;
+    parser.reset(options);
+    return parser;
+}
+
+ParseResult cminusParse(const char* data, size_t size, const ParserOptions& options) {
+    Parser& parser = threadParser(options);
+    ParseResult result;
+    result.tree = parser.parse(data, size);
+    result.ast = nullptr;
+    result.parser = &parser;
+    return result;
+}
+
+ParseResult cminusParseAst(const char* data, size_t size, const ParserOptions& options) {
+    Parser& parser = threadParser(options);
+    ParseResult result;
+    result.tree = nullptr;
+    result.ast = parser.parseAst(data, size);
+    result.parser = &parser;
+    return result;
+}
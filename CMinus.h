@@ -0,0 +1,34 @@
+#ifndef CMINUS_H
+#define CMINUS_H
+
+#include "Parser.h"
+#include <cstddef>
+
+/*
+ * libcminus entry point (make lib builds libcminus.a and libcminus.so from
+ * every object but main.o).
+ *
+ * cminusParse() parses a program held in memory with no per-call setup:
+ * each thread keeps one Parser that is reset and reused for every call, so
+ * its node arena, intern table, token buffer and scanner stay allocated
+ * between inputs. Callers that want to manage the parser themselves can
+ * do the same with Parser(options) and Parser::parse(data, size).
+ */
+
+/* Outcome of cminusParse */
+struct ParseResult {
+    // The parse tree, or the AST for cminusParseAst; nullptr after a syntax
+    // error (a partial tree when recovering)
+    ParseTreeNode* tree;
+    AstNode* ast;
+    const Parser* parser;   // Errors and the interned lexemes of the tree
+};
+
+// Parse data[0, size) with the calling thread's parser. The tree and the
+// parser's state stay valid until the next call on the same thread.
+ParseResult cminusParse(const char* data, size_t size, const ParserOptions& options = ParserOptions());
+
+// The same, building the AST (see Ast.h) instead of the parse tree
+ParseResult cminusParseAst(const char* data, size_t size, const ParserOptions& options = ParserOptions());
+
+#endif /* CMINUS_H */
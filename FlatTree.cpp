@@ -0,0 +1,102 @@
+#include "FlatTree.h"
+
+using namespace std;
+
+void FlatTree::clear() {
+    kinds.clear();
+    types.clear();
+    symbols.clear();
+    sizes.clear();
+    parents.clear();
+}
+
+void FlatTree::append(NodeKind kind, uint16_t type, uint32_t symbol, uint32_t parent) {
+    kinds.push_back(kind);
+    types.push_back(type);
+    symbols.push_back(symbol);
+    sizes.push_back(1);
+    parents.push_back(parent);
+}
+
+bool FlatTree::build(const ParseTreeNode* root) {
+    clear();
+
+    // Each frame is a node already added whose remaining children are
+    // next, next->nextSibling, ...
+    struct Frame {
+        const ParseTreeNode* next;
+        uint32_t index;
+    };
+    vector<Frame> stack;
+
+    auto add = [&](const ParseTreeNode* node, uint32_t parent) {
+        uint16_t type = node->kind == NODE_TERMINAL ? node->token : static_cast<uint16_t>(node->rule);
+        append(node->kind, type, node->kind == NODE_TERMINAL ? node->symbol : 0, parent);
+        stack.push_back(Frame{node->firstChild, static_cast<uint32_t>(kinds.size() - 1)});
+    };
+
+    if (root) {
+        add(root, NO_NODE);
+    }
+    while (!stack.empty()) {
+        Frame& top = stack.back();
+        const ParseTreeNode* node = top.next;
+        if (node) {
+            if (kinds.size() >= NO_NODE) {
+                clear();
+                return false;
+            }
+            top.next = node->nextSibling;
+            add(node, top.index);
+            continue;
+        }
+        sizes[top.index] = static_cast<uint32_t>(kinds.size() - top.index);
+        stack.pop_back();
+    }
+    return true;
+}
+
+bool FlatTree::load(const TreeFile& file) {
+    clear();
+    if (file.size() >= NO_NODE) {
+        return false;
+    }
+    uint32_t count = static_cast<uint32_t>(file.size());
+    kinds.reserve(count);
+    types.reserve(count);
+    symbols.reserve(count);
+    sizes.reserve(count);
+    parents.reserve(count);
+
+    // The file has no parent links: the parent of a node is the nearest
+    // open node before it, so keep the open ancestors on a stack
+    vector<uint32_t> open;
+    for (uint32_t i = 0; i < count; i++) {
+        const TreeFileNode& node = file.node(i);
+        while (!open.empty() && i >= open.back() + file.node(open.back()).subtreeSize) {
+            open.pop_back();
+        }
+        uint16_t type = node.kind == NODE_TERMINAL ? node.token : node.rule;
+        append(static_cast<NodeKind>(node.kind), type, node.symbol, open.empty() ? NO_NODE : open.back());
+        sizes.back() = node.subtreeSize;
+        open.push_back(i);
+    }
+    return true;
+}
+
+string FlatTree::label(uint32_t i, const StringInterner& symbolTable) const {
+    switch (kind(i)) {
+        case NODE_NONTERMINAL:
+            return ruleName(rule(i));
+        case NODE_TERMINAL: {
+            string text = tokenName(token(i));
+            text += ": ";
+            text += symbolTable.str(symbols[i]);
+            return text;
+        }
+        case NODE_ERROR:
+            return "error";
+        default:
+            return "ε";
+    }
+}
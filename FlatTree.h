@@ -0,0 +1,135 @@
+#ifndef FLATTREE_H
+#define FLATTREE_H
+
+#include "ParseTree.h"
+#include "StringInterner.h"
+#include "TreeFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Frozen parse tree stored in preorder as parallel arrays.
+ *
+ * Node 0 is the root. A node's first child, if any, is the next node, and
+ * its next sibling is at index + subtreeSize, so a subtree is a contiguous
+ * index range: a full traversal is a linear scan and skipping a subtree is
+ * an add. Each node also records its parent's index. The columns are the
+ * node kind, the rule (nonterminals) or token type (terminals), the
+ * interned symbol of a terminal's lexeme, the subtree size and the parent:
+ * 15 bytes per node, against 40 for a ParseTreeNode.
+ *
+ * The symbols are those of the parser (or .ptree string table) the tree
+ * was taken from; the arrays do not refer back to the pointer tree.
+ */
+class FlatTree {
+public:
+    static const uint32_t NO_NODE = UINT32_MAX;
+
+    FlatTree() {}
+
+    // Flatten a parse tree, replacing the current contents. Returns false
+    // if the tree has NO_NODE nodes or more.
+    bool build(const ParseTreeNode* root);
+
+    // Take the nodes of a mapped .ptree file; symbols index its string
+    // table
+    bool load(const TreeFile& file);
+
+    void clear();
+
+    uint32_t size() const { return static_cast<uint32_t>(kinds.size()); }
+    bool empty() const { return kinds.empty(); }
+
+    NodeKind kind(uint32_t i) const { return static_cast<NodeKind>(kinds[i]); }
+    RuleId rule(uint32_t i) const { return static_cast<RuleId>(types[i]); }
+    TokenType token(uint32_t i) const { return static_cast<TokenType>(types[i]); }
+    uint16_t type(uint32_t i) const { return types[i]; }      // rule() or token(), by kind
+    uint32_t symbol(uint32_t i) const { return symbols[i]; }
+    uint32_t subtreeSize(uint32_t i) const { return sizes[i]; }
+    uint32_t parent(uint32_t i) const { return parents[i]; }
+
+    // Navigation; NO_NODE means "none"
+    uint32_t subtreeEnd(uint32_t i) const { return i + sizes[i]; }
+    uint32_t firstChild(uint32_t i) const { return sizes[i] > 1 ? i + 1 : NO_NODE; }
+    uint32_t nextSibling(uint32_t i) const {
+        uint32_t next = subtreeEnd(i);
+        return parents[i] != NO_NODE && next < subtreeEnd(parents[i]) ? next : NO_NODE;
+    }
+
+    // Label of a node, as in the Graphviz output
+    std::string label(uint32_t i, const StringInterner& symbolTable) const;
+
+    // The children of a node, in order: for (uint32_t child : tree.children(i))
+    class ChildIterator {
+    public:
+        ChildIterator(const FlatTree* t, uint32_t i) : tree(t), index(i) {}
+        uint32_t operator*() const { return index; }
+        ChildIterator& operator++() {
+            index = tree->subtreeEnd(index);
+            return *this;
+        }
+        bool operator!=(const ChildIterator& other) const { return index != other.index; }
+
+    private:
+        const FlatTree* tree;
+        uint32_t index;
+    };
+
+    class ChildRange {
+    public:
+        ChildRange(const FlatTree* t, uint32_t i) : tree(t), node(i) {}
+        ChildIterator begin() const { return ChildIterator(tree, node + 1); }
+        ChildIterator end() const { return ChildIterator(tree, tree->subtreeEnd(node)); }
+
+    private:
+        const FlatTree* tree;
+        uint32_t node;
+    };
+
+    ChildRange children(uint32_t i) const { return ChildRange(this, i); }
+
+    // Depth-first walk of the subtree at root. visitor.enter(i) is called
+    // in preorder and returns whether to descend into the node's children;
+    // visitor.leave(i) follows each entered node after its descendants.
+    // The only state kept is one index per open ancestor.
+    template <typename Visitor>
+    void walk(Visitor& visitor, uint32_t root = 0) const {
+        std::vector<uint32_t> open;
+        uint32_t end = subtreeEnd(root);
+        uint32_t i = root;
+        while (i < end) {
+            while (!open.empty() && i >= subtreeEnd(open.back())) {
+                visitor.leave(open.back());
+                open.pop_back();
+            }
+            if (visitor.enter(i)) {
+                open.push_back(i);
+                i++;
+            } else {
+                i = subtreeEnd(i);
+            }
+        }
+        while (!open.empty()) {
+            visitor.leave(open.back());
+            open.pop_back();
+        }
+    }
+
+    // Bytes held by the arrays
+    size_t bytesUsed() const {
+        return kinds.capacity() + types.capacity() * sizeof(uint16_t) +
+               (symbols.capacity() + sizes.capacity() + parents.capacity()) * sizeof(uint32_t);
+    }
+
+private:
+    std::vector<uint8_t> kinds;
+    std::vector<uint16_t> types;        // RuleId or TokenType, by kind
+    std::vector<uint32_t> symbols;      // Terminals only, 0 otherwise
+    std::vector<uint32_t> sizes;
+    std::vector<uint32_t> parents;      // NO_NODE for the root
+
+    void append(NodeKind kind, uint16_t type, uint32_t symbol, uint32_t parent);
+};
+
+#endif /* FLATTREE_H */
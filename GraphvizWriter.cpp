@@ -0,0 +1,385 @@
+#include "GraphvizWriter.h"
+#include "Stats.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+/*
+ * Output buffer for the writer. Callers reserve room for a whole record and
+ * format into it through a raw pointer.
+ *
+ * DOT_WRITE keeps one heap buffer and flushes it with write() whenever a
+ * record does not fit. DOT_MMAP maps the output file itself, growing the
+ * file and the mapping by doubling, and trims the file to the bytes written
+ * at the end.
+ */
+class DotOutput {
+public:
+    static constexpr size_t BUFFER_SIZE = 4 * 1024 * 1024;
+
+    DotOutput() : fd(-1), mode(DOT_WRITE), buffer(nullptr), capacity(0), used(0), failed(false) {}
+
+    ~DotOutput() {
+        if (mode == DOT_MMAP) {
+            if (buffer) {
+                munmap(buffer, capacity);
+            }
+        } else {
+            free(buffer);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    DotOutput(const DotOutput&) = delete;
+    DotOutput& operator=(const DotOutput&) = delete;
+
+    bool open(const string& path, DotOutputMode outputMode) {
+        mode = outputMode;
+        fd = ::open(path.c_str(), (mode == DOT_MMAP ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        if (mode == DOT_MMAP) {
+            return remap(BUFFER_SIZE);
+        }
+        buffer = static_cast<char*>(malloc(BUFFER_SIZE));
+        if (!buffer) {
+            throw std::bad_alloc();
+        }
+        STATS_ALLOCATION(BUFFER_SIZE);
+        capacity = BUFFER_SIZE;
+        return true;
+    }
+
+    // Pointer to at least n free bytes; call commit() with the bytes used.
+    // Returns nullptr once an I/O error has occurred.
+    char* reserve(size_t n) {
+        if (capacity - used < n && !makeRoom(n)) {
+            return nullptr;
+        }
+        return buffer + used;
+    }
+
+    void commit(char* end) { used = end - buffer; }
+
+    void append(const char* text, size_t n) {
+        char* p = reserve(n);
+        if (p) {
+            memcpy(p, text, n);
+            commit(p + n);
+        }
+    }
+
+    // Flush (or trim the mapping) and close the file
+    bool finish() {
+        if (!failed) {
+            if (mode == DOT_MMAP) {
+                munmap(buffer, capacity);
+                buffer = nullptr;
+                failed = ftruncate(fd, static_cast<off_t>(used)) != 0;
+            } else {
+                failed = !flush();
+            }
+        }
+        failed = close(fd) != 0 || failed;
+        fd = -1;
+        return !failed;
+    }
+
+private:
+    int fd;
+    DotOutputMode mode;
+    char* buffer;
+    size_t capacity;
+    size_t used;        // Bytes formatted into buffer (the whole file so far, when mapped)
+    bool failed;
+
+    bool makeRoom(size_t n) {
+        if (failed) {
+            return false;
+        }
+        if (mode == DOT_MMAP) {
+            size_t size = capacity * 2;
+            while (size - used < n) {
+                size *= 2;
+            }
+            return remap(size);
+        }
+        if (!flush()) {
+            return false;
+        }
+        if (n > capacity) {
+            // A single record larger than the buffer (a huge lexeme)
+            char* larger = static_cast<char*>(realloc(buffer, n));
+            if (!larger) {
+                throw std::bad_alloc();
+            }
+            buffer = larger;
+            capacity = n;
+            STATS_ALLOCATION(n);
+        }
+        return true;
+    }
+
+    bool flush() {
+        const char* p = buffer;
+        size_t left = used;
+        while (left > 0) {
+            ssize_t n = ::write(fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                failed = true;
+                return false;
+            }
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+        used = 0;
+        return true;
+    }
+
+    bool remap(size_t size) {
+        if (buffer) {
+            munmap(buffer, capacity);
+            buffer = nullptr;
+        }
+        void* region = MAP_FAILED;
+        if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+            region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (region == MAP_FAILED) {
+            failed = true;
+            capacity = 0;
+            return false;
+        }
+        buffer = static_cast<char*>(region);
+        capacity = size;
+        return true;
+    }
+};
+
+// Digits of the largest size_t
+const size_t ID_ROOM = 20;
+
+char* putText(char* p, const char* text, size_t n) {
+    memcpy(p, text, n);
+    return p + n;
+}
+
+char* putId(char* p, size_t id) {
+    char digits[ID_ROOM];
+    char* d = digits + ID_ROOM;
+    do {
+        *--d = static_cast<char>('0' + id % 10);
+        id /= 10;
+    } while (id > 0);
+    return putText(p, d, digits + ID_ROOM - d);
+}
+
+char* putEscaped(char* p, const char* text, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        char c = text[i];
+        if (c == '"' || c == '\\') {
+            *p++ = '\\';
+        }
+        *p++ = c;
+    }
+    return p;
+}
+
+// "  node<id> [label="<prefix>[: <text>]"];\n", then
+// "  node<parent> -> node<id>;\n" unless the node is the root
+void writeRecord(DotOutput& out, const char* prefix, size_t prefixLen, const char* text, size_t textLen,
+                 bool hasText, size_t id, size_t parentId, bool hasParent) {
+    // Escaping at most doubles the label
+    size_t room = 2 * (prefixLen + 2 + textLen) + 4 * ID_ROOM + 64;
+    char* p = out.reserve(room);
+    if (!p) {
+        return;
+    }
+
+    p = putText(p, "  node", 6);
+    p = putId(p, id);
+    p = putText(p, " [label=\"", 9);
+    p = putEscaped(p, prefix, prefixLen);
+    if (hasText) {
+        p = putText(p, ": ", 2);
+        p = putEscaped(p, text, textLen);
+    }
+    p = putText(p, "\"];\n", 4);
+
+    if (hasParent) {
+        p = putText(p, "  node", 6);
+        p = putId(p, parentId);
+        p = putText(p, " -> node", 8);
+        p = putId(p, id);
+        p = putText(p, ";\n", 2);
+    }
+    out.commit(p);
+}
+
+void writeNode(DotOutput& out, NodeKind kind, uint16_t type, uint32_t symbol, const StringInterner& symbols,
+               size_t id, size_t parentId, bool hasParent) {
+    const char* prefix;
+    string_view lexeme;
+
+    switch (kind) {
+        case NODE_NONTERMINAL:
+            prefix = ruleName(static_cast<RuleId>(type));
+            break;
+        case NODE_TERMINAL:
+            prefix = tokenName(static_cast<TokenType>(type));
+            lexeme = symbols.str(symbol);
+            break;
+        case NODE_ERROR:
+            prefix = "error";
+            break;
+        default:
+            prefix = "ε";
+            break;
+    }
+
+    writeRecord(out, prefix, strlen(prefix), lexeme.data(), lexeme.size(), kind == NODE_TERMINAL,
+                id, parentId, hasParent);
+}
+
+void writeNode(DotOutput& out, const ParseTreeNode* node, const StringInterner& symbols,
+               size_t id, size_t parentId, bool hasParent) {
+    uint16_t type = node->kind == NODE_TERMINAL ? node->token : static_cast<uint16_t>(node->rule);
+    writeNode(out, node->kind, type, node->symbol, symbols, id, parentId, hasParent);
+}
+
+const char DOT_HEADER[] =
+    "digraph ParseTree {\n"
+    "  node [shape=box, fontname=\"Arial\"];\n"
+    "  edge [fontname=\"Arial\"];\n\n";
+
+}  // namespace
+
+bool writeGraphviz(const ParseTreeNode* root, const StringInterner& symbols,
+                   const string& path, DotOutputMode mode, size_t* nodeCount) {
+    DotOutput out;
+    if (!out.open(path, mode)) {
+        return false;
+    }
+
+    out.append(DOT_HEADER, sizeof(DOT_HEADER) - 1);
+
+    // Each frame is a node already written whose remaining children are
+    // next, next->nextSibling, ...
+    struct Frame {
+        const ParseTreeNode* next;
+        size_t id;
+    };
+    vector<Frame> stack;
+    size_t nextId = 0;
+
+    if (root) {
+        writeNode(out, root, symbols, nextId, 0, false);
+        stack.push_back(Frame{root->firstChild, nextId++});
+    }
+
+    while (!stack.empty()) {
+        Frame& top = stack.back();
+        const ParseTreeNode* node = top.next;
+        if (!node) {
+            stack.pop_back();
+            continue;
+        }
+        top.next = node->nextSibling;
+
+        size_t id = nextId++;
+        writeNode(out, node, symbols, id, top.id, true);
+        if (node->firstChild) {
+            stack.push_back(Frame{node->firstChild, id});
+        }
+    }
+
+    out.append("}\n", 2);
+
+    if (nodeCount) {
+        *nodeCount = nextId;
+    }
+    return out.finish();
+}
+
+bool writeFlatGraphviz(const FlatTree& tree, const StringInterner& symbols, const string& path,
+                       DotOutputMode mode, size_t* nodeCount) {
+    DotOutput out;
+    if (!out.open(path, mode)) {
+        return false;
+    }
+    out.append(DOT_HEADER, sizeof(DOT_HEADER) - 1);
+
+    // Preorder indices are the node IDs the pointer walk hands out, so
+    // this is one pass over the arrays
+    for (uint32_t i = 0; i < tree.size(); i++) {
+        writeNode(out, tree.kind(i), tree.type(i), tree.symbol(i), symbols, i, tree.parent(i),
+                  tree.parent(i) != FlatTree::NO_NODE);
+    }
+
+    out.append("}\n", 2);
+
+    if (nodeCount) {
+        *nodeCount = tree.size();
+    }
+    return out.finish();
+}
+
+bool writeAstGraphviz(const AstNode* root, const StringInterner& symbols, const string& path,
+                      DotOutputMode mode, size_t* nodeCount) {
+    DotOutput out;
+    if (!out.open(path, mode)) {
+        return false;
+    }
+    out.append(DOT_HEADER, sizeof(DOT_HEADER) - 1);
+
+    // AST children are not one sibling list, so pending nodes are pushed
+    // individually (in reverse, to come off the stack in source order)
+    struct Pending {
+        const AstNode* node;
+        size_t parentId;
+    };
+    vector<Pending> stack;
+    vector<const AstNode*> children;
+    string label;
+    size_t nextId = 0;
+
+    if (root) {
+        stack.push_back(Pending{root, 0});
+    }
+    while (!stack.empty()) {
+        Pending item = stack.back();
+        stack.pop_back();
+
+        size_t id = nextId++;
+        astLabel(item.node, symbols, label);
+        writeRecord(out, label.data(), label.size(), nullptr, 0, false, id, item.parentId, id != 0);
+
+        children.clear();
+        forEachAstChild(item.node, [&](const AstNode* child) { children.push_back(child); });
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            stack.push_back(Pending{*it, id});
+        }
+    }
+
+    out.append("}\n", 2);
+
+    if (nodeCount) {
+        *nodeCount = nextId;
+    }
+    return out.finish();
+}
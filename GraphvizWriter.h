@@ -0,0 +1,41 @@
+#ifndef GRAPHVIZWRITER_H
+#define GRAPHVIZWRITER_H
+
+#include "Ast.h"
+#include "FlatTree.h"
+#include "ParseTree.h"
+#include "StringInterner.h"
+#include <string>
+
+/* How the .dot text reaches the output file */
+enum DotOutputMode {
+    DOT_WRITE,      // Fill a reusable buffer and flush it with write() in large blocks
+    DOT_MMAP        // Format straight into a shared mapping of the output file
+};
+
+/*
+ * Write a parse tree as a Graphviz digraph in a single preorder pass.
+ *
+ * The walk uses an explicit stack, so tree depth does not consume C++
+ * stack, and node IDs are assigned as nodes are visited. Each node's line
+ * and the edge from its parent are formatted and escaped directly into the
+ * output buffer; nothing is allocated per node.
+ *
+ * Returns false when the file cannot be created or written. On success,
+ * nodeCount (if given) receives the number of nodes written.
+ */
+bool writeGraphviz(const ParseTreeNode* root, const StringInterner& symbols,
+                   const std::string& path, DotOutputMode mode = DOT_WRITE,
+                   size_t* nodeCount = nullptr);
+
+// Write a flattened parse tree; the output is the same as for the tree it
+// was built from
+bool writeFlatGraphviz(const FlatTree& tree, const StringInterner& symbols, const std::string& path,
+                       DotOutputMode mode = DOT_WRITE, size_t* nodeCount = nullptr);
+
+// Write an AST the same way; node labels come from astLabel()
+bool writeAstGraphviz(const AstNode* root, const StringInterner& symbols,
+                      const std::string& path, DotOutputMode mode = DOT_WRITE,
+                      size_t* nodeCount = nullptr);
+
+#endif /* GRAPHVIZWRITER_H */
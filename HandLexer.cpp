@@ -0,0 +1,279 @@
+#include "HandLexer.h"
+#include "Scan.h"
+#include <array>
+#include <cstdio>
+
+namespace {
+
+/* ---- Character classes ---- */
+
+enum : unsigned char {
+    CC_LETTER = 1,
+    CC_DIGIT = 2,
+    CC_IDSEP = 4,   // May join the two parts of an identifier: . # $ _
+};
+
+constexpr std::array<unsigned char, 256> buildCharClasses() {
+    std::array<unsigned char, 256> table{};
+    for (int c = 'a'; c <= 'z'; c++) table[c] = CC_LETTER;
+    for (int c = 'A'; c <= 'Z'; c++) table[c] = CC_LETTER;
+    for (int c = '0'; c <= '9'; c++) table[c] = CC_DIGIT;
+    table['.'] = CC_IDSEP;
+    table['#'] = CC_IDSEP;
+    table['$'] = CC_IDSEP;
+    table['_'] = CC_IDSEP;
+    return table;
+}
+
+constexpr std::array<unsigned char, 256> CHAR_CLASS = buildCharClasses();
+
+inline unsigned char charClass(char c) {
+    return CHAR_CLASS[static_cast<unsigned char>(c)];
+}
+
+inline bool isAlnum(char c) {
+    return charClass(c) & (CC_LETTER | CC_DIGIT);
+}
+
+inline bool isDigit(char c) {
+    return charClass(c) & CC_DIGIT;
+}
+
+/* ---- Keywords: perfect hash over the case-folded identifier ---- */
+
+struct Keyword {
+    const char* spelling;   // Canonical spelling reported as the lexeme
+    const char* folded;     // Lower-case form compared against
+    size_t length;
+    int type;
+};
+
+constexpr Keyword KEYWORDS[] = {
+    { "if",      "if",      2, IF },
+    { "else",    "else",    4, ELSE },
+    { "while",   "while",   5, WHILE },
+    { "int",     "int",     3, INT },
+    { "float",   "float",   5, FLOAT },
+    { "return",  "return",  6, RETURN },
+    { "void",    "void",    4, VOID },
+    { "Program", "program", 7, PROGRAM },
+};
+
+constexpr size_t KEYWORD_COUNT = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+constexpr size_t KEYWORD_TABLE_SIZE = 8;
+
+// Folding sets bit 0x20, which lower-cases letters and leaves digits alone
+constexpr unsigned keywordHash(char first, size_t length) {
+    return (static_cast<unsigned>(static_cast<unsigned char>(first) | 0x20) * 2 + length) &
+           (KEYWORD_TABLE_SIZE - 1);
+}
+
+constexpr std::array<int, KEYWORD_TABLE_SIZE> buildKeywordTable() {
+    std::array<int, KEYWORD_TABLE_SIZE> table{};
+    for (size_t i = 0; i < KEYWORD_TABLE_SIZE; i++) table[i] = -1;
+    for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+        table[keywordHash(KEYWORDS[i].folded[0], KEYWORDS[i].length)] = static_cast<int>(i);
+    }
+    return table;
+}
+
+constexpr std::array<int, KEYWORD_TABLE_SIZE> KEYWORD_TABLE = buildKeywordTable();
+
+constexpr bool keywordHashIsPerfect() {
+    for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+        if (KEYWORD_TABLE[keywordHash(KEYWORDS[i].folded[0], KEYWORDS[i].length)] != static_cast<int>(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(keywordHashIsPerfect(), "keyword hash has collisions");
+
+// Keyword entry for an identifier, nullptr if it is not a keyword
+inline const Keyword* findKeyword(const char* text, size_t length) {
+    if (length < 2 || length > 7) {
+        return nullptr;
+    }
+    int index = KEYWORD_TABLE[keywordHash(text[0], length)];
+    if (index < 0 || KEYWORDS[index].length != length) {
+        return nullptr;
+    }
+    const char* folded = KEYWORDS[index].folded;
+    for (size_t i = 0; i < length; i++) {
+        if ((text[i] | 0x20) != folded[i]) {
+            return nullptr;
+        }
+    }
+    return &KEYWORDS[index];
+}
+
+} // namespace
+
+HandLexer::HandLexer(const char* data, size_t size, LexerState& lexerState)
+    : begin(data), cursor(data), end(data + size), state(lexerState) {}
+
+// Move over text that produces no token (whitespace, comments). Like the
+// flex scanner, which tracks every match, it still updates token_offset.
+void HandLexer::skip(const char* to) {
+    size_t length = static_cast<size_t>(to - cursor);
+    state.token_offset = static_cast<size_t>(cursor - begin);
+    size_t lastNewline = 0;
+    size_t newlines = scan_count_newlines(cursor, length, &lastNewline);
+    if (newlines) {
+        state.line_num += static_cast<long long>(newlines);
+        state.col_num = static_cast<long long>(length - lastNewline);
+    } else {
+        state.col_num += static_cast<long long>(length);
+    }
+    cursor = to;
+    state.offset = static_cast<size_t>(cursor - begin);
+}
+
+// Emit [cursor, to) as a token of the given type
+int HandLexer::token(int type, const char* to) {
+    size_t length = static_cast<size_t>(to - cursor);
+    state.token_text = cursor;
+    state.token_length = length;
+    state.token_offset = static_cast<size_t>(cursor - begin);
+    state.col_num += static_cast<long long>(length);
+    cursor = to;
+    state.offset = static_cast<size_t>(cursor - begin);
+    return type;
+}
+
+void HandLexer::error(const char* message) {
+    snprintf(state.error_message, sizeof(state.error_message),
+             "LEXICAL ERROR at Line %lld, Col %lld: %s", state.line_num, state.col_num, message);
+    if (state.print_errors) {
+        fprintf(stderr, "%s\n", state.error_message);
+    }
+}
+
+int HandLexer::next() {
+    for (;;) {
+        const char* p = scan_skip_whitespace(cursor, end);
+        if (p != cursor) {
+            skip(p);
+        }
+        if (cursor == end) {
+            return 0;
+        }
+        if (cursor[0] == '/' && cursor + 1 < end && cursor[1] == '*') {
+            const char* close = scan_find_comment_end(cursor + 2, end);
+            if (close == end) {
+                return unclosedComment();
+            }
+            skip(close + 2);
+            continue;
+        }
+        break;
+    }
+
+    const char* p = cursor;
+    unsigned char cls = charClass(*p);
+    if (cls & CC_LETTER) {
+        return scanIdentifier();
+    }
+    if (cls & CC_DIGIT) {
+        return scanNumber();
+    }
+
+    bool hasNext = p + 1 < end;
+    switch (*p) {
+        case '+': return token(PLUS, p + 1);
+        case '-': return token(MINUS, p + 1);
+        case '*': return token(TIMES, p + 1);
+        case '/': return token(DIVIDE, p + 1);
+        case ';': return token(SEMI, p + 1);
+        case ',': return token(COMMA, p + 1);
+        case '(': return token(LPAREN, p + 1);
+        case ')': return token(RPAREN, p + 1);
+        case '[': return token(LBRACKET, p + 1);
+        case ']': return token(RBRACKET, p + 1);
+        case '{': return token(LBRACE, p + 1);
+        case '}': return token(RBRACE, p + 1);
+        case '.': return token(DOT, p + 1);
+        case '<': return (hasNext && p[1] == '=') ? token(LTE, p + 2) : token(LT, p + 1);
+        case '>': return (hasNext && p[1] == '=') ? token(GTE, p + 2) : token(GT, p + 1);
+        case '=': return (hasNext && p[1] == '=') ? token(EQ, p + 2) : token(ASSIGN, p + 1);
+        case '!':
+            if (hasNext && p[1] == '=') {
+                return token(NEQ, p + 2);
+            }
+            return invalidCharacter();
+        default:
+            return invalidCharacter();
+    }
+}
+
+// ID ::= LETTER (LETTER|DIGIT)* ([.#$_]? (LETTER|DIGIT)+)?
+int HandLexer::scanIdentifier() {
+    const char* p = cursor + 1;
+    while (p < end && isAlnum(*p)) {
+        p++;
+    }
+
+    // The optional second part needs a separator followed by at least one
+    // letter or digit (without a separator it would already be consumed)
+    if (p + 1 < end && (charClass(*p) & CC_IDSEP) && isAlnum(p[1])) {
+        p += 2;
+        while (p < end && isAlnum(*p)) {
+            p++;
+        }
+        return token(ID, p);
+    }
+
+    const Keyword* keyword = findKeyword(cursor, static_cast<size_t>(p - cursor));
+    if (keyword) {
+        int type = token(keyword->type, p);
+        state.token_text = keyword->spelling;
+        return type;
+    }
+    return token(ID, p);
+}
+
+// NUM ::= DIGIT+ ("." DIGIT*)? ([eE] [+-]? DIGIT+)?
+int HandLexer::scanNumber() {
+    const char* p = cursor + 1;
+    while (p < end && isDigit(*p)) {
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && isDigit(*p)) {
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        if (q < end && (*q == '+' || *q == '-')) {
+            q++;
+        }
+        if (q < end && isDigit(*q)) {
+            while (q < end && isDigit(*q)) {
+                q++;
+            }
+            p = q;
+        }
+    }
+    return token(NUM, p);
+}
+
+int HandLexer::invalidCharacter() {
+    char msg[256];
+    snprintf(msg, sizeof(msg), "Invalid character '%c' (ASCII %d)", cursor[0], cursor[0]);
+    error(msg);
+    return token(ERROR, cursor + 1);
+}
+
+int HandLexer::unclosedComment() {
+    state.comment_start_line = state.line_num;
+    state.comment_start_col = state.col_num;
+    skip(end);
+    error("Unclosed comment");
+    state.token_text = "";
+    state.token_length = 0;
+    state.token_offset = state.offset;
+    return ERROR;
+}
@@ -0,0 +1,45 @@
+#ifndef HANDLEXER_H
+#define HANDLEXER_H
+
+#include "token.h"
+#include <cstddef>
+
+/*
+ * Hand-written scanner for C-, an alternative to the flex backend.
+ *
+ * It scans an in-memory buffer in place and reports tokens, positions and
+ * errors through the same LexerState as the flex scanner, with identical
+ * results: the same longest-match rules, canonical keyword spellings and
+ * byte-based line/column counting. Identifiers are scanned with a single
+ * character-class table and keywords are recognised with a compile-time
+ * perfect hash over the case-folded identifier.
+ */
+class HandLexer {
+public:
+    HandLexer(const char* data, size_t size, LexerState& state);
+
+    // Scan another buffer from its start (the state is reset by the caller)
+    void reset(const char* data, size_t size) {
+        begin = cursor = data;
+        end = data + size;
+    }
+
+    // Scan the next token; returns 0 at end of input
+    int next();
+
+private:
+    const char* begin;
+    const char* cursor;
+    const char* end;
+    LexerState& state;
+
+    void skip(const char* to);
+    int token(int type, const char* to);
+    int scanIdentifier();
+    int scanNumber();
+    int invalidCharacter();
+    int unclosedComment();
+    void error(const char* message);
+};
+
+#endif /* HANDLEXER_H */
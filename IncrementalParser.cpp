@@ -0,0 +1,1230 @@
+#include "IncrementalParser.h"
+#include "Lexer.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+using namespace std;
+
+void CountTree::assign(const vector<size_t>& counts) {
+    // Each node adds itself to its parent once complete: linear time
+    tree.assign(counts.size() + 1, 0);
+    for (size_t i = 1; i < tree.size(); i++) {
+        tree[i] += counts[i - 1];
+        size_t parent = i + (i & (0 - i));
+        if (parent < tree.size()) {
+            tree[parent] += tree[i];
+        }
+    }
+}
+
+void CountTree::add(size_t index, long long delta) {
+    for (size_t i = index + 1; i < tree.size(); i += i & (0 - i)) {
+        tree[i] = static_cast<size_t>(static_cast<long long>(tree[i]) + delta);
+    }
+}
+
+size_t CountTree::prefix(size_t n) const {
+    size_t sum = 0;
+    for (size_t i = n; i > 0; i -= i & (0 - i)) {
+        sum += tree[i];
+    }
+    return sum;
+}
+
+size_t CountTree::find(size_t target, size_t& before) const {
+    size_t n = size();
+    size_t step = 1;
+    while (step * 2 <= n) {
+        step *= 2;
+    }
+    size_t index = 0;
+    size_t rest = target;
+    for (; step > 0; step /= 2) {
+        if (index + step <= n && tree[index + step] <= rest) {
+            index += step;
+            rest -= tree[index];
+        }
+    }
+    before = target - rest;
+    return index;
+}
+
+void ChunkedDocument::clear() {
+    chunks.assign(1, Chunk{string(), vector<TokenRecord>(), 0});
+    reindex();
+}
+
+void ChunkedDocument::assign(const char* text, size_t size, const TokenBuffer& tokens) {
+    vector<TokenRecord> records;
+    records.reserve(tokens.size() - 1);
+    for (size_t i = 0; i + 1 < tokens.size(); i++) {
+        records.push_back(TokenRecord{tokens.type(i), tokens.offset(i), tokens.length(i)});
+    }
+    chunks.clear();
+    cut(text, size, records, chunks);
+    reindex();
+}
+
+// Split text (with its tokens) into chunks of about CHUNK_BYTES starting at
+// tokens, each holding at least one token; text up to twice that size
+// stays whole so that a chunk growing a little is not split off in slivers
+void ChunkedDocument::cut(const char* text, size_t size, const vector<TokenRecord>& tokens,
+                          vector<Chunk>& out) const {
+    size_t target = size > 2 * CHUNK_BYTES ? CHUNK_BYTES : SIZE_MAX;
+    size_t from = 0;
+    size_t pieceStart = 0;
+    do {
+        size_t to = from;
+        while (to < tokens.size() && (to == from || tokens[to].offset - pieceStart < target)) {
+            to++;
+        }
+        size_t pieceEnd = to < tokens.size() ? tokens[to].offset : size;
+
+        Chunk chunk;
+        chunk.text.assign(text + pieceStart, pieceEnd - pieceStart);
+        chunk.tokens.reserve(to - from);
+        for (size_t i = from; i < to; i++) {
+            TokenRecord token = tokens[i];
+            token.offset -= static_cast<uint32_t>(pieceStart);
+            chunk.tokens.push_back(token);
+        }
+        chunk.newlines = static_cast<size_t>(count(chunk.text.begin(), chunk.text.end(), '\n'));
+        out.push_back(move(chunk));
+
+        from = to;
+        pieceStart = pieceEnd;
+    } while (from < tokens.size());
+}
+
+void ChunkedDocument::reindex() {
+    vector<size_t> bytes, tokens, newlines;
+    bytes.reserve(chunks.size());
+    tokens.reserve(chunks.size());
+    newlines.reserve(chunks.size());
+    totalBytes = 0;
+    totalTokens = 0;
+    for (const Chunk& chunk : chunks) {
+        bytes.push_back(chunk.text.size());
+        tokens.push_back(chunk.tokens.size());
+        newlines.push_back(chunk.newlines);
+        totalBytes += chunk.text.size();
+        totalTokens += chunk.tokens.size();
+    }
+    chunkBytes.assign(bytes);
+    chunkTokens.assign(tokens);
+    chunkNewlines.assign(newlines);
+}
+
+// Chunk holding a byte (the last chunk for the end of the text)
+size_t ChunkedDocument::chunkOfByte(size_t offset, size_t& start) const {
+    if (offset >= totalBytes) {
+        start = totalBytes - chunks.back().text.size();
+        return chunks.size() - 1;
+    }
+    return chunkBytes.find(offset, start);
+}
+
+size_t ChunkedDocument::chunkOfToken(size_t index, size_t& first) const {
+    return chunkTokens.find(index, first);
+}
+
+template <typename Visit>
+void ChunkedDocument::forEachToken(size_t first, size_t count, Visit visit) const {
+    if (first >= totalTokens) {
+        return;
+    }
+    count = min(count, totalTokens - first);
+    size_t before;
+    size_t c = chunkOfToken(first, before);
+    size_t base = chunkBytes.prefix(c);
+    size_t i = first - before;
+    while (count > 0) {
+        const Chunk& chunk = chunks[c];
+        for (; i < chunk.tokens.size() && count > 0; i++, count--) {
+            TokenRecord token = chunk.tokens[i];
+            token.offset += static_cast<uint32_t>(base);
+            visit(token);
+        }
+        base += chunk.text.size();
+        c++;
+        i = 0;
+    }
+}
+
+TokenRecord ChunkedDocument::token(size_t index) const {
+    size_t before;
+    size_t c = chunkOfToken(index, before);
+    TokenRecord token = chunks[c].tokens[index - before];
+    token.offset += static_cast<uint32_t>(chunkBytes.prefix(c));
+    return token;
+}
+
+void ChunkedDocument::readTokens(size_t first, size_t count, vector<TokenRecord>& out) const {
+    forEachToken(first, count, [&out](const TokenRecord& token) { out.push_back(token); });
+}
+
+size_t ChunkedDocument::tokenReaching(size_t offset) const {
+    if (totalTokens == 0) {
+        return 0;
+    }
+    size_t start;
+    size_t c = chunkOfByte(offset, start);
+    size_t before = chunkTokens.prefix(c);
+
+    // Tokens of earlier chunks end at or before this one's start, but the
+    // last of them may end right at offset
+    if (before > 0) {
+        TokenRecord previous = token(before - 1);
+        if (previous.offset + previous.length >= offset) {
+            return before - 1;
+        }
+    }
+
+    const vector<TokenRecord>& tokens = chunks[c].tokens;
+    size_t within = offset - start;
+    auto it = lower_bound(tokens.begin(), tokens.end(), within, [](const TokenRecord& token, size_t at) {
+        return token.offset + token.length < at;
+    });
+    return before + static_cast<size_t>(it - tokens.begin());
+}
+
+void ChunkedDocument::copyText(size_t from, size_t to, string& out) const {
+    if (from >= to) {
+        return;
+    }
+    size_t start;
+    size_t c = chunkOfByte(from, start);
+    size_t within = from - start;
+    while (from < to) {
+        const string& text = chunks[c].text;
+        size_t n = min(text.size() - within, to - from);
+        out.append(text, within, n);
+        from += n;
+        c++;
+        within = 0;
+    }
+}
+
+void ChunkedDocument::position(size_t offset, long long& line, long long& col) const {
+    size_t start;
+    size_t c = chunkOfByte(offset, start);
+    const string& text = chunks[c].text;
+    size_t within = offset - start;
+    size_t newlinesBefore = chunkNewlines.prefix(c);
+    line = static_cast<long long>(newlinesBefore + count(text.begin(), text.begin() + within, '\n')) + 1;
+
+    // The line starts after the last newline before offset, which is in
+    // this chunk or is the last one of an earlier chunk
+    size_t lineStart = 0;
+    const char* newline = static_cast<const char*>(memrchr(text.data(), '\n', within));
+    if (newline) {
+        lineStart = start + static_cast<size_t>(newline - text.data()) + 1;
+    } else if (newlinesBefore > 0) {
+        size_t ignored;
+        size_t holder = chunkNewlines.find(newlinesBefore - 1, ignored);
+        const string& earlier = chunks[holder].text;
+        newline = static_cast<const char*>(memrchr(earlier.data(), '\n', earlier.size()));
+        lineStart = chunkBytes.prefix(holder) + static_cast<size_t>(newline - earlier.data()) + 1;
+    }
+    col = static_cast<long long>(offset - lineStart) + 1;
+}
+
+void ChunkedDocument::replace(const TextEdit& edit, size_t first, size_t last, const vector<TokenRecord>& fresh) {
+    long long shift = static_cast<long long>(edit.text.size()) - static_cast<long long>(edit.length);
+
+    // Chunks [low, high) hold the edited bytes and the replaced tokens, up
+    // to the first token kept, whose offset changes
+    size_t from = edit.offset;
+    if (first < totalTokens) {
+        from = min(from, static_cast<size_t>(token(first).offset));
+    }
+    size_t regionStart;
+    size_t low = chunkOfByte(from, regionStart);
+    size_t high = chunks.size();
+    if (last < totalTokens) {
+        size_t ignored;
+        high = chunkOfToken(last, ignored) + 1;
+    }
+
+    // An edit within one chunk that leaves it a fair size is made in place
+    size_t regionBytes = chunkBytes.prefix(high) - regionStart;
+    long long newBytes = static_cast<long long>(regionBytes) + shift;
+    if (high - low == 1 && newBytes <= static_cast<long long>(2 * CHUNK_BYTES) &&
+        (newBytes >= static_cast<long long>(CHUNK_BYTES / 4) || chunks.size() == 1)) {
+        Chunk& chunk = chunks[low];
+        auto removed = chunk.text.begin() + static_cast<ptrdiff_t>(edit.offset - regionStart);
+        size_t newlines = chunk.newlines - static_cast<size_t>(count(removed, removed + static_cast<ptrdiff_t>(edit.length), '\n')) +
+                          static_cast<size_t>(count(edit.text.begin(), edit.text.end(), '\n'));
+        chunk.text.replace(edit.offset - regionStart, edit.length, edit.text);
+
+        size_t before = chunkTokens.prefix(low);
+        auto at = chunk.tokens.erase(chunk.tokens.begin() + static_cast<ptrdiff_t>(first - before),
+                                     chunk.tokens.begin() + static_cast<ptrdiff_t>(last - before));
+        for (auto it = at; it != chunk.tokens.end(); ++it) {
+            it->offset = static_cast<uint32_t>(static_cast<long long>(it->offset) + shift);
+        }
+        at = chunk.tokens.insert(at, fresh.begin(), fresh.end());
+        for (size_t i = 0; i < fresh.size(); i++, ++at) {
+            at->offset -= static_cast<uint32_t>(regionStart);
+        }
+
+        long long tokenDelta = static_cast<long long>(fresh.size()) - static_cast<long long>(last - first);
+        chunkBytes.add(low, shift);
+        chunkTokens.add(low, tokenDelta);
+        chunkNewlines.add(low, static_cast<long long>(newlines) - static_cast<long long>(chunk.newlines));
+        chunk.newlines = newlines;
+        totalBytes = static_cast<size_t>(static_cast<long long>(totalBytes) + shift);
+        totalTokens = static_cast<size_t>(static_cast<long long>(totalTokens) + tokenDelta);
+        return;
+    }
+
+    // Otherwise the chunks are cut again, folding a region that became
+    // small into a neighbour
+    while (static_cast<long long>(regionBytes) + shift < static_cast<long long>(CHUNK_BYTES / 4) &&
+           high - low < chunks.size()) {
+        if (high < chunks.size()) {
+            regionBytes += chunks[high++].text.size();
+        } else {
+            low--;
+            regionStart -= chunks[low].text.size();
+            regionBytes += chunks[low].text.size();
+        }
+    }
+
+    string text;
+    text.reserve(regionBytes + edit.text.size());
+    for (size_t c = low; c < high; c++) {
+        text += chunks[c].text;
+    }
+    text.replace(edit.offset - regionStart, edit.length, edit.text);
+
+    // Tokens before first keep their offsets, those from last on move with
+    // the text; all become relative to the region
+    vector<TokenRecord> tokens;
+    size_t index = chunkTokens.prefix(low);
+    size_t base = 0;
+    for (size_t c = low; c < high; c++) {
+        for (TokenRecord token : chunks[c].tokens) {
+            if (index++ < first) {
+                token.offset += static_cast<uint32_t>(base);
+                tokens.push_back(token);
+            }
+        }
+        base += chunks[c].text.size();
+    }
+    for (TokenRecord token : fresh) {
+        token.offset -= static_cast<uint32_t>(regionStart);
+        tokens.push_back(token);
+    }
+    index = chunkTokens.prefix(low);
+    base = 0;
+    for (size_t c = low; c < high; c++) {
+        for (TokenRecord token : chunks[c].tokens) {
+            if (index++ >= last) {
+                token.offset = static_cast<uint32_t>(static_cast<long long>(base + token.offset) + shift);
+                tokens.push_back(token);
+            }
+        }
+        base += chunks[c].text.size();
+    }
+
+    vector<Chunk> pieces;
+    cut(text.data(), text.size(), tokens, pieces);
+    if (pieces.size() == high - low) {
+        for (size_t i = 0; i < pieces.size(); i++) {
+            Chunk& chunk = chunks[low + i];
+            chunkBytes.add(low + i, static_cast<long long>(pieces[i].text.size()) -
+                                        static_cast<long long>(chunk.text.size()));
+            chunkTokens.add(low + i, static_cast<long long>(pieces[i].tokens.size()) -
+                                         static_cast<long long>(chunk.tokens.size()));
+            chunkNewlines.add(low + i, static_cast<long long>(pieces[i].newlines) -
+                                           static_cast<long long>(chunk.newlines));
+            chunk = move(pieces[i]);
+        }
+        totalBytes = static_cast<size_t>(static_cast<long long>(totalBytes) + shift);
+        totalTokens = totalTokens + fresh.size() - (last - first);
+    } else {
+        chunks.erase(chunks.begin() + low, chunks.begin() + high);
+        chunks.insert(chunks.begin() + low, make_move_iterator(pieces.begin()), make_move_iterator(pieces.end()));
+        reindex();
+    }
+}
+
+size_t ChunkedDocument::window(size_t from, size_t first, size_t count, string& text, TokenBuffer& buffer) const {
+    count = first < totalTokens ? min(count, totalTokens - first) : 0;
+    size_t to = from;
+    if (first + count >= totalTokens) {
+        to = totalBytes;
+    } else if (count > 0) {
+        TokenRecord last = token(first + count - 1);
+        to = last.offset + last.length;
+    }
+
+    text.clear();
+    copyText(from, to, text);
+    long long line, col;
+    position(from, line, col);
+    buffer.reset(text.data(), text.size(), line, col);
+    forEachToken(first, count, [&buffer, from](const TokenRecord& token) {
+        buffer.append(token.type, static_cast<uint32_t>(token.offset - from), token.length);
+    });
+    return count;
+}
+
+void ListIndex::assign(const vector<Entry>& entries, ParseTreeNode* listTail) {
+    tail = listTail;
+    count = entries.size();
+    blocks.clear();
+    vector<size_t> tokens;
+    for (size_t i = 0; i < entries.size(); i += BLOCK) {
+        blocks.emplace_back(entries.begin() + i, entries.begin() + min(i + BLOCK, entries.size()));
+        tokens.push_back(blockSum(blocks.back()));
+    }
+    reindex(tokens);
+}
+
+size_t ListIndex::blockSum(const vector<Entry>& block) {
+    size_t sum = 0;
+    for (const Entry& entry : block) {
+        sum += entry.tokens;
+    }
+    return sum;
+}
+
+// Rebuild the prefix sums, given each block's token count
+void ListIndex::reindex(const vector<size_t>& tokens) {
+    vector<size_t> sizes;
+    sizes.reserve(blocks.size());
+    for (const vector<Entry>& block : blocks) {
+        sizes.push_back(block.size());
+    }
+    blockSizes.assign(sizes);
+    blockTokens.assign(tokens);
+}
+
+// Block holding element index (the end of the last block for size())
+size_t ListIndex::locate(size_t index, size_t& offset) const {
+    if (blocks.empty()) {
+        offset = 0;
+        return 0;
+    }
+    if (index >= count) {
+        offset = blocks.back().size();
+        return blocks.size() - 1;
+    }
+    size_t before;
+    size_t block = blockSizes.find(index, before);
+    offset = index - before;
+    return block;
+}
+
+const ListIndex::Entry& ListIndex::at(size_t index) const {
+    size_t offset;
+    size_t block = locate(index, offset);
+    return blocks[block][offset];
+}
+
+size_t ListIndex::find(size_t token, size_t& elementStart) const {
+    size_t before;
+    size_t block = blockTokens.find(token, before);
+    if (block >= blocks.size()) {
+        elementStart = before;
+        return count;
+    }
+    size_t index = blockSizes.prefix(block);
+    for (const Entry& entry : blocks[block]) {
+        if (token < before + entry.tokens) {
+            break;
+        }
+        before += entry.tokens;
+        index++;
+    }
+    elementStart = before;
+    return index;
+}
+
+void ListIndex::setTokens(size_t index, size_t tokens) {
+    size_t offset;
+    size_t block = locate(index, offset);
+    Entry& entry = blocks[block][offset];
+    blockTokens.add(block, static_cast<long long>(tokens) - static_cast<long long>(entry.tokens));
+    entry.tokens = tokens;
+}
+
+void ListIndex::replace(size_t first, size_t last, const vector<Entry>& entries) {
+    bool resized = blocks.empty();
+    if (resized) {
+        blocks.emplace_back();
+    }
+    size_t firstOffset, lastOffset;
+    size_t low = locate(first, firstOffset);
+    size_t high = locate(last, lastOffset) + 1;
+
+    vector<Entry> merged(blocks[low].begin(), blocks[low].begin() + firstOffset);
+    merged.insert(merged.end(), entries.begin(), entries.end());
+    merged.insert(merged.end(), blocks[high - 1].begin() + lastOffset, blocks[high - 1].end());
+    // Fold a block that became small into the next one
+    while (merged.size() < BLOCK / 4 && high < blocks.size()) {
+        merged.insert(merged.end(), blocks[high].begin(), blocks[high].end());
+        high++;
+    }
+    count = count - (last - first) + entries.size();
+
+    vector<vector<Entry>> pieces;
+    size_t piece = merged.size() > 2 * BLOCK ? BLOCK : merged.size();
+    for (size_t i = 0; i < merged.size(); i += piece) {
+        pieces.emplace_back(merged.begin() + i, merged.begin() + min(i + piece, merged.size()));
+    }
+
+    if (!resized && pieces.size() == high - low) {
+        for (size_t i = 0; i < pieces.size(); i++) {
+            blockSizes.add(low + i, static_cast<long long>(pieces[i].size()) -
+                                        static_cast<long long>(blocks[low + i].size()));
+            blockTokens.add(low + i, static_cast<long long>(blockSum(pieces[i])) -
+                                         static_cast<long long>(blockSum(blocks[low + i])));
+            blocks[low + i] = move(pieces[i]);
+        }
+    } else {
+        // The counts of the blocks kept are read back from the old sums
+        vector<size_t> tokens;
+        for (size_t b = 0; b < low; b++) {
+            tokens.push_back(blockTokens.prefix(b + 1) - blockTokens.prefix(b));
+        }
+        for (const vector<Entry>& piece : pieces) {
+            tokens.push_back(blockSum(piece));
+        }
+        for (size_t b = high; b < blocks.size(); b++) {
+            tokens.push_back(blockTokens.prefix(b + 1) - blockTokens.prefix(b));
+        }
+        blocks.erase(blocks.begin() + low, blocks.begin() + high);
+        blocks.insert(blocks.begin() + low, make_move_iterator(pieces.begin()), make_move_iterator(pieces.end()));
+        reindex(tokens);
+    }
+}
+
+// Lists below this many elements are indexed only once an edit reaches them
+static const size_t INDEXED_LIST = 32;
+
+// Bytes scanned past a relexed token before it is trusted: more than any
+// token's lookahead, so the scanner saw the same text as in the document
+static const size_t LEXER_LOOKAHEAD = 16;
+
+// Tokens covered by a node: one for a terminal, none for epsilon
+static size_t spannedTokens(const ParseTreeNode* node) {
+    switch (node->kind) {
+        case NODE_TERMINAL:    return 1;
+        case NODE_NONTERMINAL: return node->tokenCount;
+        default:               return 0;
+    }
+}
+
+static bool isList(const ParseTreeNode* node) {
+    return node->kind == NODE_NONTERMINAL &&
+           (node->rule == RULE_STATEMENT_LIST || node->rule == RULE_DECLARATION_LIST);
+}
+
+static bool isListPrime(const ParseTreeNode* node) {
+    return node->kind == NODE_NONTERMINAL &&
+           (node->rule == RULE_STATEMENT_LIST_PRIME || node->rule == RULE_DECLARATION_LIST_PRIME);
+}
+
+// Elements of a list in order, each with the node holding it, and the node
+// holding the list's epsilon, whether the ' chain is kept or flattened
+static void collectElements(ParseTreeNode* list, vector<ListIndex::Entry>& entries, ParseTreeNode*& tail) {
+    ParseTreeNode* holder = list;
+    for (;;) {
+        ParseTreeNode* next = nullptr;
+        for (ParseTreeNode* child = holder->firstChild; child; child = child->nextSibling) {
+            if (isListPrime(child)) {
+                next = child;
+            } else if (child->kind == NODE_NONTERMINAL) {
+                entries.push_back(ListIndex::Entry{child, holder, child->tokenCount});
+            }
+        }
+        if (!next) {
+            tail = holder;
+            return;
+        }
+        holder = next;
+    }
+}
+
+static void replaceChild(ParseTreeNode* parent, ParseTreeNode* oldChild, ParseTreeNode* newChild) {
+    newChild->nextSibling = oldChild->nextSibling;
+    if (parent->firstChild == oldChild) {
+        parent->firstChild = newChild;
+    } else {
+        ParseTreeNode* prev = parent->firstChild;
+        while (prev->nextSibling != oldChild) {
+            prev = prev->nextSibling;
+        }
+        prev->nextSibling = newChild;
+    }
+    if (parent->lastChild == oldChild) {
+        parent->lastChild = newChild;
+    }
+}
+
+// Whether a token of this type starts an element of the list
+static bool startsElement(const ParseTreeNode* list, TokenType type) {
+    if (list->rule == RULE_DECLARATION_LIST) {
+        return type == INT || type == FLOAT;
+    }
+    return type == ID || type == IF || type == WHILE || type == LBRACE;
+}
+
+// Node memory has grown well past the live tree: discarded subtrees
+// outweigh it
+static bool outgrown(const Parser& parser, size_t bytesAfterFullParse) {
+    return parser.treeBytes() > 2 * bytesAfterFullParse + (1 << 20);
+}
+
+IncrementalParser::IncrementalParser(const ParserOptions& opts)
+    : options(opts), root(nullptr), broken(true), damageFirst(0), damageEnd(0), damageDelta(0),
+      bytesAfterFullParse(0), flatTextValid(false), flatTokensValid(false) {
+    // A reparsed part must stop at the first error, where a full parse
+    // reports it, so error recovery stays off
+    options.maxErrors = 1;
+    parse(string_view());
+}
+
+// Set tokenCount on every nonterminal of a subtree, and index its long
+// lists. Nonterminals are collected parents-first, then summed in reverse
+// so children are done before their parent.
+void IncrementalParser::countTokens(ParseTreeNode* subtree) {
+    vector<ParseTreeNode*> order;
+    vector<ParseTreeNode*> stack;
+    stack.push_back(subtree);
+    while (!stack.empty()) {
+        ParseTreeNode* node = stack.back();
+        stack.pop_back();
+        if (node->kind != NODE_NONTERMINAL) {
+            continue;
+        }
+        order.push_back(node);
+        for (ParseTreeNode* child = node->firstChild; child; child = child->nextSibling) {
+            stack.push_back(child);
+        }
+    }
+
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        size_t count = 0;
+        for (ParseTreeNode* child = (*it)->firstChild; child; child = child->nextSibling) {
+            count += spannedTokens(child);
+        }
+        (*it)->tokenCount = static_cast<uint32_t>(count);
+    }
+
+    vector<ListIndex::Entry> entries;
+    for (ParseTreeNode* node : order) {
+        if (isList(node)) {
+            ParseTreeNode* tail;
+            entries.clear();
+            collectElements(node, entries, tail);
+            if (entries.size() >= INDEXED_LIST) {
+                lists[node].assign(entries, tail);
+            }
+        }
+    }
+}
+
+ListIndex& IncrementalParser::listIndex(ParseTreeNode* list) {
+    auto it = lists.find(list);
+    if (it != lists.end()) {
+        return it->second;
+    }
+    vector<ListIndex::Entry> entries;
+    ParseTreeNode* tail;
+    collectElements(list, entries, tail);
+    ListIndex& index = lists[list];
+    index.assign(entries, tail);
+    return index;
+}
+
+ParseTreeNode* IncrementalParser::parse(string_view text) {
+    stats = IncrementalStats{0, 0, 0, 0};
+    flatTextValid = false;
+    flatTokensValid = false;
+    root = nullptr;
+    lists.clear();
+
+    if (text.size() > UINT32_MAX) {
+        // Leave an empty but consistent document behind
+        parse(string_view());
+        errorMessage = "Input is too large for incremental parsing (4 GB limit)";
+        return nullptr;
+    }
+    InputBuffer input;
+    input.copy(text.data(), text.size());
+    TokenBuffer tokens;
+    tokens.tokenize(input, options.lexerBackend, false);
+    document.assign(input.data(), input.size(), tokens);
+    stats.relexedBytes = text.size();
+    stats.relexedTokens = tokens.size() - 1;
+
+    fullReparse();
+    return tree();
+}
+
+void IncrementalParser::fullReparse() {
+    document.window(0, 0, document.tokenCount(), windowText, window);
+    unique_ptr<Parser> full(new Parser(window, options));
+    ParseTreeNode* tree = full->parse();
+    errorMessage = full->getErrorMessage();
+    stats.reparsedTokens += document.tokenCount();
+    stats.fullReparses++;
+
+    // A failed parse leaves the last good tree in place, to be repaired
+    // by a later edit, unless there is none or its memory is mostly waste
+    if (tree || !root || outgrown(*parser, bytesAfterFullParse)) {
+        parser = move(full);
+        root = tree;
+        lists.clear();
+        if (root) {
+            countTokens(root);
+        }
+        bytesAfterFullParse = parser->treeBytes();
+        damageFirst = 0;
+        damageEnd = 0;
+        damageDelta = 0;
+    }
+    broken = tree == nullptr;
+}
+
+bool IncrementalParser::applyEdits(const vector<TextEdit>& edits) {
+    // Check every edit against the text size it will see before changing
+    // anything
+    size_t size = document.size();
+    for (const TextEdit& edit : edits) {
+        if (edit.offset > size || edit.length > size - edit.offset) {
+            return false;
+        }
+        size = size - edit.length + edit.text.size();
+    }
+    if (size > UINT32_MAX) {
+        return false;
+    }
+
+    stats = IncrementalStats{0, 0, 0, 0};
+    flatTextValid = false;
+    flatTokensValid = false;
+    for (const TextEdit& edit : edits) {
+        applyEdit(edit);
+    }
+    return true;
+}
+
+void IncrementalParser::applyEdit(const TextEdit& edit) {
+    size_t tokenCount = document.tokenCount();
+    size_t size = document.size();
+    size_t oldEnd = edit.offset + edit.length;
+    size_t editEnd = edit.offset + edit.text.size();
+    long long shift = static_cast<long long>(edit.text.size()) - static_cast<long long>(edit.length);
+
+    // The first damaged token is the first one reaching the edit (a token
+    // ending right at it may grow), or earlier: a token running straight
+    // into the damaged one may grow into what is left of it ("2eif9" less
+    // "if" is one number). Scanning restarts after a token followed by a
+    // gap: between tokens the scanner carries no state.
+    size_t first = document.tokenReaching(edit.offset);
+    size_t start = 0;
+    while (first > 0) {
+        TokenRecord before = document.token(first - 1);
+        start = before.offset + before.length;
+        if (first == tokenCount || start < document.token(first).offset) {
+            break;
+        }
+        first--;
+        start = 0;
+    }
+
+    // Relex until a token starts past the edit at the same place, with the
+    // same type and length, as an old token: from there on the old tokens
+    // are still valid, only shifted. The edited text is copied out a
+    // stretch at a time; a token is trusted only if the copy goes on past
+    // it, otherwise the copy is lengthened and the scan repeated.
+    vector<TokenRecord> old;        // Old tokens from first on, read as needed
+    vector<TokenRecord> fresh;
+    string scanned;
+    size_t last = tokenCount;
+    size_t scannedTo = 0;
+    for (size_t slack = 256;; slack *= 4) {
+        size_t copyEnd = min(size, oldEnd + slack);
+        bool whole = copyEnd == size;
+        scanned.clear();
+        document.copyText(start, edit.offset, scanned);
+        scanned += edit.text;
+        document.copyText(oldEnd, copyEnd, scanned);
+        size_t limit = start + scanned.size();
+        scanned.append(2, '\0');
+
+        InputBuffer input;
+        input.wrap(&scanned[0], scanned.size() - 2);
+        Lexer lexer(input, options.lexerBackend);
+        lexer.setPrintErrors(false);
+
+        fresh.clear();
+        last = tokenCount;
+        scannedTo = limit;
+        bool resynced = false;
+        bool truncated = false;
+        size_t k = 0;
+        int token;
+        while ((token = lexer.next()) != 0) {
+            size_t offset = start + lexer.offset();
+            size_t length = lexer.lexeme().size();
+            if (!whole && offset + length + LEXER_LOOKAHEAD > limit) {
+                truncated = true;
+                break;
+            }
+            if (offset >= editEnd) {
+                size_t oldOffset = static_cast<size_t>(static_cast<long long>(offset) - shift);
+                for (;;) {
+                    if (k == old.size()) {
+                        document.readTokens(first + k, 64, old);
+                    }
+                    if (k == old.size() || old[k].offset >= oldOffset) {
+                        break;
+                    }
+                    k++;
+                }
+                if (k < old.size() && old[k].offset == oldOffset && old[k].type == token &&
+                    old[k].length == length) {
+                    last = first + k;
+                    scannedTo = offset;
+                    resynced = true;
+                    break;
+                }
+            }
+            fresh.push_back(TokenRecord{static_cast<TokenType>(token), static_cast<uint32_t>(offset),
+                                        static_cast<uint32_t>(length)});
+        }
+        if (!truncated && (resynced || whole)) {
+            break;
+        }
+    }
+    stats.relexedBytes += scannedTo - start;
+    stats.relexedTokens += fresh.size();
+
+    document.replace(edit, first, last, fresh);
+    long long tokenDelta = static_cast<long long>(fresh.size()) - static_cast<long long>(last - first);
+    bool tokensChanged = last > first || !fresh.empty();
+
+    if (!root) {
+        // No tree to reuse until the text has parsed once
+        fullReparse();
+        return;
+    }
+    if (!broken) {
+        if (!tokensChanged) {
+            // Only whitespace or comments changed
+            return;
+        }
+        damageFirst = first;
+        damageEnd = first + fresh.size();
+        damageDelta = tokenDelta;
+    } else if (tokensChanged) {
+        // Widen the damage to cover this change too. Even when only
+        // whitespace changed it is reparsed again below, as the error may
+        // have moved.
+        damageEnd = static_cast<size_t>(static_cast<long long>(max(damageEnd, last)) + tokenDelta);
+        damageFirst = min(damageFirst, first);
+        damageDelta += tokenDelta;
+    }
+
+    Repair repair = reparseDamage();
+    if (repair == REPAIRED) {
+        broken = false;
+        errorMessage.clear();
+    } else if (repair == SYNTAX_ERROR) {
+        broken = true;
+    }
+    if (repair == NOT_LOCAL || outgrown(*parser, bytesAfterFullParse)) {
+        fullReparse();
+    }
+}
+
+// Parse rule from token first with a window of the document holding reach
+// tokens and the one after them. A parse that stops at the window's end may
+// have needed more, so it is repeated with a larger window.
+ParseTreeNode* IncrementalParser::parseAt(RuleId rule, size_t first, size_t reach, size_t& end) {
+    size_t from = first < document.tokenCount() ? document.token(first).offset : document.size();
+    for (size_t want = max<size_t>(reach + 1, 64);; want *= 4) {
+        size_t taken = document.window(from, first, want, windowText, window);
+        ParseTreeNode* node = parser->parseFragment(rule, 0, end);
+        if (end >= taken && first + taken < document.tokenCount()) {
+            continue;
+        }
+        stats.reparsedTokens += end;
+        end += first;
+        return node;
+    }
+}
+
+IncrementalParser::Repair IncrementalParser::reparseDamage() {
+    size_t first = damageFirst;
+    size_t oldLast = static_cast<size_t>(static_cast<long long>(damageEnd) - damageDelta);
+
+    // Path from the root to the deepest nonterminal whose old token span
+    // covers the old tokens [first, oldLast); lists are searched through
+    // their index
+    vector<Step> path;
+    path.push_back(Step{root, nullptr, 0, nullptr, 0});
+    for (;;) {
+        Step here = path.back();
+        if (isList(here.node)) {
+            ListIndex& index = listIndex(here.node);
+            size_t elementStart;
+            size_t element = index.find(first - here.start, elementStart);
+            if (element == index.size()) {
+                break;
+            }
+            const ListIndex::Entry& entry = index.at(element);
+            size_t start = here.start + elementStart;
+            if (oldLast > start + entry.tokens) {
+                break;
+            }
+            path.push_back(Step{entry.element, entry.holder, start, here.node, element});
+            continue;
+        }
+
+        ParseTreeNode* next = nullptr;
+        size_t childStart = here.start;
+        for (ParseTreeNode* child = here.node->firstChild; child; child = child->nextSibling) {
+            size_t count = spannedTokens(child);
+            if (child->kind == NODE_NONTERMINAL && childStart <= first && oldLast <= childStart + count) {
+                next = child;
+                break;
+            }
+            childStart += count;
+            if (childStart > first) {
+                break;
+            }
+        }
+        if (!next) {
+            break;
+        }
+        path.push_back(Step{next, here.node, childStart, nullptr, 0});
+    }
+
+    // Try the smallest part first: a run of list elements, or a statement,
+    // compound-stmt or expression that is not a list element. A part
+    // ending before where an earlier reparse ran on to is skipped, as it
+    // would run on the same way. An edit that changes the nesting (a stray
+    // "{" or "}") can fail every part up to the root; once the parts tried
+    // have cost half a full parse, a full parse is cheaper.
+    size_t reached = 0;
+    size_t budget = stats.reparsedTokens + document.tokenCount() / 2;
+    for (size_t depth = path.size(); depth-- > 0;) {
+        const Step& step = path[depth];
+        if (stats.reparsedTokens > budget) {
+            return NOT_LOCAL;
+        }
+        if (static_cast<long long>(step.start + step.node->tokenCount) + damageDelta <
+            static_cast<long long>(reached)) {
+            continue;
+        }
+        Repair repair = NOT_LOCAL;
+        RuleId rule = step.node->rule;
+        if (isList(step.node)) {
+            repair = reparseRun(step, reached);
+            // Tokens inserted between the declarations and the statements
+            // lie at the end of the declaration-list, but may well start
+            // the statement-list
+            ParseTreeNode* statements = step.node->nextSibling;
+            if (repair == NOT_LOCAL && step.node->rule == RULE_DECLARATION_LIST &&
+                step.start + step.node->tokenCount == first && statements && isList(statements)) {
+                repair = reparseRun(Step{statements, step.parent, first, nullptr, 0}, reached);
+            }
+        } else if (!step.list &&
+                   (rule == RULE_STATEMENT || rule == RULE_COMPOUND_STMT || rule == RULE_EXPRESSION)) {
+            repair = reparseSubtree(step, reached);
+        }
+
+        if (repair == REPAIRED) {
+            // The token delta applies to every enclosing node
+            for (size_t i = 0; i < depth; i++) {
+                ParseTreeNode* node = path[i].node;
+                node->tokenCount = static_cast<uint32_t>(node->tokenCount + damageDelta);
+                if (path[i].list) {
+                    lists[path[i].list].setTokens(path[i].element, node->tokenCount);
+                }
+            }
+        }
+        if (repair != NOT_LOCAL) {
+            return repair;
+        }
+    }
+    return NOT_LOCAL;
+}
+
+// Reparse a statement, compound-stmt or expression. It is only accepted if
+// it ends exactly where the old one did (moved by the token delta), so the
+// rest of the tree is what a full parse would build. A parse running on
+// past that end sets reached.
+IncrementalParser::Repair IncrementalParser::reparseSubtree(const Step& step, size_t& reached) {
+    size_t expectedEnd = static_cast<size_t>(static_cast<long long>(step.start + step.node->tokenCount) +
+                                             damageDelta);
+    size_t end;
+    ParseTreeNode* fresh = parseAt(step.node->rule, step.start, expectedEnd - step.start, end);
+    if (fresh && end == expectedEnd) {
+        countTokens(fresh);
+        replaceChild(step.parent, step.node, fresh);
+        return REPAIRED;
+    }
+    if (fresh && end > expectedEnd) {
+        reached = max(reached, end);
+    }
+
+    // Everything before the subtree is unchanged, so a full parse reaches
+    // it as before and fails the same way, unless the damaged token is a
+    // compound-stmt's "{", which chose the rule
+    if (!fresh && (step.node->rule != RULE_COMPOUND_STMT || step.start < damageFirst)) {
+        errorMessage = parser->getErrorMessage();
+        return SYNTAX_ERROR;
+    }
+    return NOT_LOCAL;
+}
+
+// Reparse elements of a list from the one holding the token before the
+// damage (the damaged token decided where that element ends) until, past
+// the damage, an element ends where an old element began or the old list
+// ended; those old elements are replaced with the new ones. A run going
+// past the end of the list sets reached.
+IncrementalParser::Repair IncrementalParser::reparseRun(const Step& step, size_t& reached) {
+    ParseTreeNode* list = step.node;
+    ListIndex& index = listIndex(list);
+    RuleId rule = list->rule == RULE_DECLARATION_LIST ? RULE_DECLARATION : RULE_STATEMENT;
+    size_t tokenCount = document.tokenCount();
+
+    size_t first = 0;
+    size_t runStart = step.start;
+    if (damageFirst > step.start) {
+        size_t elementStart;
+        first = index.find(damageFirst - 1 - step.start, elementStart);
+        runStart = step.start + elementStart;
+    } else if (rule == RULE_STATEMENT && step.parent->rule == RULE_PROGRAM) {
+        // The declarations ended at the damaged token, which must not
+        // continue them now
+        TokenType type = damageFirst < tokenCount ? document.token(damageFirst).type : ENDOFFILE;
+        if (type == INT || type == FLOAT) {
+            return NOT_LOCAL;
+        }
+    }
+
+    vector<ListIndex::Entry> entries;
+    size_t position = runStart;     // New numbering
+    size_t last = first;            // Old elements before last are passed
+    size_t boundary = runStart;     // Where old element last began
+    for (;;) {
+        if (position >= damageEnd) {
+            size_t oldPosition = static_cast<size_t>(static_cast<long long>(position) - damageDelta);
+            while (last < index.size() && boundary < oldPosition) {
+                boundary += index.at(last++).tokens;
+            }
+            if (boundary == oldPosition) {
+                break;
+            }
+            if (boundary < oldPosition) {
+                reached = max(reached, position);
+                return NOT_LOCAL;
+            }
+        }
+
+        // A declaration-list's first declaration is parsed whatever its
+        // first token; otherwise a token that cannot start an element ends
+        // the list, which did not end here before. Unless the token may
+        // follow the list ("}", or a statement after the declarations), a
+        // full parse fails at it too, expecting the enclosing "}". A "}"
+        // ends the program, which then needs its ".".
+        TokenType type = position < tokenCount ? document.token(position).type : ENDOFFILE;
+        bool required = rule == RULE_DECLARATION && first == 0 && entries.empty();
+        if (!required && !startsElement(list, type)) {
+            if (rule == RULE_DECLARATION && startsElement(step.node->nextSibling, type)) {
+                size_t listEnd = static_cast<size_t>(static_cast<long long>(step.start + list->tokenCount) +
+                                                     damageDelta);
+                return reparseStrayStatements(step.node->nextSibling, position, listEnd);
+            }
+            if (type != RBRACE) {
+                return reportMissing(RBRACE, position);
+            }
+            TokenType next = position + 1 < tokenCount ? document.token(position + 1).type : ENDOFFILE;
+            if (step.parent->rule != RULE_PROGRAM || next == DOT) {
+                return NOT_LOCAL;
+            }
+            return reportMissing(DOT, position + 1);
+        }
+
+        size_t end;
+        size_t reach = damageEnd > position ? damageEnd - position : 0;
+        ParseTreeNode* element = parseAt(rule, position, reach, end);
+        if (!element) {
+            // Reached as in a full parse, which fails the same way
+            errorMessage = parser->getErrorMessage();
+            return SYNTAX_ERROR;
+        }
+        entries.push_back(ListIndex::Entry{element, nullptr, end - position});
+        position = end;
+    }
+
+    for (const ListIndex::Entry& entry : entries) {
+        countTokens(entry.element);
+    }
+    relinkList(list, index, first, last, entries);
+    list->tokenCount = static_cast<uint32_t>(list->tokenCount + damageDelta);
+    return REPAIRED;
+}
+
+// The declarations now end at token position, inside the old ones, and
+// the statement-list starts there. A full parse fails in those statements
+// unless they run on past the old declarations (at limit), where the tree
+// changes shape.
+IncrementalParser::Repair IncrementalParser::reparseStrayStatements(const ParseTreeNode* statements, size_t position,
+                                                                    size_t limit) {
+    size_t tokenCount = document.tokenCount();
+    while (position < limit) {
+        TokenType type = position < tokenCount ? document.token(position).type : ENDOFFILE;
+        if (!startsElement(statements, type)) {
+            return type == RBRACE ? NOT_LOCAL : reportMissing(RBRACE, position);
+        }
+        size_t end;
+        if (!parseAt(RULE_STATEMENT, position, 0, end)) {
+            errorMessage = parser->getErrorMessage();
+            return SYNTAX_ERROR;
+        }
+        position = end;
+    }
+    return NOT_LOCAL;
+}
+
+// A full parse reaches token position expecting another token there, and
+// fails
+IncrementalParser::Repair IncrementalParser::reportMissing(TokenType expected, size_t position) {
+    size_t from = position < document.tokenCount() ? document.token(position).offset : document.size();
+    document.window(from, position, 1, windowText, window);
+    parser->matchFragment(expected, 0);
+    errorMessage = parser->getErrorMessage();
+    return SYNTAX_ERROR;
+}
+
+// Put entries in place of elements [first, last) of a list, building the
+// same nodes the parser would: with the ' chain, element i hangs from the
+// ' node (or, for the first declaration, the list) that also holds the
+// rest of the list, the last one holding epsilon; flattened, the elements
+// are the list's children, or epsilon alone.
+void IncrementalParser::relinkList(ParseTreeNode* list, ListIndex& index, size_t first, size_t last,
+                                   vector<ListIndex::Entry>& entries) {
+    size_t count = index.size();
+    if (entries.empty() && first == last) {
+        return;
+    }
+
+    if (index.tail == list) {
+        ParseTreeNode* previous = first > 0 ? index.at(first - 1).element : nullptr;
+        ParseTreeNode* next = last < count ? index.at(last).element : nullptr;
+        for (size_t i = 0; i < entries.size(); i++) {
+            entries[i].holder = list;
+            entries[i].element->nextSibling = i + 1 < entries.size() ? entries[i + 1].element : next;
+        }
+        if (count - (last - first) + entries.size() == 0) {
+            ParseTreeNode* epsilon = parser->newEmptyNode();
+            list->firstChild = epsilon;
+            list->lastChild = epsilon;
+        } else {
+            ParseTreeNode* head = entries.empty() ? next : entries[0].element;
+            if (previous) {
+                previous->nextSibling = head;
+            } else {
+                list->firstChild = head;
+            }
+            if (!next) {
+                list->lastChild = entries.empty() ? previous : entries.back().element;
+            }
+        }
+        index.replace(first, last, entries);
+        return;
+    }
+
+    RuleId prime = list->rule == RULE_DECLARATION_LIST ? RULE_DECLARATION_LIST_PRIME : RULE_STATEMENT_LIST_PRIME;
+    // A declaration-list holds its first element itself; when that goes,
+    // the next one is taken into the run to move up into its place
+    if (entries.empty() && first == 0 && index.at(0).holder == list && last < count) {
+        entries.push_back(index.at(last));
+        last++;
+    }
+    if (entries.empty()) {
+        // Hook the rest of the list where the first removed element's
+        // holder was: as the last child of the previous holder, or the only
+        // child of the list
+        ParseTreeNode* next = last < count ? index.at(last).holder : index.tail;
+        ParseTreeNode* parent = first > 0 ? index.at(first - 1).holder : list;
+        if (parent->firstChild == parent->lastChild) {
+            parent->firstChild = next;
+        } else {
+            parent->firstChild->nextSibling = next;
+        }
+        parent->lastChild = next;
+        index.replace(first, last, entries);
+        return;
+    }
+
+    // New elements go in before old element first: it is taken into the
+    // run, so that its holder can take the first new element
+    if (first == last && last < count) {
+        entries.push_back(index.at(last));
+        last++;
+    }
+
+    ParseTreeNode* holder = first < count ? index.at(first).holder : index.tail;
+    ParseTreeNode* next;
+    if (last < count) {
+        next = index.at(last).holder;
+    } else if (first < count) {
+        next = index.tail;
+    } else {
+        // Elements added to an empty list: its epsilon moves to a new tail
+        next = parser->newListNode(prime);
+        next->firstChild = index.tail->firstChild;
+        next->lastChild = index.tail->lastChild;
+        index.tail = next;
+    }
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        entries[i].holder = i == 0 ? holder : parser->newListNode(prime);
+    }
+    for (size_t i = 0; i < entries.size(); i++) {
+        ParseTreeNode* rest = i + 1 < entries.size() ? entries[i + 1].holder : next;
+        entries[i].element->nextSibling = rest;
+        entries[i].holder->firstChild = entries[i].element;
+        entries[i].holder->lastChild = rest;
+    }
+    index.replace(first, last, entries);
+}
+
+void IncrementalParser::position(size_t index, long long& line, long long& col) const {
+    size_t end = document.size();
+    if (index < document.tokenCount()) {
+        TokenRecord token = document.token(index);
+        end = token.offset + token.length;
+    }
+    document.position(end, line, col);
+}
+
+string_view IncrementalParser::text() const {
+    if (!flatTextValid) {
+        flatText.clear();
+        document.copyText(0, document.size(), flatText);
+        flatTextValid = true;
+    }
+    return flatText;
+}
+
+const TokenBuffer& IncrementalParser::tokenStream() const {
+    if (!flatTokensValid) {
+        document.window(0, 0, document.tokenCount(), flatText, flatTokens);
+        flatTextValid = true;
+        flatTokensValid = true;
+    }
+    return flatTokens;
+}
@@ -0,0 +1,276 @@
+#ifndef INCREMENTALPARSER_H
+#define INCREMENTALPARSER_H
+
+#include "Parser.h"
+#include "TokenBuffer.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/* One text change: length bytes at offset are replaced by text */
+struct TextEdit {
+    size_t offset;
+    size_t length;
+    std::string text;
+};
+
+/* What the last call to IncrementalParser::applyEdits did */
+struct IncrementalStats {
+    size_t relexedBytes;        // Source bytes scanned again
+    size_t relexedTokens;       // Tokens produced by those scans
+    size_t reparsedTokens;      // Tokens under the reparsed subtrees
+    size_t fullReparses;        // Edits that needed a full parse
+};
+
+/* Prefix sums over counts that change in place (a Fenwick tree) */
+class CountTree {
+public:
+    void assign(const std::vector<size_t>& counts);
+    void add(size_t index, long long delta);
+
+    size_t size() const { return tree.size() - 1; }
+
+    // Sum of counts [0, n)
+    size_t prefix(size_t n) const;
+
+    // Index of the count containing position target, with the sum of the
+    // counts before it; size() if target is past the total
+    size_t find(size_t target, size_t& before) const;
+
+private:
+    std::vector<size_t> tree = std::vector<size_t>(1);     // One-based
+};
+
+/*
+ * The text and token stream of a document, cut into chunks of a few KB at
+ * token starts. A chunk holds its text and its tokens with offsets from its
+ * first byte, and prefix sums over the chunks' bytes, tokens and newlines
+ * locate any token, byte or line. An edit rewrites the chunks it touches;
+ * nothing after them moves.
+ */
+class ChunkedDocument {
+public:
+    ChunkedDocument() { clear(); }
+
+    void clear();
+
+    // Take the whole text and its tokens (lexed from text)
+    void assign(const char* text, size_t size, const TokenBuffer& tokens);
+
+    size_t size() const { return totalBytes; }
+    size_t tokenCount() const { return totalTokens; }   // Without ENDOFFILE
+
+    // A token with its offset in the document
+    TokenRecord token(size_t index) const;
+
+    // Append tokens [first, first + count) to out (fewer at the end)
+    void readTokens(size_t first, size_t count, std::vector<TokenRecord>& out) const;
+
+    // Index of the first token ending at or after offset, tokenCount() if
+    // none does
+    size_t tokenReaching(size_t offset) const;
+
+    // Append bytes [from, to) to out
+    void copyText(size_t from, size_t to, std::string& out) const;
+
+    // Line and column of a byte, counted as the scanner does
+    void position(size_t offset, long long& line, long long& col) const;
+
+    // Apply edit to the text, and replace tokens [first, last) with fresh
+    // (given at their offsets in the edited text); tokens from last on
+    // move with the text
+    void replace(const TextEdit& edit, size_t first, size_t last, const std::vector<TokenRecord>& fresh);
+
+    // Fill buffer with tokens [first, first + count) (fewer at the end) and
+    // text with the bytes from offset from to the end of those tokens, or
+    // of the document when the window reaches it. Positions in the buffer
+    // are the tokens' positions in the document. Returns the tokens taken.
+    size_t window(size_t from, size_t first, size_t count, std::string& text, TokenBuffer& buffer) const;
+
+private:
+    static const size_t CHUNK_BYTES = 4096;
+
+    struct Chunk {
+        std::string text;
+        std::vector<TokenRecord> tokens;    // Offsets from the chunk's first byte
+        size_t newlines;
+    };
+
+    std::vector<Chunk> chunks;
+    CountTree chunkBytes;
+    CountTree chunkTokens;
+    CountTree chunkNewlines;
+    size_t totalBytes;
+    size_t totalTokens;
+
+    size_t chunkOfByte(size_t offset, size_t& start) const;
+    size_t chunkOfToken(size_t index, size_t& first) const;
+    template <typename Visit>
+    void forEachToken(size_t first, size_t count, Visit visit) const;
+    void cut(const char* text, size_t size, const std::vector<TokenRecord>& tokens, std::vector<Chunk>& out) const;
+    void reindex();
+};
+
+/*
+ * The elements of one statement-list or declaration-list in blocks, with
+ * prefix sums of the blocks' sizes and token counts, so the element holding
+ * a token is found, and a run of elements replaced, without walking the
+ * list's chain of ' nodes.
+ */
+class ListIndex {
+public:
+    struct Entry {
+        ParseTreeNode* element;
+        ParseTreeNode* holder;      // Its parent: a ' node, or the list itself
+        size_t tokens;
+    };
+
+    // The ' node holding the list's epsilon, or the list itself when
+    // flattened
+    ParseTreeNode* tail = nullptr;
+
+    void assign(const std::vector<Entry>& entries, ParseTreeNode* listTail);
+
+    size_t size() const { return count; }
+    const Entry& at(size_t index) const;
+
+    // Element containing token (counted from the list's first), with its
+    // start; size() if token is past the list
+    size_t find(size_t token, size_t& elementStart) const;
+
+    void setTokens(size_t index, size_t tokens);
+
+    // Replace elements [first, last) with entries
+    void replace(size_t first, size_t last, const std::vector<Entry>& entries);
+
+private:
+    static const size_t BLOCK = 64;
+
+    std::vector<std::vector<Entry>> blocks;
+    CountTree blockSizes;
+    CountTree blockTokens;
+    size_t count = 0;
+
+    size_t locate(size_t index, size_t& offset) const;
+    static size_t blockSum(const std::vector<Entry>& block);
+    void reindex(const std::vector<size_t>& tokens);
+};
+
+/*
+ * A parsed document that follows edits, for editor integration.
+ *
+ * The document keeps its text and token stream in chunks, and its tree.
+ * For each edit it relexes only from the token before the change until the
+ * new token stream lines up with the old one again, then reparses the
+ * smallest part of the tree containing the changed tokens: an expression,
+ * statement or compound-stmt, or a run of elements of a statement-list or
+ * declaration-list, which may have gained or lost elements. A part is
+ * accepted only if it ends exactly where the old one did, which makes the
+ * result identical to a full reparse; otherwise the next enclosing part is
+ * tried, and a full parse is the last resort. It is also taken once the
+ * parts tried have cost half of one, as after an edit that unbalances the
+ * braces.
+ *
+ * Nonterminals carry the number of tokens they span (tokenCount), and lists
+ * are indexed by ListIndex, so the part containing an edit is found in
+ * logarithmic time without positions in the nodes. While the text has a
+ * syntax error the last good tree is kept together with the range of
+ * tokens changed since, so the edit that fixes the error is reparsed
+ * locally too. The error itself is reported from the local parse when a
+ * full parse provably fails at the same token: tokens before the part are
+ * unchanged, so a full parse reaches it the same way.
+ */
+class IncrementalParser {
+public:
+    explicit IncrementalParser(const ParserOptions& opts = ParserOptions());
+
+    IncrementalParser(const IncrementalParser&) = delete;
+    IncrementalParser& operator=(const IncrementalParser&) = delete;
+
+    // Replace the whole text and parse it from scratch. Returns the tree,
+    // or nullptr on a syntax error.
+    ParseTreeNode* parse(std::string_view text);
+
+    // Apply edits in order, each in the coordinates of the text left by
+    // the previous one, and bring the tree up to date. Returns false (and
+    // changes nothing) if an edit lies outside the text.
+    bool applyEdits(const std::vector<TextEdit>& edits);
+
+    // Current tree, nullptr while the text has a syntax error. Owned by
+    // this object; valid until the next parse() or applyEdits().
+    ParseTreeNode* tree() const { return broken ? nullptr : root; }
+
+    bool hadError() const { return broken; }
+    std::string getErrorMessage() const { return errorMessage; }
+    const StringInterner& getSymbols() const { return parser->getSymbols(); }
+
+    size_t size() const { return document.size(); }
+
+    // Line and column just past the end of a token, as
+    // TokenBuffer::position() reports them
+    void position(size_t index, long long& line, long long& col) const;
+
+    // The whole text and token stream, assembled on the first call after
+    // an edit (which takes time proportional to the document) and valid
+    // until the next parse() or applyEdits()
+    std::string_view text() const;
+    const TokenBuffer& tokenStream() const;
+
+    const IncrementalStats& lastStats() const { return stats; }
+
+private:
+    // Outcome of reparsing the damaged tokens locally
+    enum Repair { REPAIRED, SYNTAX_ERROR, NOT_LOCAL };
+
+    // A node on the way from the root to the damaged tokens
+    struct Step {
+        ParseTreeNode* node;
+        ParseTreeNode* parent;
+        size_t start;               // First token, numbered as under root
+        ParseTreeNode* list;        // List holding node as an element, if any
+        size_t element;             // Its index there
+    };
+
+    ParserOptions options;
+    ChunkedDocument document;
+    std::string windowText;         // Text of the tokens in window
+    TokenBuffer window;             // What the parser reads: a stretch of tokens, or all of them
+    std::unique_ptr<Parser> parser; // Owns every node of the tree
+    ParseTreeNode* root;            // Tree of the text, or of the last text without errors
+    bool broken;                    // The text has a syntax error
+
+    // While broken: tokens [damageFirst, damageEnd) replace the tokens
+    // [damageFirst, damageEnd - damageDelta) under root
+    size_t damageFirst;
+    size_t damageEnd;
+    long long damageDelta;
+
+    // Index of every list of the tree that is long or was edited
+    std::unordered_map<const ParseTreeNode*, ListIndex> lists;
+
+    std::string errorMessage;
+    size_t bytesAfterFullParse;     // Parser memory right after the last full parse
+    IncrementalStats stats;
+
+    mutable std::string flatText;
+    mutable TokenBuffer flatTokens;
+    mutable bool flatTextValid;
+    mutable bool flatTokensValid;
+
+    void fullReparse();
+    void applyEdit(const TextEdit& edit);
+    void countTokens(ParseTreeNode* subtree);
+    ListIndex& listIndex(ParseTreeNode* list);
+    ParseTreeNode* parseAt(RuleId rule, size_t first, size_t reach, size_t& end);
+    Repair reparseDamage();
+    Repair reparseSubtree(const Step& step, size_t& reached);
+    Repair reparseRun(const Step& step, size_t& reached);
+    Repair reparseStrayStatements(const ParseTreeNode* statements, size_t position, size_t limit);
+    Repair reportMissing(TokenType expected, size_t position);
+    void relinkList(ParseTreeNode* list, ListIndex& index, size_t first, size_t last,
+                    std::vector<ListIndex::Entry>& entries);
+};
+
+#endif /* INCREMENTALPARSER_H */
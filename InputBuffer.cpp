@@ -0,0 +1,161 @@
+#include "InputBuffer.h"
+#include "Stats.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool InputBuffer::mapFile(const std::string& path) {
+    clear();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t reserved = (size + 2 + page - 1) / page * page;
+
+    // Reserve zero-filled memory for the text plus padding, then map the
+    // file over its start. Bytes past the end of the file read as zero,
+    // which provides the two NUL bytes even when the size is page-aligned.
+    void* region = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    if (size > 0) {
+        void* mapped = mmap(region, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            munmap(region, reserved);
+            close(fd);
+            return false;
+        }
+        madvise(region, size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    base = static_cast<char*>(region);
+    length = size;
+    reservedLength = reserved;
+    kind = MAPPED;
+    return true;
+}
+
+void InputBuffer::wrap(char* data, size_t size) {
+    clear();
+    base = data;
+    length = size;
+    kind = BORROWED;
+}
+
+// An empty copy may come with a null data pointer, which memcpy and memmove
+// must not be given even for zero bytes
+void InputBuffer::copy(const char* data, size_t size) {
+    if (kind == OWNED && reservedLength >= size + 2) {
+        if (size > 0) {
+            memmove(base, data, size);
+        }
+        base[size] = '\0';
+        base[size + 1] = '\0';
+        length = size;
+        return;
+    }
+    clear();
+    char* buffer = static_cast<char*>(malloc(size + 2));
+    if (!buffer) {
+        throw std::bad_alloc();
+    }
+    STATS_ALLOCATION(size + 2);
+    if (size > 0) {
+        memcpy(buffer, data, size);
+    }
+    buffer[size] = '\0';
+    buffer[size + 1] = '\0';
+    base = buffer;
+    length = size;
+    reservedLength = size + 2;
+    kind = OWNED;
+}
+
+bool InputBuffer::readStream(FILE* stream) {
+    clear();
+    size_t capacity = 64 * 1024;
+    size_t size = 0;
+    char* buffer = static_cast<char*>(malloc(capacity));
+    if (!buffer) {
+        throw std::bad_alloc();
+    }
+    STATS_ALLOCATION(capacity);
+
+    for (;;) {
+        if (capacity - size <= 2) {
+            capacity *= 2;
+            char* grown = static_cast<char*>(realloc(buffer, capacity));
+            if (!grown) {
+                free(buffer);
+                throw std::bad_alloc();
+            }
+            buffer = grown;
+            STATS_ALLOCATION(capacity);
+        }
+        // Always leave room for the two NUL bytes
+        size_t n = fread(buffer + size, 1, capacity - size - 2, stream);
+        size += n;
+        if (n == 0) {
+            break;
+        }
+    }
+
+    if (ferror(stream)) {
+        free(buffer);
+        return false;
+    }
+
+    buffer[size] = '\0';
+    buffer[size + 1] = '\0';
+    base = buffer;
+    length = size;
+    reservedLength = capacity;
+    kind = OWNED;
+    return true;
+}
+
+void InputBuffer::clear() {
+    if (kind == MAPPED) {
+        munmap(base, reservedLength);
+    } else if (kind == OWNED) {
+        free(base);
+    }
+    base = nullptr;
+    length = 0;
+    reservedLength = 0;
+    kind = EMPTY;
+}
+
+bool SourceFile::open(const std::string& path, bool allowMmap) {
+    close();
+    if (allowMmap && mapped.mapFile(path)) {
+        return true;
+    }
+    stream = fopen(path.c_str(), "r");
+    return stream != nullptr;
+}
+
+void SourceFile::close() {
+    mapped.clear();
+    if (stream) {
+        fclose(stream);
+        stream = nullptr;
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef INPUTBUFFER_H
+#define INPUTBUFFER_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+/*
+ * Source text held in memory so the lexer can scan it in place.
+ *
+ * The text is always followed by two NUL bytes and is writable, as flex's
+ * yy_scan_buffer requires (flex temporarily NUL-terminates each match and
+ * restores the byte afterwards). A mapped file uses a private copy-on-write
+ * mapping, so the file on disk is never modified.
+ */
+class InputBuffer {
+public:
+    InputBuffer() : base(nullptr), length(0), reservedLength(0), kind(EMPTY) {}
+    ~InputBuffer() { clear(); }
+
+    InputBuffer(const InputBuffer&) = delete;
+    InputBuffer& operator=(const InputBuffer&) = delete;
+
+    // Memory-map a regular file. Returns false (leaving the buffer empty)
+    // when the file cannot be opened or is not a regular file.
+    bool mapFile(const std::string& path);
+
+    // Scan a caller-owned buffer in place. data[size] and data[size + 1]
+    // must be NUL, and the buffer must outlive every Lexer reading it.
+    void wrap(char* data, size_t size);
+
+    // Copy data into a padded buffer owned by this object, reusing the one
+    // it already owns when that is large enough
+    void copy(const char* data, size_t size);
+
+    // Read a whole stream into a padded buffer owned by this object
+    bool readStream(FILE* stream);
+
+    void clear();
+
+    char* data() const { return base; }
+    size_t size() const { return length; }
+
+private:
+    enum Kind { EMPTY, MAPPED, OWNED, BORROWED };
+
+    char* base;
+    size_t length;
+    size_t reservedLength;  // Bytes mapped or allocated, padding included
+    Kind kind;
+};
+
+/*
+ * An input file opened for parsing: memory-mapped when possible, otherwise
+ * (pipes, devices, or mapping disabled) read as a FILE stream.
+ */
+class SourceFile {
+public:
+    SourceFile() : stream(nullptr) {}
+    ~SourceFile() { close(); }
+
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    bool open(const std::string& path, bool allowMmap);
+    void close();
+
+    bool isMapped() const { return mapped.data() != nullptr; }
+    const InputBuffer& buffer() const { return mapped; }
+    FILE* file() const { return stream; }
+
+private:
+    InputBuffer mapped;
+    FILE* stream;
+};
+
+#endif /* INPUTBUFFER_H */
@@ -0,0 +1,251 @@
+#include "Interpreter.h"
+#include <sstream>
+
+using namespace std;
+
+#if defined(__GNUC__) && !defined(CMINUS_SWITCH_DISPATCH)
+#define CMINUS_THREADED_DISPATCH
+#endif
+
+bool Interpreter::threaded() {
+#ifdef CMINUS_THREADED_DISPATCH
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Wrapping int arithmetic
+static inline int64_t wrapAdd(int64_t a, int64_t b) {
+    return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+}
+
+static inline int64_t wrapSub(int64_t a, int64_t b) {
+    return static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));
+}
+
+static inline int64_t wrapMul(int64_t a, int64_t b) {
+    return static_cast<int64_t>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b));
+}
+
+bool Interpreter::run(const BytecodeProgram& program, const TokenBuffer* tokens, uint64_t limit) {
+    frame.assign(program.registerCount, Value{0});
+    copy(program.constants.begin(), program.constants.end(), frame.begin() + program.constantBase);
+    memory.assign(program.arrayElements, Value{0});
+    error.clear();
+
+    Value* r = frame.data();
+    Value* m = memory.data();
+    const ArrayInfo* arrays = program.arrays.data();
+    const Instruction* code = program.code.data();
+    const Instruction* ip = code;
+    uint64_t count = 0;
+    uint64_t budget = limit > 0 ? limit : UINT64_MAX;
+    const char* fault = nullptr;
+    int64_t badIndex = 0;
+    uint32_t badSize = 0;
+
+#ifdef CMINUS_THREADED_DISPATCH
+    // In Opcode order
+    static const void* const handlers[] = {
+        &&L_OP_MOV,  &&L_OP_I2F,  &&L_OP_F2I,  &&L_OP_ADDI, &&L_OP_SUBI, &&L_OP_MULI, &&L_OP_DIVI,
+        &&L_OP_ADDF, &&L_OP_SUBF, &&L_OP_MULF, &&L_OP_DIVF, &&L_OP_LTI,  &&L_OP_LEI,  &&L_OP_GTI,
+        &&L_OP_GEI,  &&L_OP_EQI,  &&L_OP_NEI,  &&L_OP_LTF,  &&L_OP_LEF,  &&L_OP_GTF,  &&L_OP_GEF,
+        &&L_OP_EQF,  &&L_OP_NEF,  &&L_OP_LOAD, &&L_OP_STORE, &&L_OP_JMP, &&L_OP_JZ,   &&L_OP_JNZ,
+        &&L_OP_JLTI, &&L_OP_JLEI, &&L_OP_JGTI, &&L_OP_JGEI, &&L_OP_JEQI, &&L_OP_JNEI, &&L_OP_JLTF,
+        &&L_OP_JLEF, &&L_OP_JGTF, &&L_OP_JGEF, &&L_OP_JEQF, &&L_OP_JNEF, &&L_OP_HALT};
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == OP_COUNT, "one handler per opcode");
+#define CASE(op) L_##op:
+#define DISPATCH()                  \
+    do {                            \
+        count++;                    \
+        goto* handlers[ip->op];     \
+    } while (0)
+#else
+#define CASE(op) case op:
+#define DISPATCH()                  \
+    do {                            \
+        count++;                    \
+        goto dispatch;              \
+    } while (0)
+#endif
+#define NEXT()                      \
+    do {                            \
+        ip++;                       \
+        DISPATCH();                 \
+    } while (0)
+// The limit is checked before jumping, so an overrun is reported at the
+// branch rather than its target
+#define JUMP(target)                \
+    do {                            \
+        if (count >= budget) {      \
+            goto overrun;           \
+        }                           \
+        ip = code + (target);       \
+        DISPATCH();                 \
+    } while (0)
+#define BINARY(op, field, expr)                                 \
+    CASE(op) {                                                  \
+        const Value& x = r[ip->b];                              \
+        const Value& y = r[ip->c];                              \
+        r[ip->a].field = (expr);                                \
+        NEXT();                                                 \
+    }
+#define BRANCH(op, expr)                                        \
+    CASE(op) {                                                  \
+        const Value& x = r[ip->a];                              \
+        const Value& y = r[ip->b];                              \
+        if (expr) {                                             \
+            JUMP(ip->c);                                        \
+        }                                                       \
+        NEXT();                                                 \
+    }
+
+#ifdef CMINUS_THREADED_DISPATCH
+    DISPATCH();
+#else
+    count++;
+dispatch:
+    switch (ip->op) {
+#endif
+    CASE(OP_MOV) {
+        r[ip->a] = r[ip->b];
+        NEXT();
+    }
+    CASE(OP_I2F) {
+        r[ip->a].f = static_cast<double>(r[ip->b].i);
+        NEXT();
+    }
+    CASE(OP_F2I) {
+        double f = r[ip->b].f;
+        if (!(f >= -9223372036854775808.0 && f < 9223372036854775808.0)) {
+            fault = "float value out of int range";
+            goto failed;
+        }
+        r[ip->a].i = static_cast<int64_t>(f);
+        NEXT();
+    }
+    BINARY(OP_ADDI, i, wrapAdd(x.i, y.i))
+    BINARY(OP_SUBI, i, wrapSub(x.i, y.i))
+    BINARY(OP_MULI, i, wrapMul(x.i, y.i))
+    CASE(OP_DIVI) {
+        int64_t x = r[ip->b].i;
+        int64_t y = r[ip->c].i;
+        if (y == 0) {
+            fault = "division by zero";
+            goto failed;
+        }
+        // INT64_MIN / -1 wraps like the other operations
+        r[ip->a].i = y == -1 ? wrapSub(0, x) : x / y;
+        NEXT();
+    }
+    BINARY(OP_ADDF, f, x.f + y.f)
+    BINARY(OP_SUBF, f, x.f - y.f)
+    BINARY(OP_MULF, f, x.f * y.f)
+    BINARY(OP_DIVF, f, x.f / y.f)
+    BINARY(OP_LTI, i, x.i < y.i)
+    BINARY(OP_LEI, i, x.i <= y.i)
+    BINARY(OP_GTI, i, x.i > y.i)
+    BINARY(OP_GEI, i, x.i >= y.i)
+    BINARY(OP_EQI, i, x.i == y.i)
+    BINARY(OP_NEI, i, x.i != y.i)
+    BINARY(OP_LTF, i, x.f < y.f)
+    BINARY(OP_LEF, i, x.f <= y.f)
+    BINARY(OP_GTF, i, x.f > y.f)
+    BINARY(OP_GEF, i, x.f >= y.f)
+    BINARY(OP_EQF, i, x.f == y.f)
+    BINARY(OP_NEF, i, x.f != y.f)
+    CASE(OP_LOAD) {
+        const ArrayInfo& array = arrays[ip->b];
+        int64_t index = r[ip->c].i;
+        if (static_cast<uint64_t>(index) >= array.size) {
+            badIndex = index;
+            badSize = array.size;
+            goto failed;
+        }
+        r[ip->a] = m[array.base + index];
+        NEXT();
+    }
+    CASE(OP_STORE) {
+        const ArrayInfo& array = arrays[ip->a];
+        int64_t index = r[ip->b].i;
+        if (static_cast<uint64_t>(index) >= array.size) {
+            badIndex = index;
+            badSize = array.size;
+            goto failed;
+        }
+        m[array.base + index] = r[ip->c];
+        NEXT();
+    }
+    CASE(OP_JMP) {
+        JUMP(ip->a);
+    }
+    CASE(OP_JZ) {
+        if (r[ip->a].i == 0) {
+            JUMP(ip->b);
+        }
+        NEXT();
+    }
+    CASE(OP_JNZ) {
+        if (r[ip->a].i != 0) {
+            JUMP(ip->b);
+        }
+        NEXT();
+    }
+    BRANCH(OP_JLTI, x.i < y.i)
+    BRANCH(OP_JLEI, x.i <= y.i)
+    BRANCH(OP_JGTI, x.i > y.i)
+    BRANCH(OP_JGEI, x.i >= y.i)
+    BRANCH(OP_JEQI, x.i == y.i)
+    BRANCH(OP_JNEI, x.i != y.i)
+    BRANCH(OP_JLTF, x.f < y.f)
+    BRANCH(OP_JLEF, x.f <= y.f)
+    BRANCH(OP_JGTF, x.f > y.f)
+    BRANCH(OP_JGEF, x.f >= y.f)
+    BRANCH(OP_JEQF, x.f == y.f)
+    BRANCH(OP_JNEF, x.f != y.f)
+    CASE(OP_HALT) {
+        executed = count;
+        return true;
+    }
+#ifndef CMINUS_THREADED_DISPATCH
+    default:
+        break;
+    }
+#endif
+
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef BINARY
+#undef BRANCH
+
+    {
+        executed = count;
+        return true;
+    }
+
+overrun:
+    fault = "instruction limit reached";
+failed:
+    executed = count;
+    {
+        ostringstream oss;
+        oss << "RUNTIME ERROR";
+        uint32_t token = program.tokens[ip - code];
+        if (tokens && token < tokens->size()) {
+            long long line, col;
+            tokens->position(token, line, col);
+            oss << " at Line " << line << ", Col " << col;
+        }
+        oss << ": ";
+        if (fault) {
+            oss << fault;
+        } else {
+            oss << "index " << badIndex << " is out of bounds for an array of size " << badSize;
+        }
+        error = oss.str();
+    }
+    return false;
+}
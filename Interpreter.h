@@ -0,0 +1,52 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include "Bytecode.h"
+#include "TokenBuffer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Runs a BytecodeProgram.
+ *
+ * The frame and the array block are two flat arrays of 8-byte values. With
+ * GCC or Clang the loop is threaded: each handler ends in its own indirect
+ * jump through a table of label addresses (computed goto), so the branch
+ * predictor sees one dispatch site per opcode instead of a single shared
+ * switch. Elsewhere, or built with -DCMINUS_SWITCH_DISPATCH, it is a plain
+ * switch. Either way the only per-instruction bookkeeping is a counter
+ * increment; the instruction limit is checked at taken jumps.
+ */
+class Interpreter {
+public:
+    Interpreter() : executed(0) {}
+
+    // Run program from the start, every variable and array element 0.
+    // False on a runtime error, or when more than limit (if not 0)
+    // instructions would run; see getError(). tokens, the buffer the
+    // program was compiled from, gives the error position.
+    bool run(const BytecodeProgram& program, const TokenBuffer* tokens = nullptr, uint64_t limit = 0);
+
+    // Instructions executed by the last run
+    uint64_t instructions() const { return executed; }
+
+    // "RUNTIME ERROR at Line <line>, Col <col>: ...", or empty
+    const std::string& getError() const { return error; }
+
+    // Final values: variable.slot of a scalar indexes the frame; an array
+    // occupies elements [base, base + size) of the array block
+    const std::vector<Value>& getFrame() const { return frame; }
+    const std::vector<Value>& getArrays() const { return memory; }
+
+    // Whether this build dispatches with computed goto
+    static bool threaded();
+
+private:
+    std::vector<Value> frame;
+    std::vector<Value> memory;
+    uint64_t executed;
+    std::string error;
+};
+
+#endif /* INTERPRETER_H */
@@ -0,0 +1,129 @@
+#include "Lexer.h"
+#include <climits>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+using namespace std;
+
+// flex keeps buffer sizes in an int, so larger inputs are streamed
+static const size_t MAX_IN_PLACE_SIZE = INT_MAX - 2;
+
+/* Reset position tracking and error state */
+extern "C" void lexer_state_init(LexerState* state) {
+    state->token_text = "";
+    state->token_length = 0;
+    state->token_offset = 0;
+    state->offset = 0;
+    state->line_num = 1;
+    state->col_num = 1;
+    state->comment_start_line = 0;
+    state->comment_start_col = 0;
+    state->print_errors = 1;
+    state->error_message[0] = '\0';
+}
+
+bool parseLexerBackend(const char* name, LexerBackend& backend) {
+#ifndef CMINUS_NO_FLEX
+    if (strcmp(name, "flex") == 0) {
+        backend = LexerBackend::Flex;
+        return true;
+    }
+#endif
+    if (strcmp(name, "hand") == 0) {
+        backend = LexerBackend::Hand;
+        return true;
+    }
+    return false;
+}
+
+const char* lexerBackendName(LexerBackend backend) {
+    return backend == LexerBackend::Hand ? "hand" : "flex";
+}
+
+void Lexer::init() {
+    lexer_state_init(&state);
+#ifndef CMINUS_NO_FLEX
+    if (yylex_init_extra(&state, &scanner) != 0) {
+        throw std::bad_alloc();
+    }
+#endif
+}
+
+void Lexer::initHand(const InputBuffer& input) {
+    lexer_state_init(&state);
+    hand.reset(new HandLexer(input.data(), input.size(), state));
+}
+
+Lexer::Lexer(FILE* input, LexerBackend backend) : scanner(nullptr), ownedStream(nullptr) {
+    if (backend == LexerBackend::Hand) {
+        if (!ownedInput.readStream(input)) {
+            throw std::runtime_error("error reading input");
+        }
+        initHand(ownedInput);
+        return;
+    }
+    init();
+#ifndef CMINUS_NO_FLEX
+    yyset_in(input, scanner);
+#endif
+}
+
+Lexer::Lexer(const InputBuffer& input, LexerBackend backend) : scanner(nullptr), ownedStream(nullptr) {
+    if (backend == LexerBackend::Hand) {
+        initHand(input);
+        return;
+    }
+    initBuffer(input);
+}
+
+void Lexer::initBuffer(const InputBuffer& input) {
+    init();
+#ifndef CMINUS_NO_FLEX
+    if (input.size() <= MAX_IN_PLACE_SIZE) {
+        // The buffer already ends in the two NUL bytes flex expects
+        yy_scan_buffer(input.data(), input.size() + 2, scanner);
+    } else {
+        // Too large for one flex buffer: read it through a memory stream.
+        // Offsets and positions are 64-bit, so they stay correct.
+        ownedStream = fmemopen(input.data(), input.size(), "r");
+        if (!ownedStream) {
+            yylex_destroy(scanner);
+            throw std::bad_alloc();
+        }
+        yyset_in(ownedStream, scanner);
+    }
+#else
+    (void)input;
+#endif
+}
+
+void Lexer::reset(const InputBuffer& input) {
+    int printErrors = state.print_errors;
+    if (hand) {
+        lexer_state_init(&state);
+        hand->reset(input.data(), input.size());
+    } else {
+#ifndef CMINUS_NO_FLEX
+        yylex_destroy(scanner);
+        scanner = nullptr;
+#endif
+        if (ownedStream) {
+            fclose(ownedStream);
+            ownedStream = nullptr;
+        }
+        initBuffer(input);
+    }
+    state.print_errors = printErrors;
+}
+
+Lexer::~Lexer() {
+#ifndef CMINUS_NO_FLEX
+    if (scanner) {
+        yylex_destroy(scanner);
+    }
+#endif
+    if (ownedStream) {
+        fclose(ownedStream);
+    }
+}
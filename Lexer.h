@@ -0,0 +1,91 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include "token.h"
+#include "InputBuffer.h"
+#include "HandLexer.h"
+#include <cstdio>
+#include <memory>
+#include <string_view>
+
+/* Scanner implementation behind a Lexer */
+enum class LexerBackend {
+    Flex,   // Generated from lexer_parser.l
+    Hand,   // HandLexer
+};
+
+// Backend used when none is requested: flex, unless the build has no flex
+// scanner (make LEXER=hand)
+#ifdef CMINUS_NO_FLEX
+const LexerBackend DEFAULT_LEXER_BACKEND = LexerBackend::Hand;
+#else
+const LexerBackend DEFAULT_LEXER_BACKEND = LexerBackend::Flex;
+#endif
+
+// Parse "flex" or "hand"; returns false for an unknown or unavailable backend
+bool parseLexerBackend(const char* name, LexerBackend& backend);
+const char* lexerBackendName(LexerBackend backend);
+
+/*
+ * One reentrant scanner together with its position state.
+ * Independent Lexer objects can be used concurrently from different threads.
+ *
+ * A Lexer reads either a FILE stream or an InputBuffer, which is scanned in
+ * place so lexemes are views into it. The flex backend reads streams through
+ * its own buffer; the hand-written backend reads them into memory first.
+ * Both report the same tokens, positions and errors.
+ */
+class Lexer {
+private:
+    LexerState state;
+    yyscan_t scanner;
+    FILE* ownedStream;      // Stream opened by the lexer itself, if any
+    InputBuffer ownedInput; // Stream contents read for the hand backend
+    std::unique_ptr<HandLexer> hand;
+
+    void init();
+    void initHand(const InputBuffer& input);
+    void initBuffer(const InputBuffer& input);
+
+public:
+    explicit Lexer(FILE* input, LexerBackend backend = DEFAULT_LEXER_BACKEND);
+    explicit Lexer(const InputBuffer& input, LexerBackend backend = DEFAULT_LEXER_BACKEND);
+    ~Lexer();
+
+    Lexer(const Lexer&) = delete;
+    Lexer& operator=(const Lexer&) = delete;
+
+    // Scan another in-memory input from its start. The hand-written backend
+    // keeps its objects; the flex backend starts a fresh scanner.
+    void reset(const InputBuffer& input);
+
+    LexerBackend backend() const { return hand ? LexerBackend::Hand : LexerBackend::Flex; }
+
+    // Scan the next token; returns 0 at end of input
+    int next() {
+#ifndef CMINUS_NO_FLEX
+        if (!hand) {
+            return yylex(scanner);
+        }
+#endif
+        return hand->next();
+    }
+
+    // Text of the last token. For stream input the view is only valid until
+    // the next call to next(); for an InputBuffer it lives as long as the buffer.
+    std::string_view lexeme() const { return std::string_view(state.token_text, state.token_length); }
+
+    // Byte offset of the last token in the input
+    size_t offset() const { return state.token_offset; }
+
+    long long line() const { return state.line_num; }
+    long long col() const { return state.col_num; }
+
+    // Last lexical error, empty if none occurred
+    const char* errorMessage() const { return state.error_message; }
+
+    // Whether lexical errors are also echoed to stderr (default: yes)
+    void setPrintErrors(bool print) { state.print_errors = print ? 1 : 0; }
+};
+
+#endif /* LEXER_H */
@@ -0,0 +1,193 @@
+// Parallel parsing of one large program: the Parser members that split the
+// top-level statement-list into chunks at statement boundaries, parse the
+// chunks concurrently with one chunk parser each and stitch the results
+// back under the statement-list node. The tree, including the interned
+// symbol IDs, is the one the sequential parser builds; if any chunk does
+// not parse, or does not end exactly where the next one starts, the list
+// is parsed again sequentially, so errors are reported as before.
+
+#include "Parser.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Below this many tokens per chunk the threads cost more than they save
+static const size_t MIN_CHUNK_TOKENS = 16384;
+
+// Chunks per thread, so the work-stealing pool can even out chunks that
+// take longer than others
+static const size_t CHUNKS_PER_THREAD = 4;
+
+// Tokens that end a statement for certain: an expression can end in ID,
+// NUM or "]", and a compound-stmt in "}". ")" is left out, since it also
+// closes the condition of an if or while whose body follows.
+static bool endsStatement(TokenType type) {
+    return type == ID || type == NUM || type == RBRACKET || type == RBRACE;
+}
+
+// Find split points in the statement-list starting at token first: tokens
+// outside any brackets or braces of the list that start a statement right
+// after a token that ends one, at least chunkTokens apart. Such a token can
+// only start a top-level statement; a wrong guess on invalid input is
+// caught when the chunks are checked.
+static void findSplits(const TokenBuffer& tokens, size_t first, size_t chunkTokens, vector<size_t>& splits) {
+    long braces = 0;
+    long parens = 0;
+    long brackets = 0;
+    size_t last = first;
+    TokenType previous = ERROR;
+    for (size_t i = first; i < tokens.size(); i++) {
+        TokenType type = tokens.type(i);
+        if (braces == 0 && parens == 0 && brackets == 0 && inTokenSet(STATEMENT_FIRST, type) &&
+            endsStatement(previous) && i - last >= chunkTokens) {
+            splits.push_back(i);
+            last = i;
+        }
+        switch (type) {
+            case LBRACE:   braces++; break;
+            case RBRACE:   braces--; break;
+            case LPAREN:   parens++; break;
+            case RPAREN:   parens--; break;
+            case LBRACKET: brackets++; break;
+            case RBRACKET: brackets--; break;
+            default:       break;
+        }
+        // The "}" closing the program ends the list
+        if (braces < 0 || type == ENDOFFILE) {
+            break;
+        }
+        previous = type;
+    }
+}
+
+// Parse the statements in tokens [first, last) (up to the end of the list
+// when last is SIZE_MAX) as a piece of statement-list': a chain of ' nodes
+// holding one statement each, or with flattened lists the statements
+// themselves linked as siblings. head and tail receive the first and last
+// element and end the index of the first token not consumed.
+bool Parser::parseStatementRun(size_t first, size_t last, ParseTreeNode*& head, ParseTreeNode*& tail,
+                               size_t& end) {
+    tokenIndex = first;
+    currentToken = tokens->type(first);
+    currentLexeme = tokens->lexeme(first);
+    head = nullptr;
+    tail = nullptr;
+
+    while (tokenIndex < last && (match(ID) || match(IF) || match(WHILE) || match(LBRACE))) {
+        ParseTreeNode* stmt = parseStatement();
+        if (!stmt) {
+            return false;
+        }
+        ParseTreeNode* element = stmt;
+        if (!options.flattenLists) {
+            element = newNonTerminal(RULE_STATEMENT_LIST_PRIME);
+            element->addChild(stmt);
+        }
+        if (!head) {
+            head = element;
+        } else if (options.flattenLists) {
+            tail->nextSibling = element;
+        } else {
+            tail->addChild(element);
+        }
+        tail = element;
+    }
+
+    end = tokenIndex;
+    return true;
+}
+
+// statement-list ::= statement-list', the program's own list
+ParseTreeNode* Parser::parseStatementListParallel() {
+    size_t first = tokenIndex;
+    size_t chunkTokens = max(MIN_CHUNK_TOKENS, (tokens->size() - first) / (options.jobs * CHUNKS_PER_THREAD));
+    vector<size_t> splits;
+    findSplits(*tokens, first, chunkTokens, splits);
+    if (splits.empty()) {
+        return parseStatementList();
+    }
+
+    // Chunk i covers tokens [bounds[i], bounds[i + 1]); the last one runs
+    // to the end of the list
+    vector<size_t> bounds;
+    bounds.push_back(first);
+    bounds.insert(bounds.end(), splits.begin(), splits.end());
+    bounds.push_back(SIZE_MAX);
+    size_t chunks = bounds.size() - 1;
+
+    ParserOptions chunkOptions = options;
+    chunkOptions.jobs = 1;
+    while (chunkParsers.size() < chunks) {
+        chunkParsers.emplace_back(new Parser(*tokens, chunkOptions));
+        chunkParsers.back()->chunkParser = true;
+    }
+
+    struct Chunk {
+        ParseTreeNode* head;
+        ParseTreeNode* tail;
+        size_t end;
+        bool ok;
+    };
+    vector<Chunk> results(chunks);
+    WorkStealingPool pool(options.jobs);
+    pool.run(chunks, [&](size_t i, unsigned) {
+        Parser& chunk = *chunkParsers[i];
+        chunk.reset(chunkOptions);
+        chunk.tokens = tokens;
+        chunk.chunkTerminals.clear();
+        Chunk& result = results[i];
+        result.ok = chunk.parseStatementRun(bounds[i], bounds[i + 1], result.head, result.tail, result.end) &&
+                    (i + 1 == chunks || result.end == bounds[i + 1]);
+    });
+
+    for (const Chunk& result : results) {
+        if (!result.ok) {
+            tokenIndex = first;
+            currentToken = tokens->type(first);
+            currentLexeme = tokens->lexeme(first);
+            return parseStatementList();
+        }
+    }
+
+    // Give the chunks' lexemes their IDs in this parser's interner. Taking
+    // the chunks in order, and each chunk's symbols in the order it first
+    // saw them, hands out the IDs the sequential parse would have.
+    vector<vector<uint32_t>> remaps(chunks);
+    for (size_t i = 0; i < chunks; i++) {
+        const StringInterner& chunkSymbols = chunkParsers[i]->symbols;
+        remaps[i].resize(chunkSymbols.size());
+        for (uint32_t id = 0; id < chunkSymbols.size(); id++) {
+            remaps[i][id] = symbols.intern(chunkSymbols.str(id));
+        }
+    }
+    pool.run(chunks, [&](size_t i, unsigned) {
+        const vector<uint32_t>& remap = remaps[i];
+        for (ParseTreeNode* terminal : chunkParsers[i]->chunkTerminals) {
+            terminal->symbol = remap[terminal->symbol];
+        }
+    });
+
+    // Stitch the chunks together: each chunk's last element takes the next
+    // chunk's first as its following ' node (or sibling)
+    auto node = newNonTerminal(RULE_STATEMENT_LIST);
+    node->addChild(results[0].head);
+    for (size_t i = 0; i + 1 < chunks; i++) {
+        if (options.flattenLists) {
+            results[i].tail->nextSibling = results[i + 1].head;
+        } else {
+            results[i].tail->addChild(results[i + 1].head);
+        }
+    }
+    if (options.flattenLists) {
+        node->lastChild = results[chunks - 1].tail;
+    } else {
+        ParseTreeNode* last = newNonTerminal(RULE_STATEMENT_LIST_PRIME);
+        last->addChild(newEpsilon());
+        results[chunks - 1].tail->addChild(last);
+    }
+
+    tokenIndex = results[chunks - 1].end;
+    currentToken = tokens->type(tokenIndex);
+    currentLexeme = tokens->lexeme(tokenIndex);
+    return node;
+}
@@ -0,0 +1,293 @@
+#include "ParseCache.h"
+#include "TreeFile.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t xxRound(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t xxMerge(uint64_t acc, uint64_t value) {
+    acc ^= xxRound(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+// Reference XXH64 (little-endian reads, as on every platform we build for)
+uint64_t xxHash64(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        const unsigned char* limit = end - 32;
+        do {
+            v1 = xxRound(v1, read64(p));
+            v2 = xxRound(v2, read64(p + 8));
+            v3 = xxRound(v3, read64(p + 16));
+            v4 = xxRound(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxMerge(h, v1);
+        h = xxMerge(h, v2);
+        h = xxMerge(h, v3);
+        h = xxMerge(h, v4);
+    } else {
+        h = seed + PRIME64_5;
+    }
+
+    h += static_cast<uint64_t>(size);
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxRound(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(read32(p)) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static const char ENTRY_MAGIC[8] = {'C', 'M', 'C', 'A', 'C', 'H', 'E', '\0'};
+
+/* Fixed part of an entry file; the error message follows it */
+struct CacheEntryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t ok;
+    uint64_t inputSize;
+    uint64_t parseMicros;
+    uint32_t messageLength;
+    uint32_t hasTree;
+};
+
+ParseCache::ParseCache(const string& dir, uint64_t limit, bool trees)
+    : directory(dir), maxBytes(limit), storeTrees(trees), hitCount(0), missCount(0),
+      savedMicros(0), tempCounter(0) {}
+
+bool ParseCache::open() {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        return false;
+    }
+    struct stat st;
+    return stat(directory.c_str(), &st) == 0 && S_ISDIR(st.st_mode) &&
+           access(directory.c_str(), R_OK | W_OK | X_OK) == 0;
+}
+
+uint64_t ParseCache::key(const char* data, size_t size, const ParserOptions& options) const {
+    // Only stored trees depend on the list shape; the error cap changes
+    // the messages
+    uint64_t seed = static_cast<uint64_t>(PARSE_CACHE_VERSION) << 1;
+    if (storeTrees && options.flattenLists) {
+        seed |= 1;
+    }
+    seed |= static_cast<uint64_t>(options.maxErrors) << 32;
+    return xxHash64(data, size, seed);
+}
+
+string ParseCache::entryPath(uint64_t key, const char* extension) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx%s", static_cast<unsigned long long>(key), extension);
+    return directory + name;
+}
+
+string ParseCache::tempPath() {
+    char name[64];
+    snprintf(name, sizeof(name), "/.tmp-%ld-%llu", static_cast<long>(getpid()),
+             static_cast<unsigned long long>(tempCounter++));
+    return directory + name;
+}
+
+bool ParseCache::writeAtomically(const string& path, const string& contents) {
+    string temp = tempPath();
+    FILE* out = fopen(temp.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    bool ok = fwrite(contents.data(), 1, contents.size(), out) == contents.size();
+    ok = fclose(out) == 0 && ok;
+    if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ParseCache::lookup(uint64_t key, size_t inputSize, CachedResult& result) {
+    string path = entryPath(key, ".entry");
+    FILE* in = fopen(path.c_str(), "rb");
+    if (!in) {
+        missCount++;
+        return false;
+    }
+
+    CacheEntryHeader header;
+    bool valid = fread(&header, sizeof(header), 1, in) == 1 &&
+                 memcmp(header.magic, ENTRY_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == PARSE_CACHE_VERSION && header.inputSize == inputSize;
+    if (valid) {
+        // A truncated or corrupt entry must not make us allocate the
+        // length it claims
+        struct stat info;
+        valid = fstat(fileno(in), &info) == 0 && static_cast<uint64_t>(info.st_size) >= sizeof(header) &&
+                header.messageLength <= static_cast<uint64_t>(info.st_size) - sizeof(header);
+    }
+    if (valid) {
+        result.message.resize(header.messageLength);
+        valid = header.messageLength == 0 ||
+                fread(&result.message[0], 1, header.messageLength, in) == header.messageLength;
+    }
+    fclose(in);
+
+    result.treePath.clear();
+    if (valid && header.hasTree) {
+        // The tree may have been evicted on its own; that costs a reparse
+        result.treePath = entryPath(key, ".ptree");
+        valid = access(result.treePath.c_str(), R_OK) == 0;
+    }
+    if (!valid) {
+        missCount++;
+        return false;
+    }
+
+    result.ok = header.ok != 0;
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);   // Mark as recently used
+    hitCount++;
+    savedMicros += header.parseMicros;
+    return true;
+}
+
+void ParseCache::store(uint64_t key, size_t inputSize, bool ok, const string& message,
+                       double parseSeconds, const ParseTreeNode* tree, const StringInterner* symbols) {
+    bool hasTree = false;
+    if (storeTrees && ok && tree && symbols) {
+        // Write the tree first so an entry never points at a missing tree
+        string temp = tempPath();
+        if (writeTreeFile(tree, *symbols, temp) &&
+            rename(temp.c_str(), entryPath(key, ".ptree").c_str()) == 0) {
+            hasTree = true;
+        } else {
+            unlink(temp.c_str());
+        }
+    }
+
+    CacheEntryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ENTRY_MAGIC, sizeof(header.magic));
+    header.version = PARSE_CACHE_VERSION;
+    header.ok = ok ? 1 : 0;
+    header.inputSize = inputSize;
+    header.parseMicros = static_cast<uint64_t>(parseSeconds * 1e6);
+    header.messageLength = static_cast<uint32_t>(message.size());
+    header.hasTree = hasTree ? 1 : 0;
+
+    string contents(reinterpret_cast<const char*>(&header), sizeof(header));
+    contents += message;
+    writeAtomically(entryPath(key, ".entry"), contents);
+}
+
+void ParseCache::trim() {
+    struct Entry {
+        string path;        // Without extension
+        uint64_t bytes;
+        struct timespec used;
+    };
+    vector<Entry> entries;
+    uint64_t total = 0;
+
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        return;
+    }
+    struct dirent* d;
+    while ((d = readdir(dir)) != nullptr) {
+        string name = d->d_name;
+        size_t dot = name.rfind('.');
+        if (name[0] == '.' || dot == string::npos || name.compare(dot, string::npos, ".entry") != 0) {
+            continue;
+        }
+        string base = directory + "/" + name.substr(0, dot);
+        struct stat entrySt, treeSt;
+        if (stat((base + ".entry").c_str(), &entrySt) != 0) {
+            continue;   // Evicted by another process meanwhile
+        }
+        uint64_t bytes = static_cast<uint64_t>(entrySt.st_size);
+        if (stat((base + ".ptree").c_str(), &treeSt) == 0) {
+            bytes += static_cast<uint64_t>(treeSt.st_size);
+        }
+        entries.push_back(Entry{base, bytes, entrySt.st_mtim});
+        total += bytes;
+    }
+    closedir(dir);
+
+    if (total <= maxBytes) {
+        return;
+    }
+
+    // Oldest first; stop a little under the limit so trims are not constant
+    sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        if (a.used.tv_sec != b.used.tv_sec) {
+            return a.used.tv_sec < b.used.tv_sec;
+        }
+        return a.used.tv_nsec < b.used.tv_nsec;
+    });
+    uint64_t target = maxBytes - maxBytes / 10;
+    for (const Entry& e : entries) {
+        if (total <= target) {
+            break;
+        }
+        unlink((e.path + ".entry").c_str());
+        unlink((e.path + ".ptree").c_str());
+        total -= e.bytes;
+    }
+}
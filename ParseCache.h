@@ -0,0 +1,83 @@
+#ifndef PARSECACHE_H
+#define PARSECACHE_H
+
+#include "Parser.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Bump whenever the grammar, the parser or its error messages change, so
+// results cached by older builds are never returned
+static const uint32_t PARSE_CACHE_VERSION = 1;
+
+// XXH64 of a byte range
+uint64_t xxHash64(const void* data, size_t size, uint64_t seed);
+
+/* What a cache entry records about one input */
+struct CachedResult {
+    bool ok;
+    std::string message;        // Error text when !ok
+    std::string treePath;       // .ptree of the tree, empty if not stored
+};
+
+/*
+ * On-disk parse result cache, keyed by a content hash of the input.
+ *
+ * Each entry is a small file named after the key, holding the outcome
+ * (success or the error message) and the time the parse took; with
+ * storeTrees the tree is saved next to it as a .ptree file. Entries are
+ * written to a temporary file and renamed into place, so any number of
+ * threads and processes can share one directory: a reader sees either a
+ * complete entry or none. A hit refreshes the entry's modification time,
+ * and trim() evicts the least recently used entries once the directory
+ * grows past its size limit.
+ *
+ * All methods are safe to call from several threads.
+ */
+class ParseCache {
+public:
+    ParseCache(const std::string& directory, uint64_t maxBytes, bool storeTrees);
+
+    ParseCache(const ParseCache&) = delete;
+    ParseCache& operator=(const ParseCache&) = delete;
+
+    // Create the directory if needed. Returns false if it is unusable.
+    bool open();
+
+    // Key of an input: its content hash mixed with the cache version and
+    // the options that change the stored result
+    uint64_t key(const char* data, size_t size, const ParserOptions& options) const;
+
+    // Look up an entry. inputSize guards against hash collisions.
+    bool lookup(uint64_t key, size_t inputSize, CachedResult& result);
+
+    // Record a parse. tree and symbols are only used when storing trees.
+    void store(uint64_t key, size_t inputSize, bool ok, const std::string& message,
+               double parseSeconds, const ParseTreeNode* tree, const StringInterner* symbols);
+
+    // Evict least recently used entries until the cache fits its limit
+    void trim();
+
+    bool storesTrees() const { return storeTrees; }
+    uint64_t hits() const { return hitCount; }
+    uint64_t misses() const { return missCount; }
+    // Parse time recorded in the entries that were hit
+    double savedSeconds() const { return savedMicros / 1e6; }
+
+private:
+    std::string directory;
+    uint64_t maxBytes;
+    bool storeTrees;
+
+    std::atomic<uint64_t> hitCount;
+    std::atomic<uint64_t> missCount;
+    std::atomic<uint64_t> savedMicros;
+    std::atomic<uint64_t> tempCounter;
+
+    std::string entryPath(uint64_t key, const char* extension) const;
+    std::string tempPath();
+    bool writeAtomically(const std::string& path, const std::string& contents);
+};
+
+#endif /* PARSECACHE_H */
@@ -1,4 +1,159 @@
 #include "ParseTree.h"
+#include "StringInterner.h"
+#include "Stats.h"
+#include <cstdlib>
 
-// Initialize static member
-int ParseTreeNode::nodeCounter = 0;
+using namespace std;
+
+void NodeArena::grow(size_t minSize) {
+    if (spare && spare->size >= minSize + sizeof(Block)) {
+        Block* block = spare;
+        spare = block->next;
+        block->next = head;
+        head = block;
+        cursor = reinterpret_cast<char*>(block) + sizeof(Block);
+        limit = reinterpret_cast<char*>(block) + block->size;
+        blockCount++;
+        return;
+    }
+
+    size_t size = nextBlockSize;
+    while (size < minSize + sizeof(Block)) {
+        size *= 2;
+    }
+    nextBlockSize = size * 2;
+
+    Block* block = static_cast<Block*>(malloc(size));
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    STATS_ALLOCATION(size);
+    block->size = size;
+    block->next = head;
+    head = block;
+    cursor = reinterpret_cast<char*>(block) + sizeof(Block);
+    limit = reinterpret_cast<char*>(block) + size;
+    blockCount++;
+}
+
+void NodeArena::release() {
+    reset();
+    while (spare) {
+        Block* next = spare->next;
+        free(spare);
+        spare = next;
+    }
+    nextBlockSize = INITIAL_BLOCK_SIZE;
+}
+
+void NodeArena::reset() {
+    // Move the blocks in use to spare, keeping it sorted largest first
+    Block* blocks = head;
+    while (blocks) {
+        Block* next = blocks->next;
+        Block** link = &spare;
+        while (*link && (*link)->size > blocks->size) {
+            link = &(*link)->next;
+        }
+        blocks->next = *link;
+        *link = blocks;
+        blocks = next;
+    }
+    head = nullptr;
+    cursor = nullptr;
+    limit = nullptr;
+    blockCount = 0;
+    bytesAllocated = 0;
+}
+
+const char* ruleName(RuleId rule) {
+    static const char* const names[RULE_COUNT] = {
+        "program",
+        "declaration-list",
+        "declaration-list'",
+        "declaration",
+        "var-declaration",
+        "var-declaration'",
+        "type-specifier",
+        "params",
+        "param-list",
+        "param-list'",
+        "param",
+        "param'",
+        "compound-stmt",
+        "statement-list",
+        "statement-list'",
+        "statement",
+        "selection-stmt",
+        "selection-stmt'",
+        "iteration-stmt",
+        "assignment-stmt",
+        "var",
+        "var'",
+        "expression",
+        "expression'",
+        "relop",
+        "additive-expression",
+        "additive-expression'",
+        "addop",
+        "term",
+        "term'",
+        "mulop",
+        "factor",
+    };
+    return rule < RULE_COUNT ? names[rule] : "?";
+}
+
+const char* tokenName(TokenType type) {
+    switch (type) {
+        case IF:        return "if";
+        case ELSE:      return "else";
+        case WHILE:     return "while";
+        case INT:       return "int";
+        case FLOAT:     return "float";
+        case RETURN:    return "return";
+        case VOID:      return "void";
+        case PROGRAM:   return "Program";
+        case ID:        return "ID";
+        case NUM:       return "NUM";
+        case PLUS:      return "+";
+        case MINUS:     return "-";
+        case TIMES:     return "*";
+        case DIVIDE:    return "/";
+        case LT:        return "<";
+        case LTE:       return "<=";
+        case GT:        return ">";
+        case GTE:       return ">=";
+        case EQ:        return "==";
+        case NEQ:       return "!=";
+        case ASSIGN:    return "=";
+        case SEMI:      return ";";
+        case COMMA:     return ",";
+        case LPAREN:    return "(";
+        case RPAREN:    return ")";
+        case LBRACKET:  return "[";
+        case RBRACKET:  return "]";
+        case LBRACE:    return "{";
+        case RBRACE:    return "}";
+        case DOT:       return ".";
+        case ENDOFFILE: return "EOF";
+        default:        return "ERROR";
+    }
+}
+
+string ParseTreeNode::label(const StringInterner& symbols) const {
+    switch (kind) {
+        case NODE_NONTERMINAL:
+            return ruleName(rule);
+        case NODE_TERMINAL: {
+            string text = tokenName(tokenType());
+            text += ": ";
+            text += symbols.str(symbol);
+            return text;
+        }
+        case NODE_ERROR:
+            return "error";
+        default:
+            return "ε";
+    }
+}
@@ -1,93 +1,215 @@
 #ifndef PARSETREE_H
 #define PARSETREE_H
 
+#include "token.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <string>
-#include <vector>
-#include <memory>
-#include <fstream>
-
-/* Parse tree node base class */
-class ParseTreeNode {
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Bump allocator that owns every node of a parse tree.
+ *
+ * Memory is carved out of a chain of blocks whose size doubles as the tree
+ * grows, so a tree of N nodes lives in O(log N) blocks. Nodes are never
+ * destroyed individually: release() drops all blocks at once.
+ */
+class NodeArena {
 public:
-    std::string label;
-    std::vector<std::shared_ptr<ParseTreeNode>> children;
+    NodeArena() : head(nullptr), spare(nullptr), cursor(nullptr), limit(nullptr),
+                  nextBlockSize(INITIAL_BLOCK_SIZE), blockCount(0), bytesAllocated(0) {}
 
-    ParseTreeNode(const std::string& lbl) : label(lbl) {}
+    ~NodeArena() { release(); }
 
-    virtual ~ParseTreeNode() {}
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
 
-    void addChild(std::shared_ptr<ParseTreeNode> child) {
-        if (child) {
-            children.push_back(child);
+    void* allocate(size_t size, size_t align) {
+        char* p = alignUp(cursor, align);
+        if (!p || p + size > limit) {
+            grow(size + align);
+            p = alignUp(cursor, align);
         }
+        cursor = p + size;
+        bytesAllocated += size;
+        return p;
     }
 
-    // Generate unique node ID for Graphviz
-    static int nodeCounter;
-    int nodeId;
+    // Construct an object inside the arena (its destructor is never run)
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "arena objects must be trivially destructible");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
 
-    void assignIds() {
-        nodeId = nodeCounter++;
-        for (auto& child : children) {
-            if (child) {
-                child->assignIds();
-            }
-        }
+    // Copy a string into the arena, NUL-terminated
+    const char* copyString(const char* str, size_t len) {
+        char* p = static_cast<char*>(allocate(len + 1, 1));
+        memcpy(p, str, len);
+        p[len] = '\0';
+        return p;
     }
 
-    // Output to Graphviz format
-    void toGraphviz(std::ofstream& out) {
-        // Output this node
-        out << "  node" << nodeId << " [label=\"" << escapeLabel(label) << "\"];\n";
+    // Free every block; all pointers handed out become invalid
+    void release();
 
-        // Output edges to children
-        for (auto& child : children) {
-            if (child) {
-                out << "  node" << nodeId << " -> node" << child->nodeId << ";\n";
-            }
-        }
+    // Invalidate every pointer handed out but keep the blocks, which are
+    // reused (largest first) before any new block is allocated
+    void reset();
 
-        // Recursively output children
-        for (auto& child : children) {
-            if (child) {
-                child->toGraphviz(out);
-            }
-        }
-    }
+    size_t blocks() const { return blockCount; }
+    size_t bytesUsed() const { return bytesAllocated; }
 
 private:
-    std::string escapeLabel(const std::string& str) {
-        std::string result;
-        for (char c : str) {
-            if (c == '"' || c == '\\') {
-                result += '\\';
+    struct Block {
+        Block* next;
+        size_t size;
+    };
+
+    static const size_t INITIAL_BLOCK_SIZE = 16 * 1024;
+
+    Block* head;
+    Block* spare;       // Blocks kept by reset(), largest first
+    char* cursor;
+    char* limit;
+    size_t nextBlockSize;
+    size_t blockCount;
+    size_t bytesAllocated;
+
+    static char* alignUp(char* p, size_t align) {
+        return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + align - 1) & ~(uintptr_t)(align - 1));
+    }
+
+    void grow(size_t minSize);
+};
+
+/* Nonterminals of the enhanced grammar; names live in ruleName() */
+enum RuleId : uint8_t {
+    RULE_PROGRAM,
+    RULE_DECLARATION_LIST,
+    RULE_DECLARATION_LIST_PRIME,
+    RULE_DECLARATION,
+    RULE_VAR_DECLARATION,
+    RULE_VAR_DECLARATION_PRIME,
+    RULE_TYPE_SPECIFIER,
+    RULE_PARAMS,
+    RULE_PARAM_LIST,
+    RULE_PARAM_LIST_PRIME,
+    RULE_PARAM,
+    RULE_PARAM_PRIME,
+    RULE_COMPOUND_STMT,
+    RULE_STATEMENT_LIST,
+    RULE_STATEMENT_LIST_PRIME,
+    RULE_STATEMENT,
+    RULE_SELECTION_STMT,
+    RULE_SELECTION_STMT_PRIME,
+    RULE_ITERATION_STMT,
+    RULE_ASSIGNMENT_STMT,
+    RULE_VAR,
+    RULE_VAR_PRIME,
+    RULE_EXPRESSION,
+    RULE_EXPRESSION_PRIME,
+    RULE_RELOP,
+    RULE_ADDITIVE_EXPRESSION,
+    RULE_ADDITIVE_EXPRESSION_PRIME,
+    RULE_ADDOP,
+    RULE_TERM,
+    RULE_TERM_PRIME,
+    RULE_MULOP,
+    RULE_FACTOR,
+    RULE_COUNT
+};
+
+// Grammar name of a rule, e.g. "additive-expression'"
+const char* ruleName(RuleId rule);
+
+// Name a terminal is shown with in the tree and in errors: "ID", "NUM",
+// "Program", a keyword or the operator/delimiter itself
+const char* tokenName(TokenType type);
+
+class StringInterner;
+
+enum NodeKind : uint8_t {
+    NODE_NONTERMINAL,
+    NODE_TERMINAL,
+    NODE_EPSILON,
+    NODE_ERROR          // Tokens skipped by error recovery, kept as its children
+};
+
+/*
+ * Parse tree node base class.
+ *
+ * Nodes are plain arena objects: children form an intrusive singly linked
+ * list (firstChild / nextSibling) so adding a child never allocates, and
+ * no node owns another.
+ *
+ * Nodes hold no text. A nonterminal stores its RuleId, a terminal its token
+ * type and the interned symbol ID of its lexeme; labels are built only by
+ * writers that print them, from the parser's StringInterner.
+ */
+class ParseTreeNode {
+public:
+    NodeKind kind;
+    RuleId rule;            // Nonterminals only
+    uint16_t token;         // TokenType, terminals only
+    union {
+        uint32_t symbol;        // Interned lexeme, terminals only
+        uint32_t tokenCount;    // Tokens spanned, nonterminals (kept by IncrementalParser)
+    };
+    ParseTreeNode* firstChild;
+    ParseTreeNode* lastChild;
+    ParseTreeNode* nextSibling;
+
+    ParseTreeNode(NodeKind k, RuleId r, TokenType t, uint32_t sym)
+        : kind(k), rule(r), token(static_cast<uint16_t>(t)), symbol(sym), firstChild(nullptr),
+          lastChild(nullptr), nextSibling(nullptr) {}
+
+    void addChild(ParseTreeNode* child) {
+        if (child) {
+            if (lastChild) {
+                lastChild->nextSibling = child;
+            } else {
+                firstChild = child;
             }
-            result += c;
+            lastChild = child;
         }
-        return result;
     }
+
+    TokenType tokenType() const { return static_cast<TokenType>(token); }
+
+    // Label shown for this node: the rule name, "<token>: <lexeme>", "ε"
+    // or "error"
+    std::string label(const StringInterner& symbols) const;
 };
 
 /* Terminal node (leaf) */
 class TerminalNode : public ParseTreeNode {
 public:
-    std::string lexeme;
-
-    TerminalNode(const std::string& tokenType, const std::string& lex)
-        : ParseTreeNode(tokenType + ": " + lex), lexeme(lex) {}
+    TerminalNode(TokenType type, uint32_t lexemeSymbol)
+        : ParseTreeNode(NODE_TERMINAL, RULE_COUNT, type, lexemeSymbol) {}
 };
 
 /* Non-terminal node */
 class NonTerminalNode : public ParseTreeNode {
 public:
-    NonTerminalNode(const std::string& ruleName)
-        : ParseTreeNode(ruleName) {}
+    explicit NonTerminalNode(RuleId rule)
+        : ParseTreeNode(NODE_NONTERMINAL, rule, ERROR, 0) {}
 };
 
 /* Empty/Epsilon node */
 class EpsilonNode : public ParseTreeNode {
 public:
-    EpsilonNode() : ParseTreeNode("ε") {}
+    EpsilonNode() : ParseTreeNode(NODE_EPSILON, RULE_COUNT, ERROR, 0) {}
+};
+
+/* Placeholder for input the parser could not parse */
+class ErrorNode : public ParseTreeNode {
+public:
+    ErrorNode() : ParseTreeNode(NODE_ERROR, RULE_COUNT, ERROR, 0) {}
 };
 
 #endif /* PARSETREE_H */
@@ -3,129 +3,263 @@
 
 using namespace std;
 
-// program ::= Program ID "{" declaration-list statement-list "}" "."
-shared_ptr<ParseTreeNode> Parser::parseProgram() {
-    auto node = make_shared<NonTerminalNode>("program");
+// Panic-mode recovery after a syntax error: skip to the next token in sync
+// (or the end of input), adding the skipped tokens to error when one is
+// given. Once maxErrors errors have been reported the rest of the input is
+// skipped without building nodes.
+void Parser::skipTo(TokenSet sync, ParseTreeNode* error) {
+    if (reachedErrorLimit()) {
+        if (tokens) {
+            tokenIndex = tokens->size() - 1;
+            currentToken = ENDOFFILE;
+            currentLexeme = tokens->lexeme(tokenIndex);
+        }
+        while (currentToken != ENDOFFILE) {
+            nextToken();
+        }
+    }
 
-    auto programToken = consume(PROGRAM, "Program");
-    if (!programToken) return nullptr;
-    node->addChild(programToken);
+    while (!inTokenSet(sync, currentToken) && currentToken != ENDOFFILE) {
+        if (error) {
+            addChild(error, newTerminal(currentToken));
+        }
+        nextToken();
+    }
 
-    auto idToken = consume(ID, "ID");
-    if (!idToken) return nullptr;
-    node->addChild(idToken);
+    // Errors at the token recovery stopped on are cascades of this one
+    errorPosition = tokenPosition();
+}
+
+// Recover inside a list of the parse tree: the skipped tokens are kept
+// under an error node added to parent, so the caller can go on with the
+// next element. Returns the error node, or nullptr when recovery is off
+// and the caller must fail as before.
+ParseTreeNode* Parser::recover(ParseTreeNode* parent, TokenSet sync) {
+    if (!recovering()) {
+        return nullptr;
+    }
+
+    ParseTreeNode* error = newError();
+    addChild(parent, error);
+    skipTo(sync, error);
+    return error;
+}
+
+// Consume a token that must be at this place (the program header, a
+// closing brace). When recovering, a missing one is reported and then
+// assumed present, so the enclosing rule still produces its node.
+bool Parser::expect(ParseTreeNode* parent, TokenType expected) {
+    ParseTreeNode* token = consume(expected);
+    if (token) {
+        addChild(parent, token);
+        return true;
+    }
+    return recovering();
+}
+
+ParseTreeNode* Parser::parseFragment(RuleId rule, size_t first, size_t& end) {
+    hasError = false;
+    errorMessage.clear();
+    diagnostics.clear();
+    tokenIndex = first;
+    currentToken = tokens->type(first);
+    currentLexeme = tokens->lexeme(first);
+
+    ParseTreeNode* node = nullptr;
+    switch (rule) {
+        case RULE_STATEMENT:     node = parseStatement(); break;
+        case RULE_COMPOUND_STMT: node = parseCompoundStmt(); break;
+        case RULE_DECLARATION:   node = parseDeclaration(); break;
+        case RULE_EXPRESSION:    node = parseExpression(); break;
+        default:                 reportError("Rule cannot be parsed on its own"); break;
+    }
+
+    end = tokenIndex;
+    return hasError ? nullptr : node;
+}
 
-    auto lbrace1 = consume(LBRACE, "{");
-    if (!lbrace1) return nullptr;
-    node->addChild(lbrace1);
+bool Parser::matchFragment(TokenType expected, size_t first) {
+    hasError = false;
+    errorMessage.clear();
+    diagnostics.clear();
+    tokenIndex = first;
+    currentToken = tokens->type(first);
+    currentLexeme = tokens->lexeme(first);
+
+    if (match(expected)) {
+        return true;
+    }
+    reportMissing(expected);
+    return false;
+}
+
+void Parser::reset() {
+    currentToken = ERROR;
+    currentLexeme = string_view();
+    currentLine = 0;
+    currentCol = 0;
+    hasError = false;
+    errorMessage.clear();
+    diagnostics.clear();
+    errorPosition = 0;
+    tokenIndex = 0;
+    arena.reset();
+    symbols.clear();
+    for (auto& chunk : chunkParsers) {
+        chunk->reset();
+    }
+#ifdef CMINUS_STATS
+    counters = ParserCounters();
+#endif
+}
+
+bool Parser::bindInput(const char* data, size_t size) {
+    reset();
+    ownInput.copy(data, size);
+    if (ownLexer && ownLexer->backend() == options.lexerBackend) {
+        ownLexer->reset(ownInput);
+    } else {
+        ownLexer.reset(new Lexer(ownInput, options.lexerBackend));
+        ownLexer->setPrintErrors(false);
+    }
+    lexer.reset();
+    tokens = &ownTokens;
+    if (!ownTokens.tokenize(ownInput, *ownLexer)) {
+        hasError = true;
+        errorMessage = "Input is too large (4 GB limit)";
+        return false;
+    }
+    return true;
+}
+
+// program ::= Program ID "{" declaration-list statement-list "}" "."
+ParseTreeNode* Parser::parseProgram() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_PROGRAM);
+
+    if (!expect(node, PROGRAM)) return nullptr;
+    if (!expect(node, ID)) return nullptr;
+    if (!expect(node, LBRACE)) return nullptr;
 
     auto declList = parseDeclarationList();
     if (!declList) return nullptr;
-    node->addChild(declList);
+    addChild(node, declList);
 
-    auto stmtList = parseStatementList();
+    auto stmtList = parallelEligible() ? parseStatementListParallel() : parseStatementList();
     if (!stmtList) return nullptr;
-    node->addChild(stmtList);
-
-    auto rbrace = consume(RBRACE, "}");
-    if (!rbrace) return nullptr;
-    node->addChild(rbrace);
+    addChild(node, stmtList);
 
-    auto dot = consume(DOT, ".");
-    if (!dot) return nullptr;
-    node->addChild(dot);
+    if (!expect(node, RBRACE)) return nullptr;
+    if (!expect(node, DOT)) return nullptr;
 
     return node;
 }
 
 // declaration-list ::= declaration declaration-list'
-shared_ptr<ParseTreeNode> Parser::parseDeclarationList() {
-    auto node = make_shared<NonTerminalNode>("declaration-list");
+ParseTreeNode* Parser::parseDeclarationList() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_DECLARATION_LIST);
 
     auto decl = parseDeclaration();
-    if (!decl) return nullptr;
-    node->addChild(decl);
+    if (decl) {
+        addChild(node, decl);
+    } else if (!recoverDeclaration(node)) {
+        return nullptr;
+    }
 
-    auto declListPrime = parseDeclarationListPrime();
-    if (!declListPrime) return nullptr;
-    node->addChild(declListPrime);
+    if (!parseDeclarationListPrime(node)) return nullptr;
 
     return node;
 }
 
 // declaration-list' ::= declaration declaration-list' | empty
-shared_ptr<ParseTreeNode> Parser::parseDeclarationListPrime() {
-    auto node = make_shared<NonTerminalNode>("declaration-list'");
+// Parsed iteratively: each loop turn consumes one declaration.
+bool Parser::parseDeclarationListPrime(ParseTreeNode* owner) {
+    STATS_RULE(counters);
+    ParseTreeNode* tail = openList(owner, RULE_DECLARATION_LIST_PRIME);
 
     // Check if we have another declaration (starts with type-specifier: int or float)
-    if (match(INT) || match(FLOAT)) {
+    while (match(INT) || match(FLOAT)) {
         auto decl = parseDeclaration();
-        if (!decl) return nullptr;
-        node->addChild(decl);
+        if (decl) {
+            addChild(tail, decl);
+        } else if (!recoverDeclaration(tail)) {
+            return false;
+        }
 
-        auto declListPrime = parseDeclarationListPrime();
-        if (!declListPrime) return nullptr;
-        node->addChild(declListPrime);
-    } else {
-        // Empty production
-        node->addChild(make_shared<EpsilonNode>());
+        tail = extendList(tail, RULE_DECLARATION_LIST_PRIME);
     }
 
-    return node;
+    // Empty production
+    closeList(tail);
+    return true;
+}
+
+// Skip the rest of a broken declaration, up to and including its ";"
+bool Parser::recoverDeclaration(ParseTreeNode* parent) {
+    ParseTreeNode* error = recover(parent, DECLARATION_SYNC);
+    if (!error) return false;
+    if (match(SEMI)) {
+        addChild(error, consume(SEMI));
+    }
+    return true;
 }
 
 // declaration ::= var-declaration
-shared_ptr<ParseTreeNode> Parser::parseDeclaration() {
-    auto node = make_shared<NonTerminalNode>("declaration");
+ParseTreeNode* Parser::parseDeclaration() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_DECLARATION);
 
     auto varDecl = parseVarDeclaration();
     if (!varDecl) return nullptr;
-    node->addChild(varDecl);
+    addChild(node, varDecl);
 
     return node;
 }
 
 // var-declaration ::= type-specifier ID var-declaration'
-shared_ptr<ParseTreeNode> Parser::parseVarDeclaration() {
-    auto node = make_shared<NonTerminalNode>("var-declaration");
+ParseTreeNode* Parser::parseVarDeclaration() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_VAR_DECLARATION);
 
     auto typeSpec = parseTypeSpecifier();
     if (!typeSpec) return nullptr;
-    node->addChild(typeSpec);
+    addChild(node, typeSpec);
 
-    auto idToken = consume(ID, "ID");
+    auto idToken = consume(ID);
     if (!idToken) return nullptr;
-    node->addChild(idToken);
+    addChild(node, idToken);
 
     auto varDeclPrime = parseVarDeclarationPrime();
     if (!varDeclPrime) return nullptr;
-    node->addChild(varDeclPrime);
+    addChild(node, varDeclPrime);
 
     return node;
 }
 
 // var-declaration' ::= ";" | "[" NUM "]" ";"
-shared_ptr<ParseTreeNode> Parser::parseVarDeclarationPrime() {
-    auto node = make_shared<NonTerminalNode>("var-declaration'");
+ParseTreeNode* Parser::parseVarDeclarationPrime() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_VAR_DECLARATION_PRIME);
 
     if (match(SEMI)) {
-        auto semi = consume(SEMI, ";");
-        node->addChild(semi);
+        auto semi = consume(SEMI);
+        addChild(node, semi);
     } else if (match(LBRACKET)) {
-        auto lbracket = consume(LBRACKET, "[");
-        node->addChild(lbracket);
+        auto lbracket = consume(LBRACKET);
+        addChild(node, lbracket);
 
-        auto num = consume(NUM, "NUM");
+        auto num = consume(NUM);
         if (!num) return nullptr;
-        node->addChild(num);
+        addChild(node, num);
 
-        auto rbracket = consume(RBRACKET, "]");
+        auto rbracket = consume(RBRACKET);
         if (!rbracket) return nullptr;
-        node->addChild(rbracket);
+        addChild(node, rbracket);
 
-        auto semi = consume(SEMI, ";");
+        auto semi = consume(SEMI);
         if (!semi) return nullptr;
-        node->addChild(semi);
+        addChild(node, semi);
     } else {
         reportError("Expected ';' or '[' in variable declaration");
         return nullptr;
@@ -135,15 +269,16 @@ shared_ptr<ParseTreeNode> Parser::parseVarDeclarationPrime() {
 }
 
 // type-specifier ::= int | float
-shared_ptr<ParseTreeNode> Parser::parseTypeSpecifier() {
-    auto node = make_shared<NonTerminalNode>("type-specifier");
+ParseTreeNode* Parser::parseTypeSpecifier() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_TYPE_SPECIFIER);
 
     if (match(INT)) {
-        auto intToken = consume(INT, "int");
-        node->addChild(intToken);
+        auto intToken = consume(INT);
+        addChild(node, intToken);
     } else if (match(FLOAT)) {
-        auto floatToken = consume(FLOAT, "float");
-        node->addChild(floatToken);
+        auto floatToken = consume(FLOAT);
+        addChild(node, floatToken);
     } else {
         reportError("Expected 'int' or 'float'");
         return nullptr;
@@ -153,16 +288,17 @@ shared_ptr<ParseTreeNode> Parser::parseTypeSpecifier() {
 }
 
 // params ::= param-list | "void"
-shared_ptr<ParseTreeNode> Parser::parseParams() {
-    auto node = make_shared<NonTerminalNode>("params");
+ParseTreeNode* Parser::parseParams() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_PARAMS);
 
     if (match(VOID)) {
-        auto voidToken = consume(VOID, "void");
-        node->addChild(voidToken);
+        auto voidToken = consume(VOID);
+        addChild(node, voidToken);
     } else if (match(INT) || match(FLOAT)) {
         auto paramList = parseParamList();
         if (!paramList) return nullptr;
-        node->addChild(paramList);
+        addChild(node, paramList);
     } else {
         reportError("Expected parameter list or 'void'");
         return nullptr;
@@ -172,152 +308,162 @@ shared_ptr<ParseTreeNode> Parser::parseParams() {
 }
 
 // param-list ::= param param-list'
-shared_ptr<ParseTreeNode> Parser::parseParamList() {
-    auto node = make_shared<NonTerminalNode>("param-list");
+ParseTreeNode* Parser::parseParamList() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_PARAM_LIST);
 
     auto param = parseParam();
     if (!param) return nullptr;
-    node->addChild(param);
+    addChild(node, param);
 
-    auto paramListPrime = parseParamListPrime();
-    if (!paramListPrime) return nullptr;
-    node->addChild(paramListPrime);
+    if (!parseParamListPrime(node)) return nullptr;
 
     return node;
 }
 
 // param-list' ::= "," param param-list' | empty
-shared_ptr<ParseTreeNode> Parser::parseParamListPrime() {
-    auto node = make_shared<NonTerminalNode>("param-list'");
+// Parsed iteratively: each loop turn consumes one "," param.
+bool Parser::parseParamListPrime(ParseTreeNode* owner) {
+    STATS_RULE(counters);
+    ParseTreeNode* tail = openList(owner, RULE_PARAM_LIST_PRIME);
 
-    if (match(COMMA)) {
-        auto comma = consume(COMMA, ",");
-        node->addChild(comma);
+    while (match(COMMA)) {
+        auto comma = consume(COMMA);
+        addChild(tail, comma);
 
         auto param = parseParam();
-        if (!param) return nullptr;
-        node->addChild(param);
+        if (!param) return false;
+        addChild(tail, param);
 
-        auto paramListPrime = parseParamListPrime();
-        if (!paramListPrime) return nullptr;
-        node->addChild(paramListPrime);
-    } else {
-        // Empty production
-        node->addChild(make_shared<EpsilonNode>());
+        tail = extendList(tail, RULE_PARAM_LIST_PRIME);
     }
 
-    return node;
+    // Empty production
+    closeList(tail);
+    return true;
 }
 
 // param ::= type-specifier ID param'
-shared_ptr<ParseTreeNode> Parser::parseParam() {
-    auto node = make_shared<NonTerminalNode>("param");
+ParseTreeNode* Parser::parseParam() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_PARAM);
 
     auto typeSpec = parseTypeSpecifier();
     if (!typeSpec) return nullptr;
-    node->addChild(typeSpec);
+    addChild(node, typeSpec);
 
-    auto idToken = consume(ID, "ID");
+    auto idToken = consume(ID);
     if (!idToken) return nullptr;
-    node->addChild(idToken);
+    addChild(node, idToken);
 
     auto paramPrime = parseParamPrime();
     if (!paramPrime) return nullptr;
-    node->addChild(paramPrime);
+    addChild(node, paramPrime);
 
     return node;
 }
 
 // param' ::= empty | "[" "]"
-shared_ptr<ParseTreeNode> Parser::parseParamPrime() {
-    auto node = make_shared<NonTerminalNode>("param'");
+ParseTreeNode* Parser::parseParamPrime() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_PARAM_PRIME);
 
     if (match(LBRACKET)) {
-        auto lbracket = consume(LBRACKET, "[");
-        node->addChild(lbracket);
+        auto lbracket = consume(LBRACKET);
+        addChild(node, lbracket);
 
-        auto rbracket = consume(RBRACKET, "]");
+        auto rbracket = consume(RBRACKET);
         if (!rbracket) return nullptr;
-        node->addChild(rbracket);
+        addChild(node, rbracket);
     } else {
         // Empty production
-        node->addChild(make_shared<EpsilonNode>());
+        addChild(node, newEpsilon());
     }
 
     return node;
 }
 
 // compound-stmt ::= "{" statement-list "}"
-shared_ptr<ParseTreeNode> Parser::parseCompoundStmt() {
-    auto node = make_shared<NonTerminalNode>("compound-stmt");
+ParseTreeNode* Parser::parseCompoundStmt() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_COMPOUND_STMT);
 
-    auto lbrace = consume(LBRACE, "{");
+    auto lbrace = consume(LBRACE);
     if (!lbrace) return nullptr;
-    node->addChild(lbrace);
+    addChild(node, lbrace);
 
     auto stmtList = parseStatementList();
     if (!stmtList) return nullptr;
-    node->addChild(stmtList);
+    addChild(node, stmtList);
 
-    auto rbrace = consume(RBRACE, "}");
-    if (!rbrace) return nullptr;
-    node->addChild(rbrace);
+    if (!expect(node, RBRACE)) return nullptr;
 
     return node;
 }
 
 // statement-list ::= statement-list'
-shared_ptr<ParseTreeNode> Parser::parseStatementList() {
-    auto node = make_shared<NonTerminalNode>("statement-list");
+ParseTreeNode* Parser::parseStatementList() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_STATEMENT_LIST);
 
-    auto stmtListPrime = parseStatementListPrime();
-    if (!stmtListPrime) return nullptr;
-    node->addChild(stmtListPrime);
+    if (!parseStatementListPrime(node)) return nullptr;
 
     return node;
 }
 
 // statement-list' ::= statement statement-list' | empty
-shared_ptr<ParseTreeNode> Parser::parseStatementListPrime() {
-    auto node = make_shared<NonTerminalNode>("statement-list'");
+// Parsed iteratively: each loop turn consumes one statement.
+bool Parser::parseStatementListPrime(ParseTreeNode* owner) {
+    STATS_RULE(counters);
+    ParseTreeNode* tail = openList(owner, RULE_STATEMENT_LIST_PRIME);
 
     // Check if we have a statement (starts with ID, if, while, or {)
-    if (match(ID) || match(IF) || match(WHILE) || match(LBRACE)) {
-        auto stmt = parseStatement();
-        if (!stmt) return nullptr;
-        node->addChild(stmt);
-
-        auto stmtListPrime = parseStatementListPrime();
-        if (!stmtListPrime) return nullptr;
-        node->addChild(stmtListPrime);
-    } else {
-        // Empty production
-        node->addChild(make_shared<EpsilonNode>());
+    for (;;) {
+        if (match(ID) || match(IF) || match(WHILE) || match(LBRACE)) {
+            auto stmt = parseStatement();
+            if (stmt) {
+                addChild(tail, stmt);
+            } else if (!recover(tail, STATEMENT_SYNC)) {
+                return false;
+            }
+        } else if (recovering() && !match(RBRACE) && !match(ENDOFFILE)) {
+            // A token that neither starts a statement nor ends the list:
+            // the error the enclosing "}" would report, then skip it
+            reportMissing(RBRACE);
+            recover(tail, STATEMENT_SYNC);
+        } else {
+            break;
+        }
+
+        tail = extendList(tail, RULE_STATEMENT_LIST_PRIME);
     }
 
-    return node;
+    // Empty production
+    closeList(tail);
+    return true;
 }
 
 // statement ::= assignment-stmt | compound-stmt | selection-stmt | iteration-stmt
-shared_ptr<ParseTreeNode> Parser::parseStatement() {
-    auto node = make_shared<NonTerminalNode>("statement");
+ParseTreeNode* Parser::parseStatement() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_STATEMENT);
 
     if (match(ID)) {
         auto assignStmt = parseAssignmentStmt();
         if (!assignStmt) return nullptr;
-        node->addChild(assignStmt);
+        addChild(node, assignStmt);
     } else if (match(LBRACE)) {
         auto compStmt = parseCompoundStmt();
         if (!compStmt) return nullptr;
-        node->addChild(compStmt);
+        addChild(node, compStmt);
     } else if (match(IF)) {
         auto selStmt = parseSelectionStmt();
         if (!selStmt) return nullptr;
-        node->addChild(selStmt);
+        addChild(node, selStmt);
     } else if (match(WHILE)) {
         auto iterStmt = parseIterationStmt();
         if (!iterStmt) return nullptr;
-        node->addChild(iterStmt);
+        addChild(node, iterStmt);
     } else {
         reportError("Expected statement");
         return nullptr;
@@ -327,335 +473,241 @@ shared_ptr<ParseTreeNode> Parser::parseStatement() {
 }
 
 // selection-stmt ::= if "(" expression ")" statement selection-stmt'
-shared_ptr<ParseTreeNode> Parser::parseSelectionStmt() {
-    auto node = make_shared<NonTerminalNode>("selection-stmt");
+ParseTreeNode* Parser::parseSelectionStmt() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_SELECTION_STMT);
 
-    auto ifToken = consume(IF, "if");
+    auto ifToken = consume(IF);
     if (!ifToken) return nullptr;
-    node->addChild(ifToken);
+    addChild(node, ifToken);
 
-    auto lparen = consume(LPAREN, "(");
+    auto lparen = consume(LPAREN);
     if (!lparen) return nullptr;
-    node->addChild(lparen);
+    addChild(node, lparen);
 
     auto expr = parseExpression();
     if (!expr) return nullptr;
-    node->addChild(expr);
+    addChild(node, expr);
 
-    auto rparen = consume(RPAREN, ")");
+    auto rparen = consume(RPAREN);
     if (!rparen) return nullptr;
-    node->addChild(rparen);
+    addChild(node, rparen);
 
     auto stmt = parseStatement();
     if (!stmt) return nullptr;
-    node->addChild(stmt);
+    addChild(node, stmt);
 
     auto selStmtPrime = parseSelectionStmtPrime();
     if (!selStmtPrime) return nullptr;
-    node->addChild(selStmtPrime);
+    addChild(node, selStmtPrime);
 
     return node;
 }
 
 // selection-stmt' ::= empty | else statement
-shared_ptr<ParseTreeNode> Parser::parseSelectionStmtPrime() {
-    auto node = make_shared<NonTerminalNode>("selection-stmt'");
+ParseTreeNode* Parser::parseSelectionStmtPrime() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_SELECTION_STMT_PRIME);
 
     if (match(ELSE)) {
-        auto elseToken = consume(ELSE, "else");
-        node->addChild(elseToken);
+        auto elseToken = consume(ELSE);
+        addChild(node, elseToken);
 
         auto stmt = parseStatement();
         if (!stmt) return nullptr;
-        node->addChild(stmt);
+        addChild(node, stmt);
     } else {
         // Empty production
-        node->addChild(make_shared<EpsilonNode>());
+        addChild(node, newEpsilon());
     }
 
     return node;
 }
 
 // iteration-stmt ::= while "(" expression ")" statement
-shared_ptr<ParseTreeNode> Parser::parseIterationStmt() {
-    auto node = make_shared<NonTerminalNode>("iteration-stmt");
+ParseTreeNode* Parser::parseIterationStmt() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_ITERATION_STMT);
 
-    auto whileToken = consume(WHILE, "while");
+    auto whileToken = consume(WHILE);
     if (!whileToken) return nullptr;
-    node->addChild(whileToken);
+    addChild(node, whileToken);
 
-    auto lparen = consume(LPAREN, "(");
+    auto lparen = consume(LPAREN);
     if (!lparen) return nullptr;
-    node->addChild(lparen);
+    addChild(node, lparen);
 
     auto expr = parseExpression();
     if (!expr) return nullptr;
-    node->addChild(expr);
+    addChild(node, expr);
 
-    auto rparen = consume(RPAREN, ")");
+    auto rparen = consume(RPAREN);
     if (!rparen) return nullptr;
-    node->addChild(rparen);
+    addChild(node, rparen);
 
     auto stmt = parseStatement();
     if (!stmt) return nullptr;
-    node->addChild(stmt);
+    addChild(node, stmt);
 
     return node;
 }
 
 // assignment-stmt ::= var "=" expression
-shared_ptr<ParseTreeNode> Parser::parseAssignmentStmt() {
-    auto node = make_shared<NonTerminalNode>("assignment-stmt");
+ParseTreeNode* Parser::parseAssignmentStmt() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_ASSIGNMENT_STMT);
 
     auto varNode = parseVar();
     if (!varNode) return nullptr;
-    node->addChild(varNode);
+    addChild(node, varNode);
 
-    auto assign = consume(ASSIGN, "=");
+    auto assign = consume(ASSIGN);
     if (!assign) return nullptr;
-    node->addChild(assign);
+    addChild(node, assign);
 
     auto expr = parseExpression();
     if (!expr) return nullptr;
-    node->addChild(expr);
+    addChild(node, expr);
 
     return node;
 }
 
 // var ::= ID var'
-shared_ptr<ParseTreeNode> Parser::parseVar() {
-    auto node = make_shared<NonTerminalNode>("var");
+ParseTreeNode* Parser::parseVar() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_VAR);
 
-    auto idToken = consume(ID, "ID");
+    auto idToken = consume(ID);
     if (!idToken) return nullptr;
-    node->addChild(idToken);
+    addChild(node, idToken);
 
     auto varPrime = parseVarPrime();
     if (!varPrime) return nullptr;
-    node->addChild(varPrime);
+    addChild(node, varPrime);
 
     return node;
 }
 
 // var' ::= empty | "[" expression "]"
-shared_ptr<ParseTreeNode> Parser::parseVarPrime() {
-    auto node = make_shared<NonTerminalNode>("var'");
+ParseTreeNode* Parser::parseVarPrime() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_VAR_PRIME);
 
     if (match(LBRACKET)) {
-        auto lbracket = consume(LBRACKET, "[");
-        node->addChild(lbracket);
+        auto lbracket = consume(LBRACKET);
+        addChild(node, lbracket);
 
         auto expr = parseExpression();
         if (!expr) return nullptr;
-        node->addChild(expr);
+        addChild(node, expr);
 
-        auto rbracket = consume(RBRACKET, "]");
+        auto rbracket = consume(RBRACKET);
         if (!rbracket) return nullptr;
-        node->addChild(rbracket);
+        addChild(node, rbracket);
     } else {
         // Empty production
-        node->addChild(make_shared<EpsilonNode>());
+        addChild(node, newEpsilon());
     }
 
     return node;
 }
 
-// expression ::= additive-expression expression'
-shared_ptr<ParseTreeNode> Parser::parseExpression() {
-    auto node = make_shared<NonTerminalNode>("expression");
-
-    auto addExpr = parseAdditiveExpression();
-    if (!addExpr) return nullptr;
-    node->addChild(addExpr);
-
-    auto exprPrime = parseExpressionPrime();
-    if (!exprPrime) return nullptr;
-    node->addChild(exprPrime);
-
-    return node;
-}
+// Rules of the three precedence levels, loosest first. A level's node holds
+// one operand of the next level, then its ' chain of operator-operand pairs.
+static const RuleId LEVEL_RULES[PRECEDENCE_LEVELS] = {
+    RULE_EXPRESSION, RULE_ADDITIVE_EXPRESSION, RULE_TERM};
+static const RuleId LEVEL_PRIME_RULES[PRECEDENCE_LEVELS] = {
+    RULE_EXPRESSION_PRIME, RULE_ADDITIVE_EXPRESSION_PRIME, RULE_TERM_PRIME};
+static const RuleId LEVEL_OPERATOR_RULES[PRECEDENCE_LEVELS] = {RULE_RELOP, RULE_ADDOP, RULE_MULOP};
 
+// expression ::= additive-expression expression'
 // expression' ::= relop additive-expression expression' | empty
-shared_ptr<ParseTreeNode> Parser::parseExpressionPrime() {
-    auto node = make_shared<NonTerminalNode>("expression'");
-
-    if (match(LT) || match(LTE) || match(GT) || match(GTE) || match(EQ) || match(NEQ)) {
-        auto relop = parseRelop();
-        if (!relop) return nullptr;
-        node->addChild(relop);
-
-        auto addExpr = parseAdditiveExpression();
-        if (!addExpr) return nullptr;
-        node->addChild(addExpr);
-
-        auto exprPrime = parseExpressionPrime();
-        if (!exprPrime) return nullptr;
-        node->addChild(exprPrime);
-    } else {
-        // Empty production
-        node->addChild(make_shared<EpsilonNode>());
-    }
-
-    return node;
-}
-
 // relop ::= "<" | "<=" | ">" | ">=" | "==" | "!="
-shared_ptr<ParseTreeNode> Parser::parseRelop() {
-    auto node = make_shared<NonTerminalNode>("relop");
-
-    if (match(LT)) {
-        node->addChild(consume(LT, "<"));
-    } else if (match(LTE)) {
-        node->addChild(consume(LTE, "<="));
-    } else if (match(GT)) {
-        node->addChild(consume(GT, ">"));
-    } else if (match(GTE)) {
-        node->addChild(consume(GTE, ">="));
-    } else if (match(EQ)) {
-        node->addChild(consume(EQ, "=="));
-    } else if (match(NEQ)) {
-        node->addChild(consume(NEQ, "!="));
-    } else {
-        reportError("Expected relational operator");
-        return nullptr;
-    }
-
-    return node;
-}
-
 // additive-expression ::= term additive-expression'
-shared_ptr<ParseTreeNode> Parser::parseAdditiveExpression() {
-    auto node = make_shared<NonTerminalNode>("additive-expression");
-
-    auto termNode = parseTerm();
-    if (!termNode) return nullptr;
-    node->addChild(termNode);
-
-    auto addExprPrime = parseAdditiveExpressionPrime();
-    if (!addExprPrime) return nullptr;
-    node->addChild(addExprPrime);
-
-    return node;
-}
-
 // additive-expression' ::= addop term additive-expression' | empty
-shared_ptr<ParseTreeNode> Parser::parseAdditiveExpressionPrime() {
-    auto node = make_shared<NonTerminalNode>("additive-expression'");
-
-    if (match(PLUS) || match(MINUS)) {
-        auto addop = parseAddop();
-        if (!addop) return nullptr;
-        node->addChild(addop);
-
-        auto termNode = parseTerm();
-        if (!termNode) return nullptr;
-        node->addChild(termNode);
-
-        auto addExprPrime = parseAdditiveExpressionPrime();
-        if (!addExprPrime) return nullptr;
-        node->addChild(addExprPrime);
-    } else {
-        // Empty production
-        node->addChild(make_shared<EpsilonNode>());
-    }
-
-    return node;
-}
-
 // addop ::= "+" | "-"
-shared_ptr<ParseTreeNode> Parser::parseAddop() {
-    auto node = make_shared<NonTerminalNode>("addop");
-
-    if (match(PLUS)) {
-        node->addChild(consume(PLUS, "+"));
-    } else if (match(MINUS)) {
-        node->addChild(consume(MINUS, "-"));
-    } else {
-        reportError("Expected '+' or '-'");
-        return nullptr;
-    }
-
-    return node;
-}
-
 // term ::= factor term'
-shared_ptr<ParseTreeNode> Parser::parseTerm() {
-    auto node = make_shared<NonTerminalNode>("term");
-
-    auto factorNode = parseFactor();
-    if (!factorNode) return nullptr;
-    node->addChild(factorNode);
-
-    auto termPrime = parseTermPrime();
-    if (!termPrime) return nullptr;
-    node->addChild(termPrime);
-
-    return node;
-}
-
 // term' ::= mulop factor term' | empty
-shared_ptr<ParseTreeNode> Parser::parseTermPrime() {
-    auto node = make_shared<NonTerminalNode>("term'");
-
-    if (match(TIMES) || match(DIVIDE)) {
-        auto mulop = parseMulop();
-        if (!mulop) return nullptr;
-        node->addChild(mulop);
+// mulop ::= "*" | "/"
+//
+// Parsed by precedence climbing with the binding powers in Parser.h,
+// building the same tree as one function per rule. node[l] is the open
+// node of level l and tail[l] the end of its ' chain (nullptr until its
+// first operand is complete). Only parentheses and array indexes recurse,
+// so a chain of any length runs in constant stack.
+ParseTreeNode* Parser::parseExpression() {
+    STATS_RULE(counters);
+    ParseTreeNode* node[PRECEDENCE_LEVELS];
+    ParseTreeNode* tail[PRECEDENCE_LEVELS];
+
+    // Each operand opens the levels from first down, under parent; after a
+    // mulop it opens none and the factor goes straight under parent
+    int first = 0;
+    ParseTreeNode* parent = nullptr;
+    for (;;) {
+        for (int l = first; l < PRECEDENCE_LEVELS; l++) {
+            node[l] = newNonTerminal(LEVEL_RULES[l]);
+            tail[l] = nullptr;
+            if (l > first) {
+                addChild(node[l - 1], node[l]);
+            } else if (parent) {
+                addChild(parent, node[l]);
+            }
+        }
 
         auto factorNode = parseFactor();
         if (!factorNode) return nullptr;
-        node->addChild(factorNode);
-
-        auto termPrime = parseTermPrime();
-        if (!termPrime) return nullptr;
-        node->addChild(termPrime);
-    } else {
-        // Empty production
-        node->addChild(make_shared<EpsilonNode>());
-    }
-
-    return node;
-}
-
-// mulop ::= "*" | "/"
-shared_ptr<ParseTreeNode> Parser::parseMulop() {
-    auto node = make_shared<NonTerminalNode>("mulop");
-
-    if (match(TIMES)) {
-        node->addChild(consume(TIMES, "*"));
-    } else if (match(DIVIDE)) {
-        node->addChild(consume(DIVIDE, "/"));
-    } else {
-        reportError("Expected '*' or '/'");
-        return nullptr;
+        addChild(first < PRECEDENCE_LEVELS ? node[PRECEDENCE_LEVELS - 1] : parent, factorNode);
+
+        // Going up, each level has one more complete operand. Levels binding
+        // tighter than the next operator end their chain with epsilon; the
+        // operator's own level takes it.
+        int level = static_cast<int>(bindingPower(currentToken)) - 1;
+        int l = PRECEDENCE_LEVELS - 1;
+        for (;; l--) {
+            tail[l] = tail[l] ? extendList(tail[l], LEVEL_PRIME_RULES[l])
+                              : openList(node[l], LEVEL_PRIME_RULES[l]);
+            if (l == level) {
+                break;
+            }
+            closeList(tail[l]);
+            if (l == 0) {
+                return node[0];
+            }
+        }
+
+        auto op = newNonTerminal(LEVEL_OPERATOR_RULES[l]);
+        addChild(op, consume(currentToken));
+        addChild(tail[l], op);
+        first = l + 1;
+        parent = tail[l];
     }
-
-    return node;
 }
 
 // factor ::= "(" expression ")" | var | NUM
-shared_ptr<ParseTreeNode> Parser::parseFactor() {
-    auto node = make_shared<NonTerminalNode>("factor");
+ParseTreeNode* Parser::parseFactor() {
+    STATS_RULE(counters);
+    auto node = newNonTerminal(RULE_FACTOR);
 
     if (match(LPAREN)) {
-        auto lparen = consume(LPAREN, "(");
-        node->addChild(lparen);
+        auto lparen = consume(LPAREN);
+        addChild(node, lparen);
 
         auto expr = parseExpression();
         if (!expr) return nullptr;
-        node->addChild(expr);
+        addChild(node, expr);
 
-        auto rparen = consume(RPAREN, ")");
+        auto rparen = consume(RPAREN);
         if (!rparen) return nullptr;
-        node->addChild(rparen);
+        addChild(node, rparen);
     } else if (match(ID)) {
         auto varNode = parseVar();
         if (!varNode) return nullptr;
-        node->addChild(varNode);
+        addChild(node, varNode);
     } else if (match(NUM)) {
-        auto num = consume(NUM, "NUM");
+        auto num = consume(NUM);
         if (!num) return nullptr;
-        node->addChild(num);
+        addChild(node, num);
     } else {
         reportError("Expected '(', identifier, or number");
         return nullptr;
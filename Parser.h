@@ -2,34 +2,203 @@
 #define PARSER_H
 
 #include "token.h"
+#include "Lexer.h"
+#include "TokenBuffer.h"
 #include "ParseTree.h"
+#include "Ast.h"
+#include "StringInterner.h"
+#include "Stats.h"
 #include <memory>
 #include <string>
+#include <string_view>
 #include <sstream>
+#include <vector>
+
+/* Options for Parser: the shape of the tree it builds and its scanner */
+struct ParserOptions {
+    // Build each right-recursive list (declaration-list, param-list,
+    // statement-list, expression, additive-expression, term) as a single
+    // node holding all its elements, instead of a nested chain of ' nodes
+    // ending in an epsilon.
+    bool flattenLists;
+
+    // Scanner used when the parser lexes its own input
+    LexerBackend lexerBackend;
+
+    // Syntax errors to report before giving up. With 1 the parser stops at
+    // the first error; with more it recovers (panic mode) and keeps going,
+    // returning a partial tree with error nodes.
+    unsigned maxErrors;
+
+    // Parse with the table-driven LL(1) engine (TableParser.cpp) instead
+    // of the recursive descent functions. The tree and the first error are
+    // the same; there is no error recovery.
+    bool tableDriven;
+
+    // Threads for parsing the program's top-level statement-list in
+    // parallel chunks (ParallelParser.cpp). Used only when parsing a token
+    // buffer into a parse tree without error recovery; 1 parses
+    // sequentially.
+    unsigned jobs;
+
+    ParserOptions()
+        : flattenLists(false), lexerBackend(DEFAULT_LEXER_BACKEND), maxErrors(1), tableDriven(false),
+          jobs(1) {}
+};
+
+/* One syntax error */
+struct Diagnostic {
+    long long line;
+    long long col;
+    std::string message;    // "SYNTAX ERROR at Line <line>, Col <col>: ..."
+};
+
+/* Set of token types, for the recovery synchronization sets */
+typedef uint64_t TokenSet;
+
+constexpr TokenSet tokenBit(TokenType type) {
+    return type >= IF && type < IF + 64 ? TokenSet(1) << (type - IF) : 0;
+}
+
+constexpr bool inTokenSet(TokenSet set, TokenType type) {
+    return (set & tokenBit(type)) != 0;
+}
+
+// Synchronization sets for panic-mode recovery, from the FIRST and FOLLOW
+// sets of grammar_enhanced.ebnf.
+//   FIRST(statement)       = ID if while {
+//   FOLLOW(statement-list) = }
+//   FIRST(declaration)     = int float
+//   FOLLOW(declaration-list) = FIRST(statement) + FOLLOW(statement-list)
+static constexpr TokenSet STATEMENT_FIRST = tokenBit(ID) | tokenBit(IF) | tokenBit(WHILE) | tokenBit(LBRACE);
+
+// After an error in a statement: the next statement or the end of the list
+static constexpr TokenSet STATEMENT_SYNC = STATEMENT_FIRST | tokenBit(RBRACE);
+
+// After an error in a declaration: its ";" (consumed), the next declaration
+// or whatever follows the declarations. ID is left out: the error is far
+// more often inside the declaration ("int b c;") than a missing ";" before
+// the first statement, and stopping there would parse the rest of every
+// declaration as statements.
+static constexpr TokenSet DECLARATION_SYNC =
+    tokenBit(SEMI) | tokenBit(INT) | tokenBit(FLOAT) | (STATEMENT_SYNC & ~tokenBit(ID));
+
+// Binding powers of the binary operators for the precedence-climbing
+// expression parsers: relop 1 (expression), addop 2 (additive-expression),
+// mulop 3 (term), and 0 for every token that is not a binary operator.
+static constexpr int PRECEDENCE_LEVELS = 3;
+
+struct BindingPowerTable {
+    uint8_t power[64];
+
+    constexpr BindingPowerTable() : power() {
+        power[LT - IF] = power[LTE - IF] = power[GT - IF] = 1;
+        power[GTE - IF] = power[EQ - IF] = power[NEQ - IF] = 1;
+        power[PLUS - IF] = power[MINUS - IF] = 2;
+        power[TIMES - IF] = power[DIVIDE - IF] = 3;
+    }
+};
+
+static constexpr BindingPowerTable BINDING_POWERS;
+
+constexpr unsigned bindingPower(TokenType type) {
+    return type >= IF && type < IF + 64 ? BINDING_POWERS.power[type - IF] : 0;
+}
 
 class Parser {
 private:
     TokenType currentToken;
-    std::string currentLexeme;
-    int currentLine;
-    int currentCol;
+    std::string_view currentLexeme;   // Points into the lexer's input, not copied
+    long long currentLine;
+    long long currentCol;
     bool hasError;
-    std::string errorMessage;
+    std::string errorMessage;               // First error
+    std::vector<Diagnostic> diagnostics;    // Every reported error, in order
+    size_t errorPosition;                   // Token position of the last report
+
+    ParserOptions options;
+
+    // Token source: either a scanner owned by this parser, or a token
+    // buffer lexed beforehand (read by index, positions computed lazily)
+    std::unique_ptr<Lexer> lexer;
+    const TokenBuffer* tokens;
+    size_t tokenIndex;
+
+    // Owns every node of the tree returned by parse()
+    NodeArena arena;
+
+    // Lexemes of the tree's terminals, each distinct spelling stored once
+    StringInterner symbols;
+
+    // Input given to parse(data, size): a padded copy of the text, the
+    // scanner and the token buffer, all kept for the next input
+    InputBuffer ownInput;
+    std::unique_ptr<Lexer> ownLexer;
+    TokenBuffer ownTokens;
+
+    // Parsers for the chunks of a parallel statement-list, kept (with
+    // their arenas, which own the chunks' nodes) for the next parse. A
+    // chunk parser only records that an error happened: the sequential
+    // fallback reports it.
+    std::vector<std::unique_ptr<Parser>> chunkParsers;
+    bool chunkParser;
+
+    // Terminals a chunk parser created, in order, for renumbering their
+    // symbols into the main parser's interner
+    std::vector<ParseTreeNode*> chunkTerminals;
+
+    // Set by check(): the node constructors return scratch instead of
+    // allocating, lexemes are not interned and addChild() links nothing.
+    // The grammar functions only ever test the nodes they get for nullptr,
+    // so they run unchanged.
+    bool recognizeOnly;
+    ParseTreeNode scratch;
+
+    // Updated only in CMINUS_STATS builds, but always present so the class
+    // has one layout
+    ParserCounters counters;
 
     // Fetch next token from lexer
     void nextToken() {
-        int token = yylex();
+        if (tokens) {
+            // The buffer ends in ENDOFFILE, which is never consumed
+            tokenIndex++;
+            currentToken = tokens->type(tokenIndex);
+            currentLexeme = tokens->lexeme(tokenIndex);
+            return;
+        }
+
+        int token;
+        {
+            STATS_LEX_TIME(counters);
+            token = lexer->next();
+        }
         if (token == 0) {
             currentToken = ENDOFFILE;
             currentLexeme = "EOF";
         } else {
             currentToken = static_cast<TokenType>(token);
-            currentLexeme = token_lexeme;
+            currentLexeme = lexer->lexeme();
+        }
+        currentLine = lexer->line();
+        currentCol = lexer->col();
+        STATS_TOKEN(counters, currentToken);
+    }
+
+    // Position of the current token, increasing as tokens are consumed
+    // (the scanner keeps the last offset at end of input)
+    size_t tokenPosition() const {
+        if (tokens) {
+            return tokenIndex;
         }
-        currentLine = line_num;
-        currentCol = col_num;
+        return currentToken == ENDOFFILE ? SIZE_MAX : lexer->offset();
     }
 
+    bool recovering() const { return options.maxErrors > 1; }
+
+    // Reset the parser and make data[0, size) its input
+    bool bindInput(const char* data, size_t size);
+
     // Match expected token
     bool match(TokenType expected) {
         if (currentToken == expected) {
@@ -38,85 +207,329 @@ private:
         return false;
     }
 
+    // Node constructors; every node lives in the parser's arena
+    ParseTreeNode* newNonTerminal(RuleId rule) {
+        if (recognizeOnly) {
+            return &scratch;
+        }
+        return arena.create<NonTerminalNode>(rule);
+    }
+
+    ParseTreeNode* newEpsilon() {
+        if (recognizeOnly) {
+            return &scratch;
+        }
+        return arena.create<EpsilonNode>();
+    }
+
+    ParseTreeNode* newError() {
+        if (recognizeOnly) {
+            return &scratch;
+        }
+        return arena.create<ErrorNode>();
+    }
+
+    // Terminal for the current token
+    ParseTreeNode* newTerminal(TokenType type) {
+        if (recognizeOnly) {
+            return &scratch;
+        }
+        return arena.create<TerminalNode>(type, symbols.intern(currentLexeme));
+    }
+
+    // Add child under parent. In check() mode every node is scratch, so
+    // nothing is linked and scratch never points back at itself.
+    void addChild(ParseTreeNode* parent, ParseTreeNode* child) {
+        if (!recognizeOnly) {
+            parent->addChild(child);
+        }
+    }
+
+    // List helpers for the right-recursive ' rules. The rules are parsed
+    // with loops; the "tail" is the node receiving the next list element:
+    // a fresh ' node chained under the previous one, or the list owner
+    // itself when lists are flattened.
+    ParseTreeNode* openList(ParseTreeNode* owner, RuleId primeRule) {
+        if (options.flattenLists) {
+            return owner;
+        }
+        ParseTreeNode* tail = newNonTerminal(primeRule);
+        addChild(owner, tail);
+        return tail;
+    }
+
+    ParseTreeNode* extendList(ParseTreeNode* tail, RuleId primeRule) {
+        return openList(tail, primeRule);
+    }
+
+    void closeList(ParseTreeNode* tail) {
+        // A flattened list only records epsilon when it has no elements
+        if (!options.flattenLists || !tail->firstChild) {
+            addChild(tail, newEpsilon());
+        }
+    }
+
     // Consume token and create terminal node
-    std::shared_ptr<ParseTreeNode> consume(TokenType expected, const std::string& tokenName) {
+    ParseTreeNode* consume(TokenType expected) {
         if (currentToken == expected) {
-            auto node = std::make_shared<TerminalNode>(tokenName, currentLexeme);
+            ParseTreeNode* node = newTerminal(expected);
+            if (chunkParser) {
+                chunkTerminals.push_back(node);
+            }
             nextToken();
             return node;
         } else {
-            reportError("Expected " + tokenName + " but found '" + currentLexeme + "'");
+            reportMissing(expected);
             return nullptr;
         }
     }
 
-    // Report parsing error
+    // Report parsing error. Only the first error is kept unless the parser
+    // recovers; then errors are kept up to the cap, except those raised
+    // before any token was consumed since the last one, which are cascades
+    // of it.
     void reportError(const std::string& message) {
-        if (!hasError) {  // Report only the first error
+        if (chunkParser) {
             hasError = true;
-            std::ostringstream oss;
-            oss << "SYNTAX ERROR at Line " << currentLine << ", Col " << currentCol
-                << ": " << message;
+            return;
+        }
+        if (hasError && (diagnostics.size() >= options.maxErrors || tokenPosition() == errorPosition)) {
+            return;
+        }
+        hasError = true;
+        errorPosition = tokenPosition();
+        if (tokens) {
+            tokens->position(tokenIndex, currentLine, currentCol);
+        }
+        std::ostringstream oss;
+        oss << "SYNTAX ERROR at Line " << currentLine << ", Col " << currentCol
+            << ": " << message;
+        if (diagnostics.empty()) {
             errorMessage = oss.str();
         }
+        diagnostics.push_back(Diagnostic{currentLine, currentCol, oss.str()});
+    }
+
+    void reportMissing(TokenType expected) {
+        reportError(std::string("Expected ") + tokenName(expected) + " but found '" + std::string(currentLexeme) + "'");
+    }
+
+    // Error recovery (see Parser.cpp)
+    void skipTo(TokenSet sync, ParseTreeNode* error);
+    ParseTreeNode* recover(ParseTreeNode* parent, TokenSet sync);
+    bool recoverDeclaration(ParseTreeNode* parent);
+    bool expect(ParseTreeNode* parent, TokenType expected);
+
+    // Line of the current token, recorded in AST nodes
+    uint32_t tokenLine() {
+        if (tokens) {
+            tokens->position(tokenIndex, currentLine, currentCol);
+        }
+        return static_cast<uint32_t>(currentLine);
+    }
+
+    // Step over a token the AST does not keep, reporting it if missing
+    bool skip(TokenType expected) {
+        if (currentToken == expected) {
+            nextToken();
+            return true;
+        }
+        reportMissing(expected);
+        return false;
+    }
+
+    // Intern the current token's lexeme and step over it
+    uint32_t take() {
+        uint32_t symbol = symbols.intern(currentLexeme);
+        nextToken();
+        return symbol;
     }
 
     // Parsing functions for each grammar rule
-    std::shared_ptr<ParseTreeNode> parseProgram();
-    std::shared_ptr<ParseTreeNode> parseDeclarationList();
-    std::shared_ptr<ParseTreeNode> parseDeclarationListPrime();
-    std::shared_ptr<ParseTreeNode> parseDeclaration();
-    std::shared_ptr<ParseTreeNode> parseVarDeclaration();
-    std::shared_ptr<ParseTreeNode> parseVarDeclarationPrime();
-    std::shared_ptr<ParseTreeNode> parseTypeSpecifier();
-    std::shared_ptr<ParseTreeNode> parseParams();
-    std::shared_ptr<ParseTreeNode> parseParamList();
-    std::shared_ptr<ParseTreeNode> parseParamListPrime();
-    std::shared_ptr<ParseTreeNode> parseParam();
-    std::shared_ptr<ParseTreeNode> parseParamPrime();
-    std::shared_ptr<ParseTreeNode> parseCompoundStmt();
-    std::shared_ptr<ParseTreeNode> parseStatementList();
-    std::shared_ptr<ParseTreeNode> parseStatementListPrime();
-    std::shared_ptr<ParseTreeNode> parseStatement();
-    std::shared_ptr<ParseTreeNode> parseSelectionStmt();
-    std::shared_ptr<ParseTreeNode> parseSelectionStmtPrime();
-    std::shared_ptr<ParseTreeNode> parseIterationStmt();
-    std::shared_ptr<ParseTreeNode> parseAssignmentStmt();
-    std::shared_ptr<ParseTreeNode> parseVar();
-    std::shared_ptr<ParseTreeNode> parseVarPrime();
-    std::shared_ptr<ParseTreeNode> parseExpression();
-    std::shared_ptr<ParseTreeNode> parseExpressionPrime();
-    std::shared_ptr<ParseTreeNode> parseRelop();
-    std::shared_ptr<ParseTreeNode> parseAdditiveExpression();
-    std::shared_ptr<ParseTreeNode> parseAdditiveExpressionPrime();
-    std::shared_ptr<ParseTreeNode> parseAddop();
-    std::shared_ptr<ParseTreeNode> parseTerm();
-    std::shared_ptr<ParseTreeNode> parseTermPrime();
-    std::shared_ptr<ParseTreeNode> parseMulop();
-    std::shared_ptr<ParseTreeNode> parseFactor();
+    ParseTreeNode* parseProgram();
+    ParseTreeNode* parseDeclarationList();
+    bool parseDeclarationListPrime(ParseTreeNode* owner);
+    ParseTreeNode* parseDeclaration();
+    ParseTreeNode* parseVarDeclaration();
+    ParseTreeNode* parseVarDeclarationPrime();
+    ParseTreeNode* parseTypeSpecifier();
+    ParseTreeNode* parseParams();
+    ParseTreeNode* parseParamList();
+    bool parseParamListPrime(ParseTreeNode* owner);
+    ParseTreeNode* parseParam();
+    ParseTreeNode* parseParamPrime();
+    ParseTreeNode* parseCompoundStmt();
+    ParseTreeNode* parseStatementList();
+    bool parseStatementListPrime(ParseTreeNode* owner);
+    ParseTreeNode* parseStatement();
+    ParseTreeNode* parseSelectionStmt();
+    ParseTreeNode* parseSelectionStmtPrime();
+    ParseTreeNode* parseIterationStmt();
+    ParseTreeNode* parseAssignmentStmt();
+    ParseTreeNode* parseVar();
+    ParseTreeNode* parseVarPrime();
+    ParseTreeNode* parseExpression();   // Also additive-expression, term and their ' rules
+    ParseTreeNode* parseFactor();
+
+    // Parallel parsing (ParallelParser.cpp): the top-level statement-list
+    // split at statement boundaries and parsed in chunks by chunkParsers
+    bool parallelEligible() const {
+        return options.jobs > 1 && tokens && !recovering() && !chunkParser && !recognizeOnly;
+    }
+    ParseTreeNode* parseStatementListParallel();
+    bool parseStatementRun(size_t first, size_t last, ParseTreeNode*& head, ParseTreeNode*& tail, size_t& end);
+
+    // Table-driven LL(1) engine (TableParser.cpp): parses a whole program
+    // with an explicit stack, in place of parseProgram()
+    ParseTreeNode* parseTable();
+
+    // AST construction (AstParser.cpp): one function per construct the AST
+    // keeps, following the same grammar and reporting the same errors
+    AstNode* astRecover(TokenSet sync);
+    bool astExpect(TokenType expected);
+    AstNode* astProgram();
+    bool astDeclarationList(AstNode*& head);
+    AstNode* astDeclaration();
+    bool astStatementList(AstNode*& head);
+    AstNode* astStatement();
+    AstNode* astCompoundStmt();
+    AstNode* astSelectionStmt();
+    AstNode* astIterationStmt();
+    AstNode* astAssignmentStmt();
+    AstNode* astVar();
+    AstNode* astExpression();
+    AstNode* astBinary(unsigned minPower);
+    AstNode* astFactor();
 
 public:
-    Parser() : currentToken(ERROR), currentLine(0), currentCol(0), hasError(false) {}
+    // Parse the C- program read from input. Each Parser owns its scanner,
+    // so parsers for different inputs can run on different threads.
+    explicit Parser(FILE* input, const ParserOptions& opts = ParserOptions())
+        : currentToken(ERROR), currentLine(0), currentCol(0), hasError(false), errorPosition(0),
+          options(opts), lexer(new Lexer(input, opts.lexerBackend)), tokens(nullptr), tokenIndex(0),
+          chunkParser(false), recognizeOnly(false), scratch(NODE_EPSILON, RULE_COUNT, ERROR, 0) {}
 
-    // Main parse function
-    std::shared_ptr<ParseTreeNode> parse() {
-        nextToken();  // Get first token
-        auto tree = parseProgram();
+    // Parse source text held in memory, scanning it in place. The buffer
+    // must outlive the parser.
+    explicit Parser(const InputBuffer& input, const ParserOptions& opts = ParserOptions())
+        : currentToken(ERROR), currentLine(0), currentCol(0), hasError(false), errorPosition(0),
+          options(opts), lexer(new Lexer(input, opts.lexerBackend)), tokens(nullptr), tokenIndex(0),
+          chunkParser(false), recognizeOnly(false), scratch(NODE_EPSILON, RULE_COUNT, ERROR, 0) {}
 
-        if (hasError) {
+    // Parse a token stream lexed beforehand. The buffer (and its source
+    // text) must outlive the parser.
+    explicit Parser(const TokenBuffer& input, const ParserOptions& opts = ParserOptions())
+        : currentToken(ERROR), currentLine(0), currentCol(0), hasError(false), errorPosition(0),
+          options(opts), tokens(&input), tokenIndex(0),
+          chunkParser(false), recognizeOnly(false), scratch(NODE_EPSILON, RULE_COUNT, ERROR, 0) {}
+
+    // Reusable parser with no input yet: give it one with parse(data, size)
+    // or parseAst(data, size), as many times as needed
+    explicit Parser(const ParserOptions& opts = ParserOptions())
+        : currentToken(ERROR), currentLine(0), currentCol(0), hasError(false), errorPosition(0),
+          options(opts), tokens(nullptr), tokenIndex(0),
+          chunkParser(false), recognizeOnly(false), scratch(NODE_EPSILON, RULE_COUNT, ERROR, 0) {}
+
+    // Forget the tree, the errors and the interned lexemes, but keep the
+    // node arena's blocks, the intern table and the token buffer for the
+    // next input. Every node and string the parser handed out is invalid.
+    void reset();
+    void reset(const ParserOptions& opts) {
+        options = opts;
+        reset();
+    }
+
+    // Parse a program held in memory: resets the parser, copies the text,
+    // lexes it into the parser's own token buffer and parses that. The data
+    // need not be NUL-terminated or outlive the call. Lexical errors are
+    // not echoed to stderr; they surface as syntax errors on the bad token.
+    ParseTreeNode* parse(const char* data, size_t size) {
+        return bindInput(data, size) ? parse() : nullptr;
+    }
+    AstNode* parseAst(const char* data, size_t size) {
+        return bindInput(data, size) ? parseAst() : nullptr;
+    }
+
+    // Main parse function. The returned tree is owned by the parser and
+    // stays valid until the parser is destroyed. On a syntax error it is
+    // nullptr, or with error recovery a partial tree (check hadError()).
+    ParseTreeNode* parse() {
+        if (tokens) {
+            // Load the first token without advancing
+            currentToken = tokens->type(0);
+            currentLexeme = tokens->lexeme(0);
+        } else {
+            nextToken();  // Get first token
+        }
+        ParseTreeNode* tree = options.tableDriven ? parseTable() : parseProgram();
+
+        if (!tree || (hasError && !recovering())) {
             return nullptr;
         }
 
         if (currentToken != ENDOFFILE) {
-            reportError("Expected end of file but found '" + currentLexeme + "'");
-            return nullptr;
+            reportError("Expected end of file but found '" + std::string(currentLexeme) + "'");
+            if (!recovering()) {
+                return nullptr;
+            }
+            recover(tree, 0);
         }
 
         return tree;
     }
 
+    // Recognize the program without building anything: no nodes, no
+    // interned lexemes. Errors, recovery and diagnostics are as for
+    // parse(). Returns whether the input is a valid program.
+    bool check() {
+        recognizeOnly = true;
+        ParseTreeNode* tree = parse();
+        recognizeOnly = false;
+        return tree && !hasError;
+    }
+    bool check(const char* data, size_t size) {
+        return bindInput(data, size) && check();
+    }
+
+    // Parse the program into an AST (see Ast.h) instead of a parse tree.
+    // The concrete tree is never built. Errors and recovery are as for
+    // parse(); recovered statements and declarations become AST_ERROR
+    // nodes.
+    AstNode* parseAst();
+
+    // Parse a single statement, compound-stmt, declaration or expression
+    // starting at token first of the parser's token buffer, adding its
+    // nodes to this parser's arena (used for incremental reparsing).
+    // Returns nullptr on a syntax error; end receives the index of the
+    // first token not consumed.
+    ParseTreeNode* parseFragment(RuleId rule, size_t first, size_t& end);
+
+    // Check that token first of the buffer is expected, reporting the
+    // error a parse would if it is not (the token after a reparsed list)
+    bool matchFragment(TokenType expected, size_t first);
+
+    // Empty ' node or epsilon in this parser's arena, for relinking a list
+    // whose elements were reparsed with parseFragment()
+    ParseTreeNode* newListNode(RuleId primeRule) { return newNonTerminal(primeRule); }
+    ParseTreeNode* newEmptyNode() { return newEpsilon(); }
+
     bool hadError() const { return hasError; }
+    // The parser's own scanner, nullptr when parsing a TokenBuffer
+    Lexer* getLexer() { return lexer.get(); }
     std::string getErrorMessage() const { return errorMessage; }
+    // First lexical error in the input of parse(data, size), empty if none
+    const std::string& getLexicalError() const { return ownTokens.errorMessage(); }
+    // Every error reported, the first one being getErrorMessage()
+    const std::vector<Diagnostic>& getDiagnostics() const { return diagnostics; }
+    // Whether parsing stopped early because maxErrors was reached
+    bool reachedErrorLimit() const { return diagnostics.size() >= options.maxErrors; }
+    // Bytes of node memory allocated so far, including discarded fragments
+    size_t treeBytes() const { return arena.bytesUsed(); }
+    // Interned lexemes of the tree's terminals, needed to print their labels
+    const StringInterner& getSymbols() const { return symbols; }
+    // Profiling counters for --stats (see Stats.h); all zero unless the
+    // build has CMINUS_STATS
+    const ParserCounters& getCounters() const { return counters; }
 };
 
 #endif /* PARSER_H */
@@ -0,0 +1,208 @@
+#include "Scan.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+namespace {
+
+/* ---- Scalar kernels ---- */
+
+// Scalar count over text[start, length), reporting absolute indices
+size_t countNewlinesTail(const char* text, size_t start, size_t length, size_t* lastNewline) {
+    size_t count = 0;
+    for (size_t i = start; i < length; i++) {
+        if (text[i] == '\n') {
+            count++;
+            *lastNewline = i;
+        }
+    }
+    return count;
+}
+
+size_t countNewlinesScalar(const char* text, size_t length, size_t* lastNewline) {
+    return countNewlinesTail(text, 0, length, lastNewline);
+}
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+const char* skipWhitespaceScalar(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+const char* findCommentEndScalar(const char* p, const char* end) {
+    for (; p + 1 < end; p++) {
+        if (p[0] == '*' && p[1] == '/') {
+            return p;
+        }
+    }
+    return end;
+}
+
+#ifdef SCAN_X86
+
+/* ---- SSE2 kernels (16 bytes per step) ---- */
+
+size_t countNewlinesSse2(const char* text, size_t length, size_t* lastNewline) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+        if (mask) {
+            count += __builtin_popcount(mask);
+            *lastNewline = i + 31 - __builtin_clz(mask);
+        }
+    }
+    return count + countNewlinesTail(text, i, length, lastNewline);
+}
+
+__m128i spaceMaskSse2(__m128i chunk) {
+    __m128i m = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')));
+    return _mm_or_si128(m, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+}
+
+const char* skipWhitespaceSse2(const char* p, const char* end) {
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned other = ~static_cast<unsigned>(_mm_movemask_epi8(spaceMaskSse2(chunk))) & 0xFFFFu;
+        if (other) {
+            return p + __builtin_ctz(other);
+        }
+        p += 16;
+    }
+    return skipWhitespaceScalar(p, end);
+}
+
+const char* findCommentEndSse2(const char* p, const char* end) {
+    const __m128i star = _mm_set1_epi8('*');
+    const __m128i slash = _mm_set1_epi8('/');
+    // Compare p[i] with '*' and p[i + 1] with '/' for 16 positions at once
+    while (end - p >= 17) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, star), _mm_cmpeq_epi8(b, slash))));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return findCommentEndScalar(p, end);
+}
+
+/* ---- AVX2 kernels (32 bytes per step) ---- */
+
+__attribute__((target("avx2,popcnt")))
+size_t countNewlinesAvx2(const char* text, size_t length, size_t* lastNewline) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline)));
+        if (mask) {
+            count += __builtin_popcount(mask);
+            *lastNewline = i + 31 - __builtin_clz(mask);
+        }
+    }
+    return count + countNewlinesTail(text, i, length, lastNewline);
+}
+
+__attribute__((target("avx2,popcnt")))
+const char* skipWhitespaceAvx2(const char* p, const char* end) {
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i m = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' '));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')));
+        unsigned other = ~static_cast<unsigned>(_mm256_movemask_epi8(m));
+        if (other) {
+            return p + __builtin_ctz(other);
+        }
+        p += 32;
+    }
+    return skipWhitespaceSse2(p, end);
+}
+
+__attribute__((target("avx2,popcnt")))
+const char* findCommentEndAvx2(const char* p, const char* end) {
+    const __m256i star = _mm256_set1_epi8('*');
+    const __m256i slash = _mm256_set1_epi8('/');
+    while (end - p >= 33) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, star), _mm256_cmpeq_epi8(b, slash))));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return findCommentEndSse2(p, end);
+}
+
+#endif /* SCAN_X86 */
+
+struct Kernels {
+    const char* name;
+    size_t (*countNewlines)(const char*, size_t, size_t*);
+    const char* (*skipWhitespace)(const char*, const char*);
+    const char* (*findCommentEnd)(const char*, const char*);
+};
+
+Kernels selectKernels() {
+    const Kernels scalar = { "scalar", countNewlinesScalar, skipWhitespaceScalar, findCommentEndScalar };
+#ifdef SCAN_X86
+    const Kernels sse2 = { "sse2", countNewlinesSse2, skipWhitespaceSse2, findCommentEndSse2 };
+    const Kernels avx2 = { "avx2", countNewlinesAvx2, skipWhitespaceAvx2, findCommentEndAvx2 };
+
+    __builtin_cpu_init();
+    bool hasAvx2 = __builtin_cpu_supports("avx2");
+
+    const char* forced = getenv("CMINUS_SCAN_KERNEL");
+    if (forced) {
+        if (strcmp(forced, "scalar") == 0) return scalar;
+        if (strcmp(forced, "sse2") == 0) return sse2;
+    }
+    return hasAvx2 ? avx2 : sse2;
+#else
+    return scalar;
+#endif
+}
+
+// Resolved once, on first use (thread-safe static initialization)
+const Kernels& kernels() {
+    static const Kernels selected = selectKernels();
+    return selected;
+}
+
+} // namespace
+
+extern "C" size_t scan_count_newlines(const char* text, size_t length, size_t* last_newline) {
+    return kernels().countNewlines(text, length, last_newline);
+}
+
+extern "C" const char* scan_skip_whitespace(const char* p, const char* end) {
+    return kernels().skipWhitespace(p, end);
+}
+
+extern "C" const char* scan_find_comment_end(const char* p, const char* end) {
+    return kernels().findCommentEnd(p, end);
+}
+
+extern "C" const char* scan_kernel_name(void) {
+    return kernels().name;
+}
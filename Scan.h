@@ -0,0 +1,35 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+/*
+ * Vectorized scanning kernels used by the lexers for whitespace, comments
+ * and newline counting. The best implementation for the running CPU (AVX2,
+ * SSE2 or scalar) is picked once at first use; the environment variable
+ * CMINUS_SCAN_KERNEL=avx2|sse2|scalar forces a specific one.
+ * All kernels produce identical results.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Count '\n' bytes in text[0, length). If there is at least one, store the
+   index of the last one in *last_newline. */
+size_t scan_count_newlines(const char* text, size_t length, size_t* last_newline);
+
+/* First byte in [p, end) that is not ' ', '\t', '\r' or '\n' (end if none) */
+const char* scan_skip_whitespace(const char* p, const char* end);
+
+/* First "*" of the first "*" "/" pair in [p, end) (end if none) */
+const char* scan_find_comment_end(const char* p, const char* end);
+
+/* Name of the selected kernel set: "avx2", "sse2" or "scalar" */
+const char* scan_kernel_name(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCAN_H */
@@ -0,0 +1,223 @@
+#include "Semantic.h"
+#include <sstream>
+
+using namespace std;
+
+void SymbolTable::reserve(size_t n) {
+    size_t capacity = MIN_CAPACITY;
+    while (capacity < n * 2) {
+        capacity *= 2;
+    }
+    if (capacity > slots.size()) {
+        rehash(capacity);
+    }
+}
+
+void SymbolTable::clear() {
+    for (SymbolInfo& entry : slots) {
+        entry.symbol = EMPTY;
+    }
+    count = 0;
+}
+
+void SymbolTable::rehash(size_t capacity) {
+    vector<SymbolInfo> old;
+    old.swap(slots);
+    slots.assign(capacity, SymbolInfo{EMPTY, TYPE_INT, 0, 0});
+    shift = 32;
+    for (size_t size = capacity; size > 1; size /= 2) {
+        shift--;
+    }
+    size_t mask = capacity - 1;
+    for (const SymbolInfo& entry : old) {
+        if (entry.symbol != EMPTY) {
+            size_t i = slot(entry.symbol);
+            while (slots[i].symbol != EMPTY) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = entry;
+        }
+    }
+}
+
+SymbolInfo& SymbolTable::insert(uint32_t symbol, bool& inserted) {
+    if ((count + 1) * 2 > slots.size()) {
+        rehash(slots.empty() ? MIN_CAPACITY : slots.size() * 2);
+    }
+    size_t mask = slots.size() - 1;
+    size_t i = slot(symbol);
+    while (slots[i].symbol != EMPTY) {
+        if (slots[i].symbol == symbol) {
+            inserted = false;
+            return slots[i];
+        }
+        i = (i + 1) & mask;
+    }
+    count++;
+    inserted = true;
+    slots[i].symbol = symbol;
+    return slots[i];
+}
+
+// Value of an integer literal; false for a float literal or one that does
+// not fit in 32 bits
+static bool integerValue(string_view text, uint32_t& value) {
+    uint64_t result = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        result = result * 10 + (c - '0');
+        if (result > UINT32_MAX) {
+            return false;
+        }
+    }
+    value = static_cast<uint32_t>(result);
+    return !text.empty();
+}
+
+string SemanticChecker::name(uint32_t symbol) const {
+    string text = "'";
+    text += symbols->str(symbol);
+    text += "'";
+    return text;
+}
+
+void SemanticChecker::report(uint32_t token, const string& message) {
+    Diagnostic d;
+    d.line = 0;
+    d.col = 0;
+    ostringstream oss;
+    oss << "SEMANTIC ERROR";
+    if (tokens && token < tokens->size()) {
+        tokens->position(token, d.line, d.col);
+        oss << " at Line " << d.line << ", Col " << d.col;
+    }
+    oss << ": " << message;
+    d.message = oss.str();
+    diagnostics.push_back(d);
+}
+
+// var-declaration ::= type-specifier ID var-declaration'. The nodes are at
+// fixed offsets: the type keyword at node + 2, the ID at node + 3 and
+// var-declaration' at node + 4, holding ";" or "[" NUM "]" ";". token is
+// the index of the type keyword.
+void SemanticChecker::declare(const FlatTree& tree, uint32_t node, uint32_t token) {
+    uint32_t id = node + 3;
+    uint32_t symbol = tree.symbol(id);
+    bool inserted;
+    SymbolInfo& entry = table.insert(symbol, inserted);
+    if (!inserted) {
+        string message = name(symbol) + " is already declared";
+        if (tokens) {
+            long long line, col;
+            tokens->position(entry.token, line, col);
+            message += " at Line " + to_string(line);
+        }
+        report(token + 1, message);
+        return;
+    }
+    entry.type = tree.token(node + 2) == FLOAT ? TYPE_FLOAT : TYPE_INT;
+    entry.arraySize = 0;
+    entry.token = token + 1;
+
+    uint32_t bracket = node + 5;
+    if (tree.token(bracket) == LBRACKET) {
+        uint32_t size = 0;
+        if (!integerValue(symbols->str(tree.symbol(bracket + 1)), size) || size == 0) {
+            report(token + 3, "size of array " + name(symbol) + " must be a positive integer, not " +
+                                  string(symbols->str(tree.symbol(bracket + 1))));
+            // Still an array, so its uses are checked as such
+            size = UINT32_MAX;
+        }
+        entry.arraySize = size;
+    }
+}
+
+// var ::= ID var', var' ::= empty | "[" expression "]". token is the index
+// of the ID.
+void SemanticChecker::resolve(const FlatTree& tree, uint32_t node, uint32_t token) {
+    useCount++;
+    uint32_t id = node + 1;
+    uint32_t symbol = tree.symbol(id);
+    const SymbolInfo* entry = table.find(symbol);
+    if (!entry) {
+        report(token, name(symbol) + " is not declared");
+        return;
+    }
+
+    uint32_t prime = tree.subtreeEnd(id);
+    bool indexed = tree.kind(prime + 1) == NODE_TERMINAL;
+    if (!indexed) {
+        if (entry->arraySize != 0) {
+            report(token, "array " + name(symbol) + " is used without an index");
+        }
+        return;
+    }
+    if (entry->arraySize == 0) {
+        report(token, name(symbol) + " is not an array");
+        return;
+    }
+
+    // A constant index is an expression whose only terminal is a NUM. The
+    // scan stops at the second terminal, so it stays short for any index.
+    uint32_t expression = prime + 2;
+    uint32_t end = tree.subtreeEnd(expression);
+    uint32_t literal = FlatTree::NO_NODE;
+    for (uint32_t i = expression; i < end; i++) {
+        if (tree.kind(i) == NODE_TERMINAL) {
+            if (literal != FlatTree::NO_NODE) {
+                return;
+            }
+            literal = i;
+        }
+    }
+    if (literal == FlatTree::NO_NODE || tree.token(literal) != NUM) {
+        return;
+    }
+    string_view text = symbols->str(tree.symbol(literal));
+    uint32_t index = 0;
+    if (!integerValue(text, index)) {
+        report(token + 2, "index " + string(text) + " of " + name(symbol) + " is not an integer");
+    } else if (entry->arraySize != UINT32_MAX && index >= entry->arraySize) {
+        report(token + 2, "index " + string(text) + " is out of bounds for array " + name(symbol) + " of size " +
+                              to_string(entry->arraySize));
+    }
+}
+
+bool SemanticChecker::check(const FlatTree& tree, const StringInterner& symbolTable,
+                            const TokenBuffer* tokenBuffer) {
+    symbols = &symbolTable;
+    tokens = tokenBuffer;
+    table.clear();
+    diagnostics.clear();
+    useCount = 0;
+
+    // Terminals in preorder are the tokens in order, so counting them
+    // gives the token index of each node
+    uint32_t token = 0;
+    for (uint32_t i = 0; i < tree.size(); i++) {
+        NodeKind kind = tree.kind(i);
+        if (kind == NODE_TERMINAL) {
+            token++;
+        } else if (kind == NODE_NONTERMINAL) {
+            if (tree.rule(i) == RULE_VAR_DECLARATION) {
+                declare(tree, i, token);
+            } else if (tree.rule(i) == RULE_VAR) {
+                resolve(tree, i, token);
+            }
+        }
+    }
+    return diagnostics.empty();
+}
+
+bool SemanticChecker::check(const ParseTreeNode* root, const StringInterner& symbolTable,
+                            const TokenBuffer* tokenBuffer) {
+    if (!flat.build(root)) {
+        diagnostics.clear();
+        Diagnostic d{0, 0, "SEMANTIC ERROR: tree too large to check"};
+        diagnostics.push_back(d);
+        return false;
+    }
+    return check(flat, symbolTable, tokenBuffer);
+}
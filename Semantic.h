@@ -0,0 +1,129 @@
+#ifndef SEMANTIC_H
+#define SEMANTIC_H
+
+#include "FlatTree.h"
+#include "Parser.h"
+#include "StringInterner.h"
+#include "TokenBuffer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum ValueType : uint8_t {
+    TYPE_INT,
+    TYPE_FLOAT
+};
+
+// A declared variable
+struct SymbolInfo {
+    uint32_t symbol;        // Interned identifier; SymbolTable::EMPTY in a free slot
+    ValueType type;
+    uint32_t arraySize;     // Elements, 0 for a scalar
+    uint32_t token;         // Token index of the declaring ID
+};
+
+/*
+ * Declared variables keyed by interned identifier ID, in one flat array
+ * with open addressing and linear probing. The IDs are small dense
+ * integers, so a multiplicative hash spreads them evenly, and the table
+ * doubles before it is half full: a lookup touches one or two adjacent
+ * slots and an entry costs no allocation of its own.
+ */
+class SymbolTable {
+public:
+    static const uint32_t EMPTY = UINT32_MAX;
+
+    SymbolTable() : count(0), shift(32) {}
+
+    // Room for n entries without rehashing
+    void reserve(size_t n);
+
+    // Forget every entry but keep the slots
+    void clear();
+
+    // The entry for symbol, added (with inserted set) if it was not there
+    SymbolInfo& insert(uint32_t symbol, bool& inserted);
+
+    const SymbolInfo* find(uint32_t symbol) const {
+        if (count == 0) {
+            return nullptr;
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t i = slot(symbol);; i = (i + 1) & mask) {
+            const SymbolInfo& entry = slots[i];
+            if (entry.symbol == symbol) {
+                return &entry;
+            }
+            if (entry.symbol == EMPTY) {
+                return nullptr;
+            }
+        }
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return slots.size(); }
+    size_t bytesUsed() const { return slots.capacity() * sizeof(SymbolInfo); }
+
+private:
+    static const size_t MIN_CAPACITY = 64;
+
+    std::vector<SymbolInfo> slots;  // Power-of-two count
+    size_t count;
+    unsigned shift;                 // 32 - log2(slots.size())
+
+    size_t slot(uint32_t symbol) const { return static_cast<uint32_t>(symbol * 0x9E3779B1u) >> shift; }
+    void rehash(size_t capacity);
+};
+
+/*
+ * Declaration checking over the tree of a successful parse.
+ *
+ * One preorder scan of the flattened tree: every var-declaration enters
+ * its ID with its type and array size into the symbol table, and every var
+ * (assignment targets and operands alike) is resolved by one lookup.
+ * Declarations precede the statements in a program, so the scan never
+ * sees a use before the table is complete. All errors are collected, in
+ * source order:
+ *
+ * - a variable declared twice
+ * - an array size that is not a positive integer literal
+ * - a use of an undeclared variable
+ * - an array used without an index, or a scalar indexed
+ * - a constant index that is not an integer or lies outside the array
+ *
+ * Terminals in preorder are the program's tokens in order, so given the
+ * token buffer the tree was parsed from, each error gets its line and
+ * column. The checker keeps its table and flat tree between runs.
+ */
+class SemanticChecker {
+public:
+    SemanticChecker() : symbols(nullptr), tokens(nullptr), useCount(0) {}
+
+    // Check a parse tree; false if any error was found
+    bool check(const ParseTreeNode* root, const StringInterner& symbolTable,
+               const TokenBuffer* tokenBuffer = nullptr);
+    bool check(const FlatTree& tree, const StringInterner& symbolTable, const TokenBuffer* tokenBuffer = nullptr);
+
+    // Every error found, "SEMANTIC ERROR at Line <line>, Col <col>: ..."
+    // (or without the position when no token buffer was given)
+    const std::vector<Diagnostic>& getDiagnostics() const { return diagnostics; }
+
+    const SymbolTable& getSymbolTable() const { return table; }
+    size_t declarations() const { return table.size(); }
+    size_t uses() const { return useCount; }
+
+private:
+    SymbolTable table;
+    FlatTree flat;
+    std::vector<Diagnostic> diagnostics;
+    const StringInterner* symbols;
+    const TokenBuffer* tokens;
+    size_t useCount;
+
+    void declare(const FlatTree& tree, uint32_t node, uint32_t token);
+    void resolve(const FlatTree& tree, uint32_t node, uint32_t token);
+    void report(uint32_t token, const std::string& message);
+    std::string name(uint32_t symbol) const;
+};
+
+#endif /* SEMANTIC_H */
@@ -0,0 +1,333 @@
+#include "Server.h"
+#include "Parser.h"
+#include "ThreadPool.h"
+#include "TreeFile.h"
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Read exactly size bytes. Returns the bytes read, which is less than size
+// only at end of input or on an error.
+static size_t readFully(int fd, void* buffer, size_t size) {
+    char* p = static_cast<char*>(buffer);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, p + done, size - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return done;
+}
+
+static bool writeFully(int fd, const void* buffer, size_t size) {
+    const char* p = static_cast<const char*>(buffer);
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/* One request stream: responses from all workers share its output */
+struct Connection {
+    int in;
+    int out;
+    bool ownsFds;           // Socket connections are closed with the last job
+    mutex writeLock;
+
+    Connection(int input, int output, bool owns) : in(input), out(output), ownsFds(owns) {}
+    ~Connection() {
+        if (ownsFds) {
+            close(in);
+        }
+    }
+
+    // Send one response: header, diagnostics, tree
+    void respond(uint32_t id, ServerStatus status, const string& diagnostics, const string& tree) {
+        ServerResponse header;
+        header.magic = SERVER_RESPONSE_MAGIC;
+        header.id = id;
+        header.status = status;
+        header.diagnosticsSize = static_cast<uint32_t>(diagnostics.size());
+        header.treeSize = static_cast<uint32_t>(tree.size());
+
+        // A peer that went away is noticed by its reader; writes just fail
+        lock_guard<mutex> guard(writeLock);
+        writeFully(out, &header, sizeof(header)) && writeFully(out, diagnostics.data(), diagnostics.size()) &&
+            writeFully(out, tree.data(), tree.size());
+    }
+};
+
+struct Job {
+    shared_ptr<Connection> connection;
+    ServerRequest request;
+    string source;
+};
+
+/*
+ * Workers, each with its own Parser kept warm across requests, taking jobs
+ * from one queue. (WorkStealingPool runs fixed batches; requests arrive one
+ * at a time.)
+ *
+ * The queue is bounded: submit() blocks while it holds QUEUED_PER_WORKER
+ * jobs per worker or MAX_QUEUED_BYTES of source (an empty queue always
+ * takes a job). A client sending faster than the workers parse then
+ * stalls in its reader, and the pipe or socket pushes back on it instead
+ * of the server buffering every pending source.
+ */
+class ServerPool {
+public:
+    static const size_t QUEUED_PER_WORKER = 4;
+    static const size_t MAX_QUEUED_BYTES = 64u << 20;
+
+    ServerPool(unsigned jobs, LexerBackend lexerBackend)
+        : backend(lexerBackend), maxQueued(0), queuedBytes(0), closed(false) {
+        unsigned count = jobs > 0 ? jobs : WorkStealingPool::hardwareThreads();
+        maxQueued = count * QUEUED_PER_WORKER;
+        for (unsigned i = 0; i < count; i++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ServerPool() {
+        {
+            lock_guard<mutex> guard(lock);
+            closed = true;
+        }
+        ready.notify_all();
+        for (thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Queue a job, waiting for room
+    void submit(Job&& job) {
+        {
+            unique_lock<mutex> guard(lock);
+            size_t bytes = job.source.size();
+            space.wait(guard, [&] {
+                return queue.empty() || (queue.size() < maxQueued && queuedBytes + bytes <= MAX_QUEUED_BYTES);
+            });
+            queuedBytes += bytes;
+            queue.push_back(move(job));
+        }
+        ready.notify_one();
+    }
+
+private:
+    LexerBackend backend;
+    mutex lock;
+    condition_variable ready;       // A job was queued, or the pool is closing
+    condition_variable space;       // A job was taken
+    deque<Job> queue;
+    size_t maxQueued;
+    size_t queuedBytes;
+    bool closed;
+    vector<thread> workers;
+
+    void workerLoop() {
+        Parser parser;
+        string diagnostics;
+        string tree;
+        for (;;) {
+            Job job;
+            {
+                unique_lock<mutex> guard(lock);
+                ready.wait(guard, [this] { return closed || !queue.empty(); });
+                if (queue.empty()) {
+                    return;
+                }
+                job = move(queue.front());
+                queue.pop_front();
+                queuedBytes -= job.source.size();
+            }
+            space.notify_all();
+            handle(parser, job, diagnostics, tree);
+        }
+    }
+
+    void handle(Parser& parser, Job& job, string& diagnostics, string& tree) {
+        const ServerRequest& request = job.request;
+        diagnostics.clear();
+        tree.clear();
+
+        ParserOptions options;
+        options.lexerBackend = backend;
+        options.flattenLists = (request.flags & SERVER_FLAT_LISTS) != 0;
+        options.tableDriven = (request.flags & SERVER_TABLE_DRIVEN) != 0;
+        options.maxErrors = request.maxErrors > 0 ? request.maxErrors : 1;
+        uint32_t known = SERVER_FLAT_LISTS | SERVER_TABLE_DRIVEN | SERVER_SEND_TREE;
+        if ((request.flags & ~known) != 0 || (options.tableDriven && options.maxErrors > 1)) {
+            diagnostics = "Unknown flags, or table-driven parsing with error recovery\n";
+            job.connection->respond(request.id, SERVER_BAD_REQUEST, diagnostics, tree);
+            return;
+        }
+
+        parser.reset(options);
+        // Without SERVER_SEND_TREE nothing is built, only the verdict
+        ParseTreeNode* root = nullptr;
+        bool valid;
+        if (request.flags & SERVER_SEND_TREE) {
+            root = parser.parse(job.source.data(), job.source.size());
+            valid = root && !parser.hadError();
+        } else {
+            valid = parser.check(job.source.data(), job.source.size());
+        }
+        if (!valid) {
+            if (!parser.getLexicalError().empty()) {
+                diagnostics += parser.getLexicalError();
+                diagnostics += '\n';
+            }
+            for (const Diagnostic& d : parser.getDiagnostics()) {
+                diagnostics += d.message;
+                diagnostics += '\n';
+            }
+            if (parser.getDiagnostics().empty()) {
+                diagnostics += parser.getErrorMessage();
+                diagnostics += '\n';
+            }
+        }
+        if (root) {
+            serializeTree(root, parser.getSymbols(), tree, options.flattenLists ? TREE_FILE_FLAT_LISTS : 0);
+        }
+        job.connection->respond(request.id, valid ? SERVER_OK : SERVER_SYNTAX_ERROR, diagnostics, tree);
+    }
+};
+
+// Read requests from a connection and queue them until its input ends.
+// Returns false if the stream was not framed as requests.
+static bool readRequests(const shared_ptr<Connection>& connection, ServerPool& pool) {
+    for (;;) {
+        ServerRequest request;
+        size_t n = readFully(connection->in, &request, sizeof(request));
+        if (n == 0) {
+            return true;
+        }
+        if (n < sizeof(request) || request.magic != SERVER_REQUEST_MAGIC ||
+            request.sourceSize > SERVER_MAX_SOURCE) {
+            // Framing is lost; report it once and drop the stream
+            uint32_t id = n == sizeof(request) ? request.id : 0;
+            connection->respond(id, SERVER_BAD_REQUEST, "Malformed request header\n", string());
+            return false;
+        }
+
+        Job job;
+        job.connection = connection;
+        job.request = request;
+        job.source.resize(request.sourceSize);
+        if (readFully(connection->in, &job.source[0], request.sourceSize) < request.sourceSize) {
+            return false;
+        }
+        pool.submit(move(job));
+    }
+}
+
+int serveStream(int in, int out, unsigned jobs, LexerBackend backend) {
+    // A client that goes away must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+    bool ok;
+    {
+        ServerPool pool(jobs, backend);
+        ok = readRequests(make_shared<Connection>(in, out, false), pool);
+        // Leaving the scope finishes the queued requests
+    }
+    return ok ? 0 : 1;
+}
+
+int serveSocket(const string& path, unsigned jobs, LexerBackend backend) {
+    signal(SIGPIPE, SIG_IGN);
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: Socket path '%s' is too long\n", path.c_str());
+        return 1;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+        fprintf(stderr, "Error: Cannot listen on '%s': %s\n", path.c_str(), strerror(errno));
+        if (listener >= 0) {
+            close(listener);
+        }
+        return 1;
+    }
+
+    // One reader thread per connection; the workers are shared. Readers are
+    // joined (finished ones at each accept, all of them before returning),
+    // so none outlives the pool it submits to.
+    struct Reader {
+        shared_ptr<Connection> connection;
+        shared_ptr<atomic<bool>> finished;
+        thread reader;
+    };
+    ServerPool pool(jobs, backend);
+    vector<Reader> readers;
+    for (;;) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            fprintf(stderr, "Error: accept failed: %s\n", strerror(errno));
+            close(listener);
+            // End the input of every open connection so its reader returns
+            for (Reader& r : readers) {
+                shutdown(r.connection->in, SHUT_RD);
+            }
+            for (Reader& r : readers) {
+                r.reader.join();
+            }
+            return 1;
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < readers.size(); i++) {
+            if (readers[i].finished->load()) {
+                readers[i].reader.join();
+            } else if (kept++ != i) {
+                readers[kept - 1] = move(readers[i]);
+            }
+        }
+        readers.resize(kept);
+
+        Reader r;
+        r.connection = make_shared<Connection>(fd, fd, true);
+        r.finished = make_shared<atomic<bool>>(false);
+        shared_ptr<Connection> connection = r.connection;
+        shared_ptr<atomic<bool>> finished = r.finished;
+        r.reader = thread([connection, finished, &pool] {
+            readRequests(connection, pool);
+            finished->store(true);
+        });
+        readers.push_back(move(r));
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "Lexer.h"
+#include <cstdint>
+#include <string>
+
+/*
+ * Parse server (--serve, --socket): a long-running process that answers
+ * parse requests framed on stdin/stdout or on the connections of a local
+ * Unix socket, so a caller checking many small inputs pays for process
+ * startup once.
+ *
+ * Each message is a fixed header followed by its payload, all integers in
+ * host byte order (the peer is on the same machine):
+ *
+ *   request:  ServerRequest, then sourceSize bytes of C- source
+ *   response: ServerResponse, then diagnosticsSize bytes of diagnostics
+ *             (one message per line), then treeSize bytes holding the tree
+ *             in the .ptree format (TreeFile.h)
+ *
+ * Requests are parsed concurrently by a pool of workers, each reusing one
+ * Parser, so the responses on one stream can come back out of order; the
+ * id pairs each response with its request.
+ */
+
+static const uint32_t SERVER_REQUEST_MAGIC = 0x51524d43;    // "CMRQ" in little-endian memory
+static const uint32_t SERVER_RESPONSE_MAGIC = 0x53524d43;   // "CMRS"
+
+// Largest source text accepted in one request
+static const uint32_t SERVER_MAX_SOURCE = 256u << 20;
+
+// Request flags
+static const uint32_t SERVER_FLAT_LISTS = 1;      // As --flat-lists
+static const uint32_t SERVER_TABLE_DRIVEN = 2;    // As --ll1
+static const uint32_t SERVER_SEND_TREE = 4;       // Return the tree (also partial trees after recovery)
+
+// Response status
+enum ServerStatus : uint32_t {
+    SERVER_OK = 0,
+    SERVER_SYNTAX_ERROR = 1,    // Diagnostics say why
+    SERVER_BAD_REQUEST = 2,     // Unknown flags or options that cannot be combined
+};
+
+struct ServerRequest {
+    uint32_t magic;
+    uint32_t id;            // Echoed in the response
+    uint32_t flags;
+    uint32_t maxErrors;     // As --max-errors; 0 means 1
+    uint32_t sourceSize;
+};
+
+struct ServerResponse {
+    uint32_t magic;
+    uint32_t id;
+    uint32_t status;        // ServerStatus
+    uint32_t diagnosticsSize;
+    uint32_t treeSize;
+};
+
+static_assert(sizeof(ServerRequest) == 20, "ServerRequest layout changed");
+static_assert(sizeof(ServerResponse) == 20, "ServerResponse layout changed");
+
+// Serve the requests read from in until end of input, writing responses to
+// out. jobs == 0 starts one worker per hardware thread. Returns the process
+// exit code: 0, or 1 if the input ended inside a request or was not framed
+// as requests.
+int serveStream(int in, int out, unsigned jobs, LexerBackend backend);
+
+// Listen on a Unix socket at path (replacing any socket file there) and
+// serve every connection as a stream. Only returns, with 1, if the socket
+// cannot be set up.
+int serveSocket(const std::string& path, unsigned jobs, LexerBackend backend);
+
+#endif /* SERVER_H */
@@ -0,0 +1,229 @@
+#include "Stats.h"
+
+#ifdef CMINUS_STATS
+
+#include "Parser.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <sys/resource.h>
+
+using namespace std;
+
+/*
+ * Counting allocator hook: every operator new of the process (standard
+ * containers, strings, the parser objects) goes through here, and the
+ * malloc'd buffers report themselves through STATS_ALLOCATION. Counters
+ * are atomic because batch mode allocates from several threads.
+ */
+namespace {
+
+atomic<uint64_t> allocationCount(0);
+atomic<uint64_t> allocationBytes(0);
+
+// TokenType identifiers, from IF
+const char* const TOKEN_TYPE_NAMES[TOKEN_TYPE_COUNT] = {
+    "IF", "ELSE", "WHILE", "INT", "FLOAT", "RETURN", "VOID", "PROGRAM",
+    "ID", "NUM",
+    "PLUS", "MINUS", "TIMES", "DIVIDE", "LT", "LTE", "GT", "GTE", "EQ", "NEQ", "ASSIGN",
+    "SEMI", "COMMA", "LPAREN", "RPAREN", "LBRACKET", "RBRACKET", "LBRACE", "RBRACE", "DOT",
+    "ENDOFFILE", "ERROR",
+};
+
+const char* const PHASE_NAMES[PHASE_COUNT] = {"open", "lex", "parse", "ids", "output"};
+
+double milliseconds(double seconds) {
+    return seconds * 1000;
+}
+
+}  // namespace
+
+void countAllocation(size_t bytes) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    allocationBytes.fetch_add(bytes, memory_order_relaxed);
+}
+
+void* operator new(size_t size) {
+    countAllocation(size);
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+static_assert(RULE_COUNT <= 64 && AST_KIND_COUNT <= 64, "node counters too small");
+
+StatsReport::StatsReport()
+    : seconds(), tokens(), ruleNodes(), terminalNodes(0), epsilonNodes(0), errorNodes(0), astNodes(false),
+      maxDepth(0) {}
+
+void StatsReport::begin(StatsPhase phase) {
+    started[phase] = chrono::steady_clock::now();
+}
+
+void StatsReport::end(StatsPhase phase) {
+    seconds[phase] += chrono::duration<double>(chrono::steady_clock::now() - started[phase]).count();
+}
+
+void StatsReport::collect(const Parser& parser, const TokenBuffer* tokenBuffer, const ParseTreeNode* tree,
+                          const AstNode* ast) {
+    const ParserCounters& counters = parser.getCounters();
+    if (tokenBuffer) {
+        for (size_t i = 0; i < tokenBuffer->size(); i++) {
+            tokens[tokenBuffer->type(i) - IF]++;
+        }
+    } else {
+        // The scanner ran inside the parse: move its share to the lex phase
+        for (int i = 0; i < TOKEN_TYPE_COUNT; i++) {
+            tokens[i] = counters.tokens[i];
+        }
+        seconds[PHASE_LEX] += counters.lexSeconds;
+        seconds[PHASE_PARSE] -= counters.lexSeconds;
+    }
+    maxDepth = counters.maxDepth;
+
+    if (tree) {
+        vector<const ParseTreeNode*> stack(1, tree);
+        while (!stack.empty()) {
+            const ParseTreeNode* node = stack.back();
+            stack.pop_back();
+            switch (node->kind) {
+                case NODE_NONTERMINAL: ruleNodes[node->rule]++; break;
+                case NODE_TERMINAL:    terminalNodes++; break;
+                case NODE_EPSILON:     epsilonNodes++; break;
+                default:               errorNodes++; break;
+            }
+            for (const ParseTreeNode* child = node->firstChild; child; child = child->nextSibling) {
+                stack.push_back(child);
+            }
+        }
+    } else if (ast) {
+        astNodes = true;
+        vector<const AstNode*> stack(1, ast);
+        while (!stack.empty()) {
+            const AstNode* node = stack.back();
+            stack.pop_back();
+            ruleNodes[node->kind]++;
+            forEachAstChild(node, [&](const AstNode* child) { stack.push_back(child); });
+        }
+    }
+}
+
+void StatsReport::print(ostream& out, bool json) const {
+    size_t slots = astNodes ? static_cast<size_t>(AST_KIND_COUNT) : static_cast<size_t>(RULE_COUNT);
+    auto nodeName = [&](size_t i) {
+        return astNodes ? astKindName(static_cast<AstKind>(i)) : ruleName(static_cast<RuleId>(i));
+    };
+    uint64_t tokenTotal = 0;
+    for (int i = 0; i < TOKEN_TYPE_COUNT; i++) {
+        tokenTotal += tokens[i];
+    }
+    uint64_t nodeTotal = terminalNodes + epsilonNodes + errorNodes;
+    for (size_t i = 0; i < slots; i++) {
+        nodeTotal += ruleNodes[i];
+    }
+    // Read last, so they cover the output phase too
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    uint64_t allocations = allocationCount.load();
+    uint64_t bytes = allocationBytes.load();
+
+    char line[128];
+    if (!json) {
+        out << "\nStatistics\n";
+        out << "  Phase times (ms):\n";
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            if (p == PHASE_IDS) {
+                // The writers number nodes as they emit them
+                snprintf(line, sizeof(line), "    %-8s %12s\n", PHASE_NAMES[p], "(in output)");
+            } else {
+                snprintf(line, sizeof(line), "    %-8s %12.3f\n", PHASE_NAMES[p], milliseconds(seconds[p]));
+            }
+            out << line;
+        }
+        out << "  Tokens: " << tokenTotal << "\n";
+        for (int i = 0; i < TOKEN_TYPE_COUNT; i++) {
+            if (tokens[i]) {
+                snprintf(line, sizeof(line), "    %-28s %12llu\n", TOKEN_TYPE_NAMES[i],
+                         static_cast<unsigned long long>(tokens[i]));
+                out << line;
+            }
+        }
+        out << "  Nodes: " << nodeTotal << "\n";
+        for (size_t i = 0; i < slots; i++) {
+            if (ruleNodes[i]) {
+                snprintf(line, sizeof(line), "    %-28s %12llu\n", nodeName(i),
+                         static_cast<unsigned long long>(ruleNodes[i]));
+                out << line;
+            }
+        }
+        const char* const leafNames[] = {"(terminal)", "(epsilon)", "(error)"};
+        const uint64_t leafCounts[] = {terminalNodes, epsilonNodes, errorNodes};
+        for (int i = 0; i < 3; i++) {
+            if (leafCounts[i]) {
+                snprintf(line, sizeof(line), "    %-28s %12llu\n", leafNames[i],
+                         static_cast<unsigned long long>(leafCounts[i]));
+                out << line;
+            }
+        }
+        out << "  Max rule depth: " << maxDepth << "\n";
+        out << "  Allocations: " << allocations << " (" << bytes << " bytes)\n";
+        out << "  Peak RSS: " << usage.ru_maxrss << " KB\n";
+        return;
+    }
+
+    out << "{\"phases_ms\":{";
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        out << (p ? "," : "") << '"' << PHASE_NAMES[p] << "\":";
+        if (p == PHASE_IDS) {
+            out << "null";
+        } else {
+            snprintf(line, sizeof(line), "%.3f", milliseconds(seconds[p]));
+            out << line;
+        }
+    }
+    out << "},\"tokens\":{\"total\":" << tokenTotal << ",\"by_type\":{";
+    const char* separator = "";
+    for (int i = 0; i < TOKEN_TYPE_COUNT; i++) {
+        if (tokens[i]) {
+            out << separator << '"' << TOKEN_TYPE_NAMES[i] << "\":" << tokens[i];
+            separator = ",";
+        }
+    }
+    out << "}},\"nodes\":{\"total\":" << nodeTotal << ",\"by_rule\":{";
+    separator = "";
+    for (size_t i = 0; i < slots; i++) {
+        if (ruleNodes[i]) {
+            out << separator << '"' << nodeName(i) << "\":" << ruleNodes[i];
+            separator = ",";
+        }
+    }
+    out << "},\"terminal\":" << terminalNodes << ",\"epsilon\":" << epsilonNodes << ",\"error\":" << errorNodes
+        << "},\"max_rule_depth\":" << maxDepth << ",\"allocations\":{\"count\":" << allocations
+        << ",\"bytes\":" << bytes << "},\"peak_rss_kb\":" << usage.ru_maxrss << "}\n";
+}
+
+#endif /* CMINUS_STATS */
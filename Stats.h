@@ -0,0 +1,157 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "token.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+/*
+ * Profiling counters reported by --stats.
+ *
+ * The counters inside the parser, the scanner loop and the allocators are
+ * compiled in only with -DCMINUS_STATS (make STATS=1). In other builds the
+ * STATS_* hooks expand to nothing, StatsReport is an empty class whose
+ * methods are no-ops, and --stats is rejected, so the default build pays
+ * nothing for any of it beyond the unused ParserCounters member.
+ */
+
+class Parser;
+class TokenBuffer;
+class ParseTreeNode;
+struct AstNode;
+
+/* Phases timed by --stats */
+enum StatsPhase {
+    PHASE_OPEN,     // Opening (or mapping) the input file
+    PHASE_LEX,      // Scanning, whether up front (--tokens) or inside the parse
+    PHASE_PARSE,    // Parsing, excluding the time spent in the scanner
+    PHASE_IDS,      // Tree ID assignment
+    PHASE_OUTPUT,   // Writing the .dot or .ptree file
+    PHASE_COUNT
+};
+
+const int TOKEN_TYPE_COUNT = ERROR - IF + 1;
+
+/* Counters a Parser keeps while parsing. Defined in every build, so the
+   layout of Parser (and of clients embedding it through CMinus.h) does not
+   depend on CMINUS_STATS; only the hooks that update them do. */
+struct ParserCounters {
+    uint64_t tokens[TOKEN_TYPE_COUNT];  // Tokens read, by type (from IF)
+    unsigned depth;                     // Rule functions currently active
+    unsigned maxDepth;
+    double lexSeconds;                  // Time inside the parser's own scanner
+
+    ParserCounters() : tokens(), depth(0), maxDepth(0), lexSeconds(0) {}
+};
+
+#ifdef CMINUS_STATS
+
+// Tracks the rule nesting depth for the lifetime of one rule function
+class RuleDepthGuard {
+public:
+    explicit RuleDepthGuard(ParserCounters& c) : counters(c) {
+        if (++counters.depth > counters.maxDepth) {
+            counters.maxDepth = counters.depth;
+        }
+    }
+    ~RuleDepthGuard() { counters.depth--; }
+
+private:
+    ParserCounters& counters;
+};
+
+// Adds the time until the end of the enclosing scope to seconds
+class ScopedSeconds {
+public:
+    explicit ScopedSeconds(double& s) : seconds(s), start(std::chrono::steady_clock::now()) {}
+    ~ScopedSeconds() {
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    double& seconds;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Record one allocation of bytes made outside operator new (malloc'd
+// buffers and arena blocks); operator new is counted by Stats.cpp itself
+void countAllocation(size_t bytes);
+
+#define STATS_RULE(counters) RuleDepthGuard statsRuleGuard(counters)
+#define STATS_TOKEN(counters, type) ((counters).tokens[(type) - IF]++)
+#define STATS_LEX_TIME(counters) ScopedSeconds statsLexTime((counters).lexSeconds)
+#define STATS_ALLOCATION(bytes) countAllocation(bytes)
+// The table-driven engine has no rule functions; its deepest parse stack
+// stands in for the rule depth
+#define STATS_STACK_DEPTH(counters, n) \
+    ((counters).maxDepth = std::max((counters).maxDepth, static_cast<unsigned>(n)))
+
+/*
+ * Everything --stats prints for one run: phase times, token counts, node
+ * counts per rule (or AST kind), the parser's maximum rule depth, the
+ * process's allocations and its peak RSS.
+ */
+class StatsReport {
+public:
+    StatsReport();
+
+    void begin(StatsPhase phase);
+    void end(StatsPhase phase);
+
+    // Gather the counters once parsing is done. tokens is the token buffer
+    // with --tokens, nullptr when the parser scanned its own input; tree or
+    // ast is whichever was built (may be nullptr after an error).
+    void collect(const Parser& parser, const TokenBuffer* tokens, const ParseTreeNode* tree,
+                 const AstNode* ast);
+
+    // Human-readable table, or one JSON object
+    void print(std::ostream& out, bool json) const;
+
+private:
+    static const size_t NODE_SLOTS = 64;
+
+    double seconds[PHASE_COUNT];
+    std::chrono::steady_clock::time_point started[PHASE_COUNT];
+    uint64_t tokens[TOKEN_TYPE_COUNT];
+    uint64_t ruleNodes[NODE_SLOTS];    // Per RuleId, or per AstKind for an AST
+    uint64_t terminalNodes;
+    uint64_t epsilonNodes;
+    uint64_t errorNodes;
+    bool astNodes;              // ruleNodes counts AstKinds
+    unsigned maxDepth;
+    uint64_t allocations;
+    uint64_t allocatedBytes;
+    long peakRssKb;
+};
+
+#else
+
+#define STATS_RULE(counters) ((void)0)
+#define STATS_TOKEN(counters, type) ((void)0)
+#define STATS_LEX_TIME(counters) ((void)0)
+#define STATS_ALLOCATION(bytes) ((void)0)
+#define STATS_STACK_DEPTH(counters, n) ((void)0)
+
+class StatsReport {
+public:
+    void begin(StatsPhase) {}
+    void end(StatsPhase) {}
+    void collect(const Parser&, const TokenBuffer*, const ParseTreeNode*, const AstNode*) {}
+    void print(std::ostream&, bool) const {}
+};
+
+#endif /* CMINUS_STATS */
+
+// Whether this build can report --stats
+constexpr bool statsAvailable() {
+#ifdef CMINUS_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+#endif /* STATS_H */
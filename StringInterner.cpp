@@ -0,0 +1,55 @@
+#include "StringInterner.h"
+#include <algorithm>
+
+using namespace std;
+
+// FNV-1a; identifiers and numbers are short, so a byte loop is enough
+uint64_t StringInterner::hash(string_view str) {
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : str) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+uint32_t StringInterner::intern(string_view str) {
+    // Keep the table at most half full
+    if ((used + 1) * 2 > slots.size()) {
+        rehash(slots.empty() ? 256 : slots.size() * 2);
+    }
+
+    size_t mask = slots.size() - 1;
+    size_t i = static_cast<size_t>(hash(str)) & mask;
+    while (slots[i] != EMPTY_SLOT) {
+        if (strings[slots[i]] == str) {
+            return slots[i];
+        }
+        i = (i + 1) & mask;
+    }
+
+    uint32_t id = static_cast<uint32_t>(strings.size());
+    strings.push_back(string_view(storage.copyString(str.data(), str.size()), str.size()));
+    slots[i] = id;
+    used++;
+    return id;
+}
+
+void StringInterner::clear() {
+    storage.reset();
+    strings.clear();
+    fill(slots.begin(), slots.end(), EMPTY_SLOT);
+    used = 0;
+}
+
+void StringInterner::rehash(size_t capacity) {
+    slots.assign(capacity, EMPTY_SLOT);
+    size_t mask = capacity - 1;
+    for (uint32_t id = 0; id < strings.size(); id++) {
+        size_t i = static_cast<size_t>(hash(strings[id])) & mask;
+        while (slots[i] != EMPTY_SLOT) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = id;
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef STRINGINTERNER_H
+#define STRINGINTERNER_H
+
+#include "ParseTree.h"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/*
+ * Per-parse string interner.
+ *
+ * Every distinct string is stored once, in an arena owned by the interner,
+ * and identified by a dense 32-bit symbol ID (0, 1, 2, ... in order of first
+ * appearance). Lookups use an open-addressing hash table of IDs, so an ID
+ * costs four bytes wherever it is stored and two IDs are equal exactly when
+ * their strings are.
+ */
+class StringInterner {
+public:
+    StringInterner() : used(0) {}
+
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    // ID of str, adding it if it has not been seen before
+    uint32_t intern(std::string_view str);
+
+    // Text of an interned string; valid until the interner is destroyed
+    std::string_view str(uint32_t id) const { return strings[id]; }
+
+    size_t size() const { return strings.size(); }
+
+    // Forget every string (IDs start again from 0) but keep the memory
+    void clear();
+
+    // Bytes of string data held (each distinct string counted once)
+    size_t bytesUsed() const { return storage.bytesUsed(); }
+
+private:
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    NodeArena storage;
+    std::vector<std::string_view> strings;
+    std::vector<uint32_t> slots;    // Symbol IDs, EMPTY_SLOT when free
+    size_t used;
+
+    static uint64_t hash(std::string_view str);
+    void rehash(size_t capacity);
+};
+
+#endif /* STRINGINTERNER_H */
@@ -0,0 +1,95 @@
+// Table-driven LL(1) parsing: the Parser member that parses a program with
+// the predictive parse table tools/ll1_gen generates from
+// grammar_enhanced.ebnf (LL1Tables.h) and an explicit stack, instead of
+// the recursive descent functions in Parser.cpp. It builds the same tree,
+// flattened lists included, and reports the same first error.
+
+#include "Parser.h"
+#include "LL1Tables.h"
+
+using namespace std;
+
+// Error for a rule with no production for the lookahead: the message the
+// recursive descent parser reports for the rule. Only rules that must choose
+// between non-empty alternatives can fail here; the others have a default.
+static const char* tableError(RuleId rule) {
+    switch (rule) {
+        case RULE_VAR_DECLARATION_PRIME: return "Expected ';' or '[' in variable declaration";
+        case RULE_TYPE_SPECIFIER:        return "Expected 'int' or 'float'";
+        case RULE_PARAMS:                return "Expected parameter list or 'void'";
+        case RULE_STATEMENT:             return "Expected statement";
+        case RULE_RELOP:                 return "Expected relational operator";
+        case RULE_ADDOP:                 return "Expected '+' or '-'";
+        case RULE_MULOP:                 return "Expected '*' or '/'";
+        case RULE_FACTOR:                return "Expected '(', identifier, or number";
+        default:                         return "Unexpected token";
+    }
+}
+
+ParseTreeNode* Parser::parseTable() {
+    // A symbol still to be matched (TokenType) or expanded (RuleId), and
+    // the node its subtree goes under (nullptr for the start symbol)
+    struct Entry {
+        uint16_t symbol;
+        ParseTreeNode* parent;
+    };
+    vector<Entry> stack;
+    stack.reserve(256);
+    ParseTreeNode* root = nullptr;
+
+    // The symbol being handled. An expansion continues straight with its
+    // first symbol; only the rest go through the stack.
+    Entry top{LL1_START, nullptr};
+    for (;;) {
+        if (top.symbol >= RULE_COUNT) {
+            ParseTreeNode* token = consume(static_cast<TokenType>(top.symbol));
+            if (!token) return nullptr;
+            addChild(top.parent, token);
+        } else {
+            RuleId rule = static_cast<RuleId>(top.symbol);
+            uint8_t production = LL1_TABLE[rule][currentToken - IF];
+            if (production == LL1_NO_PRODUCTION) {
+                production = LL1_DEFAULT[rule];
+                if (production == LL1_NO_PRODUCTION) {
+                    reportError(tableError(rule));
+                    return nullptr;
+                }
+            }
+
+            // A flattened list tail adds its elements to the list owner
+            ParseTreeNode* node = top.parent;
+            if (!options.flattenLists || !LL1_LIST_RULE[rule]) {
+                node = newNonTerminal(rule);
+                if (top.parent) {
+                    addChild(top.parent, node);
+                } else {
+                    root = node;
+                }
+            }
+
+            const LL1Production& p = LL1_PRODUCTIONS[production];
+            if (p.length > 0) {
+                // Pushed right to left, so the symbols are handled left to
+                // right and each node's children are appended in order
+                const uint16_t* symbols = LL1_SYMBOLS + p.first;
+                for (unsigned i = p.length; --i > 0;) {
+                    stack.push_back(Entry{symbols[i], node});
+                }
+                STATS_STACK_DEPTH(counters, stack.size() + 1);
+                top = Entry{symbols[0], node};
+                continue;
+            }
+            // Empty production; a flattened list records it only when empty
+            if (node != top.parent || !node->firstChild) {
+                addChild(node, newEpsilon());
+            }
+        }
+        if (stack.empty()) {
+            break;
+        }
+        top = stack.back();
+        stack.pop_back();
+    }
+
+    return root;
+}
@@ -0,0 +1,76 @@
+#include "ThreadPool.h"
+#include <thread>
+
+using namespace std;
+
+unsigned WorkStealingPool::hardwareThreads() {
+    unsigned n = thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+WorkStealingPool::WorkStealingPool(unsigned threads) : threadCount(threads) {
+    if (threadCount == 0) {
+        threadCount = hardwareThreads();
+    }
+    for (unsigned i = 0; i < threadCount; i++) {
+        queues.push_back(unique_ptr<WorkQueue>(new WorkQueue()));
+    }
+}
+
+void WorkStealingPool::run(size_t count, const function<void(size_t, unsigned)>& task) {
+    // Deal out contiguous blocks of indices
+    for (unsigned w = 0; w < threadCount; w++) {
+        size_t begin = count * w / threadCount;
+        size_t end = count * (w + 1) / threadCount;
+        lock_guard<mutex> guard(queues[w]->lock);
+        for (size_t i = begin; i < end; i++) {
+            queues[w]->items.push_back(i);
+        }
+    }
+
+    if (threadCount == 1) {
+        workerLoop(0, task);
+        return;
+    }
+
+    vector<thread> workers;
+    for (unsigned w = 1; w < threadCount; w++) {
+        workers.push_back(thread(&WorkStealingPool::workerLoop, this, w, cref(task)));
+    }
+    workerLoop(0, task);  // The calling thread is worker 0
+    for (auto& t : workers) {
+        t.join();
+    }
+}
+
+bool WorkStealingPool::popLocal(unsigned worker, size_t& index) {
+    WorkQueue& q = *queues[worker];
+    lock_guard<mutex> guard(q.lock);
+    if (q.items.empty()) {
+        return false;
+    }
+    index = q.items.front();
+    q.items.pop_front();
+    return true;
+}
+
+bool WorkStealingPool::steal(unsigned thief, size_t& index) {
+    for (unsigned i = 1; i < threadCount; i++) {
+        WorkQueue& q = *queues[(thief + i) % threadCount];
+        lock_guard<mutex> guard(q.lock);
+        if (!q.items.empty()) {
+            index = q.items.back();
+            q.items.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(unsigned worker, const function<void(size_t, unsigned)>& task) {
+    size_t index;
+    // No task creates new tasks, so once every deque is empty we are done
+    while (popLocal(worker, index) || steal(worker, index)) {
+        task(index, worker);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+ * Runs a batch of independent tasks on a fixed number of threads.
+ *
+ * Task indices are dealt out in contiguous blocks to one deque per worker.
+ * A worker pops from the front of its own deque and, once that is empty,
+ * steals from the back of another worker's deque, so a few slow tasks
+ * (large files) do not leave the other threads idle.
+ */
+class WorkStealingPool {
+public:
+    // threads == 0 picks the number of hardware threads
+    explicit WorkStealingPool(unsigned threads = 0);
+
+    // Call task(index, worker) for every index in [0, count) and wait for
+    // all of them to finish. worker is in [0, size()).
+    void run(size_t count, const std::function<void(size_t, unsigned)>& task);
+
+    unsigned size() const { return threadCount; }
+
+    // Number of hardware threads, at least 1
+    static unsigned hardwareThreads();
+
+private:
+    struct WorkQueue {
+        std::mutex lock;
+        std::deque<size_t> items;
+    };
+
+    unsigned threadCount;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    bool popLocal(unsigned worker, size_t& index);
+    bool steal(unsigned thief, size_t& index);
+    void workerLoop(unsigned worker, const std::function<void(size_t, unsigned)>& task);
+};
+
+#endif /* THREADPOOL_H */
@@ -0,0 +1,122 @@
+#include "TokenBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+const char* keywordSpelling(TokenType type) {
+    switch (type) {
+        case IF:      return "if";
+        case ELSE:    return "else";
+        case WHILE:   return "while";
+        case INT:     return "int";
+        case FLOAT:   return "float";
+        case RETURN:  return "return";
+        case VOID:    return "void";
+        case PROGRAM: return "Program";
+        default:      return nullptr;
+    }
+}
+
+bool TokenBuffer::tokenize(const InputBuffer& input, LexerBackend backend, bool printErrors) {
+    if (input.size() > UINT32_MAX) {
+        return false;
+    }
+    Lexer lexer(input, backend);
+    lexer.setPrintErrors(printErrors);
+    return tokenize(input, lexer);
+}
+
+bool TokenBuffer::tokenize(const InputBuffer& input, Lexer& lexer) {
+    types.clear();
+    offsets.clear();
+    lengths.clear();
+    lineStarts.clear();
+    lexError.clear();
+
+    if (input.size() > UINT32_MAX) {
+        return false;
+    }
+    source = input.data();
+    sourceSize = input.size();
+    originLine = 1;
+    originCol = 1;
+
+    // Roughly one token per five bytes of typical C- source
+    size_t estimate = sourceSize / 5 + 16;
+    types.reserve(estimate);
+    offsets.reserve(estimate);
+    lengths.reserve(estimate);
+
+    int token;
+    while ((token = lexer.next()) != 0) {
+        types.push_back(static_cast<uint8_t>(token - TOKEN_BASE));
+        offsets.push_back(static_cast<uint32_t>(lexer.offset()));
+        lengths.push_back(static_cast<uint32_t>(lexer.lexeme().size()));
+        if (token == ERROR && lexError.empty()) {
+            lexError = lexer.errorMessage();
+        }
+    }
+
+    types.push_back(static_cast<uint8_t>(ENDOFFILE - TOKEN_BASE));
+    offsets.push_back(static_cast<uint32_t>(sourceSize));
+    lengths.push_back(0);
+    return true;
+}
+
+string_view TokenBuffer::lexeme(size_t index) const {
+    TokenType t = type(index);
+    if (t == ENDOFFILE) {
+        return "EOF";
+    }
+    const char* keyword = keywordSpelling(t);
+    if (keyword) {
+        return keyword;
+    }
+    return string_view(source + offsets[index], lengths[index]);
+}
+
+void TokenBuffer::reset(const char* text, size_t size, long long line, long long col) {
+    types.clear();
+    offsets.clear();
+    lengths.clear();
+    lineStarts.clear();
+    lexError.clear();
+    source = text;
+    sourceSize = size;
+    originLine = line;
+    originCol = col;
+
+    types.push_back(static_cast<uint8_t>(ENDOFFILE - TOKEN_BASE));
+    offsets.push_back(static_cast<uint32_t>(size));
+    lengths.push_back(0);
+}
+
+void TokenBuffer::append(TokenType type, uint32_t offset, uint32_t length) {
+    // Overwrite the end marker and put it back after the new token
+    types.back() = static_cast<uint8_t>(type - TOKEN_BASE);
+    offsets.back() = offset;
+    lengths.back() = length;
+    types.push_back(static_cast<uint8_t>(ENDOFFILE - TOKEN_BASE));
+    offsets.push_back(static_cast<uint32_t>(sourceSize));
+    lengths.push_back(0);
+}
+
+void TokenBuffer::position(size_t index, long long& line, long long& col) const {
+    if (lineStarts.empty()) {
+        lineStarts.push_back(0);
+        const char* p = source;
+        const char* end = source + sourceSize;
+        while ((p = static_cast<const char*>(memchr(p, '\n', end - p))) != nullptr) {
+            ++p;
+            lineStarts.push_back(static_cast<uint32_t>(p - source));
+        }
+    }
+
+    // The scanner's column counts bytes since the last newline, starting at 1
+    uint32_t end = offsets[index] + lengths[index];
+    auto it = upper_bound(lineStarts.begin(), lineStarts.end(), end) - 1;
+    size_t lineIndex = it - lineStarts.begin();
+    line = originLine + static_cast<long long>(lineIndex);
+    col = lineIndex == 0 ? originCol + end : static_cast<long long>(end - *it) + 1;
+}
@@ -0,0 +1,87 @@
+#ifndef TOKENBUFFER_H
+#define TOKENBUFFER_H
+
+#include "token.h"
+#include "InputBuffer.h"
+#include "Lexer.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* One token as produced by a lexing pass */
+struct TokenRecord {
+    TokenType type;
+    uint32_t offset;
+    uint32_t length;
+};
+
+/*
+ * The whole token stream of one input, produced by a separate lexing pass.
+ *
+ * Tokens are stored as a structure of arrays: a one-byte type (relative to
+ * the first token code), and a 32-bit byte offset and length into the
+ * source text. Line and column numbers are not stored; they are computed on
+ * demand from a newline index built the first time a position is asked
+ * for. The last token is always ENDOFFILE.
+ */
+class TokenBuffer {
+public:
+    TokenBuffer() : source(nullptr), sourceSize(0), originLine(1), originCol(1) {}
+
+    // Lex all of input. Returns false if the input is too large for 32-bit
+    // offsets. The input must outlive this buffer. Lexical errors are
+    // echoed to stderr unless printErrors is false.
+    bool tokenize(const InputBuffer& input, LexerBackend backend = DEFAULT_LEXER_BACKEND,
+                  bool printErrors = true);
+
+    // Lex all of input with a scanner already reading it (see Lexer::reset),
+    // so a caller lexing many inputs can keep one scanner
+    bool tokenize(const InputBuffer& input, Lexer& lexer);
+
+    size_t size() const { return types.size(); }
+
+    TokenType type(size_t index) const { return static_cast<TokenType>(types[index] + TOKEN_BASE); }
+    uint32_t offset(size_t index) const { return offsets[index]; }
+    uint32_t length(size_t index) const { return lengths[index]; }
+
+    // Text of a token: the source text, or the canonical spelling for
+    // keywords and "EOF" for the end marker
+    std::string_view lexeme(size_t index) const;
+
+    // Line and column just past the end of a token, matching what the
+    // scanner reports after returning it
+    void position(size_t index, long long& line, long long& col) const;
+
+    // Fill the buffer with tokens lexed elsewhere, such as a stretch of a
+    // document kept by IncrementalParser: reset() empties it onto text,
+    // whose first byte lies at the given line and column, and append()
+    // adds tokens (offsets relative to text) in order before the ENDOFFILE
+    // marker, which stays at the end of text
+    void reset(const char* text, size_t size, long long line = 1, long long col = 1);
+    void append(TokenType type, uint32_t offset, uint32_t length);
+
+    // First lexical error seen while tokenizing, empty if none
+    const std::string& errorMessage() const { return lexError; }
+
+private:
+    static const int TOKEN_BASE = IF;
+
+    std::vector<uint8_t> types;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> lengths;
+
+    const char* source;
+    size_t sourceSize;
+    long long originLine;       // Position of the first byte of the source
+    long long originCol;
+    std::string lexError;
+
+    // Offsets of the first byte of every line, built lazily
+    mutable std::vector<uint32_t> lineStarts;
+};
+
+// Canonical spelling the lexer reports for a keyword, nullptr otherwise
+const char* keywordSpelling(TokenType type);
+
+#endif /* TOKENBUFFER_H */
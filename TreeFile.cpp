@@ -0,0 +1,257 @@
+#include "TreeFile.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static uint64_t alignTo8(uint64_t n) {
+    return (n + 7) & ~static_cast<uint64_t>(7);
+}
+
+// Flatten the tree into preorder records with subtree sizes
+static bool collectNodes(const ParseTreeNode* root, vector<TreeFileNode>& out) {
+    struct Frame {
+        const ParseTreeNode* next;
+        size_t index;
+    };
+    vector<Frame> stack;
+
+    auto visit = [&](const ParseTreeNode* node) {
+        TreeFileNode record;
+        record.kind = node->kind;
+        record.rule = node->rule;
+        record.token = node->token;
+        record.symbol = node->kind == NODE_TERMINAL ? node->symbol : 0;
+        record.subtreeSize = 0;
+        stack.push_back(Frame{node->firstChild, out.size()});
+        out.push_back(record);
+    };
+
+    if (root) {
+        visit(root);
+    }
+    while (!stack.empty()) {
+        Frame& top = stack.back();
+        const ParseTreeNode* node = top.next;
+        if (node) {
+            top.next = node->nextSibling;
+            visit(node);
+            continue;
+        }
+        size_t count = out.size() - top.index;
+        if (count > UINT32_MAX) {
+            return false;
+        }
+        out[top.index].subtreeSize = static_cast<uint32_t>(count);
+        stack.pop_back();
+    }
+    return true;
+}
+
+// Everything but the string data: the header, the nodes and the string
+// start offsets
+static bool layoutTree(const ParseTreeNode* root, const StringInterner& symbols, uint32_t flags,
+                       TreeFileHeader& header, vector<TreeFileNode>& nodes, vector<uint64_t>& offsets) {
+    if (!collectNodes(root, nodes)) {
+        return false;
+    }
+
+    size_t stringCount = symbols.size();
+    offsets.assign(stringCount + 1, 0);
+    for (size_t i = 0; i < stringCount; i++) {
+        offsets[i + 1] = offsets[i] + symbols.str(static_cast<uint32_t>(i)).size();
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TREE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TREE_FILE_VERSION;
+    header.byteOrder = TREE_FILE_BYTE_ORDER;
+    header.flags = flags;
+    header.nodeSize = sizeof(TreeFileNode);
+    header.nodeCount = nodes.size();
+    header.stringCount = stringCount;
+    header.nodesOffset = alignTo8(sizeof(TreeFileHeader));
+    header.stringOffsetsOffset = alignTo8(header.nodesOffset + nodes.size() * sizeof(TreeFileNode));
+    header.stringDataOffset = header.stringOffsetsOffset + offsets.size() * sizeof(uint64_t);
+    header.stringDataSize = offsets[stringCount];
+    return true;
+}
+
+bool writeTreeFile(const ParseTreeNode* root, const StringInterner& symbols,
+                   const string& path, uint32_t flags) {
+    TreeFileHeader header;
+    vector<TreeFileNode> nodes;
+    vector<uint64_t> offsets;
+    if (!layoutTree(root, symbols, flags, header, nodes, offsets)) {
+        return false;
+    }
+    size_t stringCount = symbols.size();
+
+    FILE* out = fopen(path.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    static const char padding[8] = {0};
+    size_t nodeBytes = nodes.size() * sizeof(TreeFileNode);
+
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    ok = ok && fwrite(nodes.data(), 1, nodeBytes, out) == nodeBytes;
+    size_t pad = header.stringOffsetsOffset - header.nodesOffset - nodeBytes;
+    ok = ok && fwrite(padding, 1, pad, out) == pad;
+    ok = ok && fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), out) == offsets.size();
+    for (size_t i = 0; ok && i < stringCount; i++) {
+        string_view text = symbols.str(static_cast<uint32_t>(i));
+        ok = fwrite(text.data(), 1, text.size(), out) == text.size();
+    }
+    ok = fclose(out) == 0 && ok;
+    return ok;
+}
+
+bool serializeTree(const ParseTreeNode* root, const StringInterner& symbols, string& out,
+                   uint32_t flags) {
+    TreeFileHeader header;
+    vector<TreeFileNode> nodes;
+    vector<uint64_t> offsets;
+    if (!layoutTree(root, symbols, flags, header, nodes, offsets)) {
+        return false;
+    }
+
+    size_t start = out.size();
+    out.resize(start + header.stringDataOffset);
+    char* p = &out[start];
+    memcpy(p, &header, sizeof(header));
+    memcpy(p + header.nodesOffset, nodes.data(), nodes.size() * sizeof(TreeFileNode));
+    memcpy(p + header.stringOffsetsOffset, offsets.data(), offsets.size() * sizeof(uint64_t));
+    out.reserve(start + header.stringDataOffset + header.stringDataSize);
+    for (size_t i = 0; i < symbols.size(); i++) {
+        string_view text = symbols.str(static_cast<uint32_t>(i));
+        out.append(text.data(), text.size());
+    }
+    return true;
+}
+
+bool TreeFile::fail(const string& message) {
+    close();
+    error = message;
+    return false;
+}
+
+bool TreeFile::open(const string& path) {
+    close();
+    error.clear();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return fail("Cannot open file");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return fail("Not a regular file");
+    }
+    size_t fileSize = static_cast<size_t>(st.st_size);
+    if (fileSize < sizeof(TreeFileHeader)) {
+        ::close(fd);
+        return fail("File too small for a tree header");
+    }
+    void* region = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (region == MAP_FAILED) {
+        return fail("Cannot map file");
+    }
+    base = region;
+    mappedSize = fileSize;
+
+    const char* bytes = static_cast<const char*>(base);
+    header = reinterpret_cast<const TreeFileHeader*>(bytes);
+    if (memcmp(header->magic, TREE_FILE_MAGIC, sizeof(header->magic)) != 0) {
+        return fail("Not a parse tree file");
+    }
+    if (header->byteOrder != TREE_FILE_BYTE_ORDER) {
+        return fail("File was written with a different byte order");
+    }
+    if (header->version != TREE_FILE_VERSION || header->nodeSize != sizeof(TreeFileNode)) {
+        return fail("Unsupported tree file version");
+    }
+
+    // Every section must lie inside the file and be aligned for its type
+    uint64_t nodeBytes = header->nodeCount * sizeof(TreeFileNode);
+    uint64_t offsetBytes = (header->stringCount + 1) * sizeof(uint64_t);
+    if (header->nodeCount == 0 || header->nodeCount > UINT32_MAX || header->stringCount >= UINT32_MAX ||
+        header->nodesOffset > fileSize || header->stringOffsetsOffset > fileSize ||
+        header->nodesOffset % 8 != 0 || header->stringOffsetsOffset % 8 != 0 ||
+        header->nodesOffset < sizeof(TreeFileHeader) ||
+        header->nodesOffset + nodeBytes > header->stringOffsetsOffset ||
+        header->stringOffsetsOffset + offsetBytes > header->stringDataOffset ||
+        header->stringDataOffset > fileSize || header->stringDataSize > fileSize - header->stringDataOffset) {
+        return fail("Corrupt tree file header");
+    }
+    nodes = reinterpret_cast<const TreeFileNode*>(bytes + header->nodesOffset);
+    stringOffsets = reinterpret_cast<const uint64_t*>(bytes + header->stringOffsetsOffset);
+    stringData = bytes + header->stringDataOffset;
+
+    if (stringOffsets[0] != 0) {
+        return fail("Corrupt string table");
+    }
+    for (size_t i = 0; i < header->stringCount; i++) {
+        if (stringOffsets[i + 1] < stringOffsets[i] || stringOffsets[i + 1] > header->stringDataSize) {
+            return fail("Corrupt string table");
+        }
+    }
+
+    // One linear scan so navigation never leaves the node array: subtrees
+    // nest inside their parent and terminals name existing strings
+    vector<size_t> ends;
+    ends.push_back(size());
+    if (nodes[0].subtreeSize != size()) {
+        return fail("Corrupt node array");
+    }
+    for (size_t i = 0; i < size(); i++) {
+        while (ends.back() == i) {
+            ends.pop_back();
+        }
+        const TreeFileNode& n = nodes[i];
+        if (n.subtreeSize == 0 || i + n.subtreeSize > ends.back() || n.kind > NODE_ERROR ||
+            (n.kind == NODE_NONTERMINAL && n.rule >= RULE_COUNT) ||
+            (n.kind == NODE_TERMINAL && n.symbol >= header->stringCount)) {
+            return fail("Corrupt node array");
+        }
+        ends.push_back(i + n.subtreeSize);
+    }
+    return true;
+}
+
+void TreeFile::close() {
+    if (base) {
+        munmap(base, mappedSize);
+    }
+    base = nullptr;
+    mappedSize = 0;
+    header = nullptr;
+    nodes = nullptr;
+    stringOffsets = nullptr;
+    stringData = nullptr;
+}
+
+string TreeFile::label(size_t index) const {
+    const TreeFileNode& n = nodes[index];
+    switch (n.kind) {
+        case NODE_NONTERMINAL:
+            return ruleName(static_cast<RuleId>(n.rule));
+        case NODE_TERMINAL: {
+            string text = tokenName(static_cast<TokenType>(n.token));
+            text += ": ";
+            text += symbol(n.symbol);
+            return text;
+        }
+        case NODE_ERROR:
+            return "error";
+        default:
+            return "ε";
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef TREEFILE_H
+#define TREEFILE_H
+
+#include "ParseTree.h"
+#include "StringInterner.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+ * Binary parse tree file (.ptree).
+ *
+ * Layout, all integers in host byte order (checked with byteOrder):
+ *
+ *   TreeFileHeader
+ *   TreeFileNode[nodeCount]          nodes in preorder
+ *   uint64_t[stringCount + 1]        string start offsets into the data
+ *   char[stringDataSize]             string data, not NUL-terminated
+ *
+ * Every section starts at an 8-byte aligned offset. A node's first child,
+ * if any, is the next node; its next sibling is at index + subtreeSize,
+ * so a subtree is a contiguous range and skipping one is an add. Terminal
+ * symbols index the string table, which is the parser's StringInterner
+ * in ID order.
+ */
+
+static const char TREE_FILE_MAGIC[8] = {'C', 'M', 'T', 'R', 'E', 'E', '\0', '\0'};
+static const uint32_t TREE_FILE_VERSION = 1;
+static const uint32_t TREE_FILE_BYTE_ORDER = 0x01020304;
+
+// Header flags
+static const uint32_t TREE_FILE_FLAT_LISTS = 1;    // Built with --flat-lists
+
+struct TreeFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t flags;
+    uint32_t nodeSize;          // sizeof(TreeFileNode)
+    uint64_t nodeCount;
+    uint64_t stringCount;
+    uint64_t nodesOffset;
+    uint64_t stringOffsetsOffset;
+    uint64_t stringDataOffset;
+    uint64_t stringDataSize;
+};
+
+struct TreeFileNode {
+    uint8_t kind;               // NodeKind
+    uint8_t rule;               // RuleId, nonterminals only
+    uint16_t token;             // TokenType, terminals only
+    uint32_t symbol;            // String table index, terminals only
+    uint32_t subtreeSize;       // This node plus all its descendants
+};
+
+static_assert(sizeof(TreeFileHeader) == 72, "TreeFileHeader layout changed");
+static_assert(sizeof(TreeFileNode) == 12, "TreeFileNode layout changed");
+
+// Write a tree and its string table. Returns false if the file cannot be
+// written or the tree has more than 2^32 - 1 nodes.
+bool writeTreeFile(const ParseTreeNode* root, const StringInterner& symbols,
+                   const std::string& path, uint32_t flags = 0);
+
+// Append the bytes of the same file to out instead (for sending a tree
+// over a pipe or socket)
+bool serializeTree(const ParseTreeNode* root, const StringInterner& symbols, std::string& out,
+                   uint32_t flags = 0);
+
+/*
+ * Read-only view of a .ptree file.
+ *
+ * open() maps the file and checks the header and string table; the nodes
+ * are used in place, nothing is copied or rebuilt. Node indices run from
+ * 0 (the root) to size() - 1.
+ */
+class TreeFile {
+public:
+    TreeFile() : base(nullptr), mappedSize(0), header(nullptr), nodes(nullptr),
+                 stringOffsets(nullptr), stringData(nullptr) {}
+    ~TreeFile() { close(); }
+
+    TreeFile(const TreeFile&) = delete;
+    TreeFile& operator=(const TreeFile&) = delete;
+
+    // Map and validate a file. On failure errorMessage() says why.
+    bool open(const std::string& path);
+    void close();
+
+    const std::string& errorMessage() const { return error; }
+
+    uint32_t flags() const { return header->flags; }
+    size_t size() const { return static_cast<size_t>(header->nodeCount); }
+    const TreeFileNode& node(size_t index) const { return nodes[index]; }
+
+    // Navigation: the children of i are firstChild(i), then subtreeEnd()
+    // of each child in turn, up to subtreeEnd(i). size() means "none".
+    size_t firstChild(size_t index) const {
+        return nodes[index].subtreeSize > 1 ? index + 1 : size();
+    }
+    size_t subtreeEnd(size_t index) const { return index + nodes[index].subtreeSize; }
+
+    size_t stringCount() const { return static_cast<size_t>(header->stringCount); }
+    std::string_view symbol(uint32_t id) const {
+        return std::string_view(stringData + stringOffsets[id], stringOffsets[id + 1] - stringOffsets[id]);
+    }
+
+    // Label of a node, as in the Graphviz output
+    std::string label(size_t index) const;
+
+private:
+    void* base;
+    size_t mappedSize;
+    const TreeFileHeader* header;
+    const TreeFileNode* nodes;
+    const uint64_t* stringOffsets;
+    const char* stringData;
+    std::string error;
+
+    bool fail(const std::string& message);
+};
+
+#endif /* TREEFILE_H */
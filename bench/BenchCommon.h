@@ -0,0 +1,102 @@
+#ifndef BENCHCOMMON_H
+#define BENCHCOMMON_H
+
+/*
+ * Helpers shared by the benchmarks under bench/: reading an input file,
+ * comparing two parse trees, the token-deletion check that replays a
+ * comparison on copies of an input with one token blanked out, and timing.
+ */
+
+#include "InputBuffer.h"
+#include "ParseTree.h"
+#include "StringInterner.h"
+#include "TokenBuffer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Read file into input; prints the error and returns false if it cannot
+static inline bool readInput(const std::string& file, InputBuffer& input) {
+    FILE* stream = fopen(file.c_str(), "rb");
+    bool ok = stream && input.readStream(stream);
+    if (stream) {
+        fclose(stream);
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: Cannot read file '%s'\n", file.c_str());
+    }
+    return ok;
+}
+
+// Compare two trees node by node (iteratively); returns false on the first
+// difference
+static inline bool sameTree(const ParseTreeNode* a, const StringInterner& symbolsA, const ParseTreeNode* b,
+                            const StringInterner& symbolsB) {
+    std::vector<std::pair<const ParseTreeNode*, const ParseTreeNode*>> stack;
+    stack.push_back(std::make_pair(a, b));
+    while (!stack.empty()) {
+        const ParseTreeNode* x = stack.back().first;
+        const ParseTreeNode* y = stack.back().second;
+        stack.pop_back();
+        if (!x || !y) {
+            if (x != y) {
+                return false;
+            }
+            continue;
+        }
+        if (x->kind != y->kind || x->label(symbolsA) != y->label(symbolsB)) {
+            return false;
+        }
+        stack.push_back(std::make_pair(x->nextSibling, y->nextSibling));
+        stack.push_back(std::make_pair(x->firstChild, y->firstChild));
+    }
+    return true;
+}
+
+// Delete one random token of input (blank it out) per mutation and pass the
+// result to same(), reporting the first failure on stderr. Large inputs get
+// fewer mutations, since each one reparses the file: about budget bytes in
+// all. Returns the number of mutations run; failures are added to mismatches.
+static inline size_t deleteTokens(const std::string& file, const InputBuffer& input, const TokenBuffer& tokens,
+                                  unsigned seed, size_t mutationCount, size_t budget,
+                                  const std::function<bool(const InputBuffer&)>& same, size_t& mismatches) {
+    std::mt19937 rng(seed);
+    size_t count = tokens.size() - 1;
+    size_t mutations = count > 0 ? std::min(mutationCount, std::max<size_t>(1, budget / (input.size() + 1))) : 0;
+    for (size_t n = 0; n < mutations; n++) {
+        size_t index = rng() % count;
+        std::string text(input.data(), input.size());
+        text.replace(tokens.offset(index), tokens.length(index), tokens.length(index), ' ');
+        InputBuffer mutated;
+        mutated.copy(text.data(), text.size());
+        if (!same(mutated)) {
+            if (mismatches == 0) {
+                fprintf(stderr, "MISMATCH %s: without token %zu ('%s')\n", file.c_str(), index,
+                        std::string(tokens.lexeme(index)).c_str());
+            }
+            mismatches++;
+        }
+    }
+    return mutations;
+}
+
+// Best time of runs calls of work, in seconds
+static inline double bestSeconds(unsigned runs, const std::function<void()>& work) {
+    double best = 0;
+    for (unsigned run = 0; run < runs; run++) {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (run == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+#endif
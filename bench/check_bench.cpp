@@ -0,0 +1,144 @@
+// Recognizer check and benchmark: runs check() and parse() on each input,
+// with one error and with error recovery, recursive descent and table
+// driven, and compares the verdicts and every diagnostic. Then deletes
+// random tokens one at a time and compares again. Prints the best parse and
+// check times of the runs (scanning the text in place) and the memory each
+// leaves behind, and exits 1 on any mismatch.
+//
+// Usage: check_bench [--runs=N] [--mutations=N] [--seed=N] <input_file>...
+
+#include "BenchCommon.h"
+#include "InputBuffer.h"
+#include "Parser.h"
+#include "TokenBuffer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// check() and parse() of input agree on validity and on every error
+static bool sameResult(const InputBuffer& input, const ParserOptions& options) {
+    Parser builder(input, options);
+    ParseTreeNode* tree = builder.parse();
+    bool expected = tree && !builder.hadError();
+    Parser recognizer(input, options);
+    bool actual = recognizer.check();
+    if (expected != actual || recognizer.treeBytes() != 0 || recognizer.getSymbols().size() != 0 ||
+        builder.getDiagnostics().size() != recognizer.getDiagnostics().size() ||
+        builder.getErrorMessage() != recognizer.getErrorMessage()) {
+        return false;
+    }
+    for (size_t i = 0; i < builder.getDiagnostics().size(); i++) {
+        if (builder.getDiagnostics()[i].message != recognizer.getDiagnostics()[i].message) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The option sets compared: one error or recovery; recursive descent or
+// (one error only) the LL(1) tables
+static vector<ParserOptions> optionSets() {
+    vector<ParserOptions> sets;
+    ParserOptions options;
+    sets.push_back(options);
+    options.maxErrors = 10;
+    sets.push_back(options);
+    options.maxErrors = 1;
+    options.tableDriven = true;
+    sets.push_back(options);
+    return sets;
+}
+
+// Best time of runs parses (check or not) of input, and the arena and
+// interner bytes the last one left
+static double bestSeconds(const InputBuffer& input, bool check, unsigned runs, size_t& bytes) {
+    double best = 0;
+    for (unsigned run = 0; run < runs; run++) {
+        auto start = chrono::steady_clock::now();
+        Parser parser(input);
+        if (check) {
+            parser.check();
+        } else {
+            parser.parse();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (run == 0 || seconds < best) {
+            best = seconds;
+        }
+        bytes = parser.treeBytes() + parser.getSymbols().bytesUsed();
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    unsigned runs = 5;
+    size_t mutationCount = 20;
+    unsigned seed = 1;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--runs=", 7) == 0) {
+            runs = max(1u, static_cast<unsigned>(strtoul(argv[i] + 7, nullptr, 10)));
+        } else if (strncmp(argv[i], "--mutations=", 12) == 0) {
+            mutationCount = strtoul(argv[i] + 12, nullptr, 10);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            seed = static_cast<unsigned>(strtoul(argv[i] + 7, nullptr, 10));
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        fprintf(stderr, "Usage: %s [--runs=N] [--mutations=N] [--seed=N] <input_file>...\n", argv[0]);
+        return 1;
+    }
+
+    vector<ParserOptions> sets = optionSets();
+    int status = 0;
+    printf("%-28s %10s %10s %10s %10s %8s %12s %10s\n", "file", "tokens", "mutations", "parse ms", "check ms",
+           "speedup", "parse bytes", "check bytes");
+    for (const string& file : files) {
+        InputBuffer input;
+        if (!readInput(file, input)) {
+            return 1;
+        }
+
+        for (const ParserOptions& options : sets) {
+            if (!sameResult(input, options)) {
+                fprintf(stderr, "MISMATCH %s (max errors %d%s)\n", file.c_str(), options.maxErrors,
+                        options.tableDriven ? ", table driven" : "");
+                status = 1;
+            }
+        }
+
+        // Delete one token (blank it out) and compare the errors
+        TokenBuffer tokens;
+        tokens.tokenize(input, DEFAULT_LEXER_BACKEND, false);
+        size_t mismatches = 0;
+        size_t mutations = deleteTokens(file, input, tokens, seed, mutationCount, 20000000,
+                                        [&](const InputBuffer& mutated) {
+                                            for (const ParserOptions& options : sets) {
+                                                if (!sameResult(mutated, options)) {
+                                                    return false;
+                                                }
+                                            }
+                                            return true;
+                                        },
+                                        mismatches);
+        if (mismatches > 0) {
+            status = 1;
+        }
+
+        size_t parseBytes = 0;
+        size_t checkBytes = 0;
+        double parseSeconds = bestSeconds(input, false, runs, parseBytes);
+        double checkSeconds = bestSeconds(input, true, runs, checkBytes);
+        printf("%-28s %10zu %10zu %10.2f %10.2f %7.2fx %12zu %10zu\n", file.c_str(), tokens.size(), mutations,
+               parseSeconds * 1e3, checkSeconds * 1e3, checkSeconds > 0 ? parseSeconds / checkSeconds : 0.0,
+               parseBytes, checkBytes);
+    }
+    return status;
+}
@@ -0,0 +1,244 @@
+// Synthetic C- corpus generator for the benchmarks. Writes a valid program
+// of roughly the requested size in one of several shapes, each stressing a
+// different part of the lexer, the parser or the tree writers. Output is
+// deterministic for a given seed, and every variable used is declared.
+//
+// Usage: corpus_gen --shape=NAME [--size=BYTES] [--seed=N] [--depth=N]
+//                   [--chain=N] [--id-length=N] [-o FILE]
+//
+// Shapes:
+//   decls        one huge declaration list
+//   statements   a very long list of simple assignments
+//   nested       if / while / { } nested --depth levels deep, repeated
+//   chains       assignments whose right side is a --chain term + / * chain
+//   comments     short statements buried in block comments
+//   identifiers  --id-length character identifiers everywhere
+//   mixed        all statement kinds, like hand-written code
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct Config {
+    string shape;
+    size_t size;
+    unsigned seed;
+    unsigned depth;
+    unsigned chain;
+    unsigned idLength;
+};
+
+class Generator {
+public:
+    Generator(const Config& c, FILE* o) : config(c), out(o), rng(c.seed), written(0) {}
+
+    bool run() {
+        const string& shape = config.shape;
+        if (shape == "decls") {
+            declare(SIZE_MAX, 0);
+            put("x0 = 0\n");
+        } else if (shape == "identifiers") {
+            declare(1000, config.idLength);
+            while (!full()) {
+                put(var() + " = " + var() + " + " + var() + " * " + num() + "\n");
+            }
+        } else {
+            declare(200, 0);
+            while (!full()) {
+                if (shape == "statements") {
+                    put(var() + " = " + var() + " + " + num() + "\n");
+                } else if (shape == "nested") {
+                    nested(config.depth);
+                } else if (shape == "chains") {
+                    chain();
+                } else if (shape == "comments") {
+                    comment();
+                    put(var() + " = " + var() + "\n");
+                } else if (shape == "mixed") {
+                    mixed();
+                } else {
+                    return false;
+                }
+            }
+        }
+        put("}.\n");
+        return true;
+    }
+
+private:
+    Config config;
+    FILE* out;
+    mt19937 rng;
+    size_t written;
+    vector<string> names;
+
+    bool full() const { return written >= config.size; }
+
+    void put(const string& text) {
+        fwrite(text.data(), 1, text.size(), out);
+        written += text.size();
+    }
+
+    unsigned pick(unsigned n) { return static_cast<unsigned>(rng() % n); }
+
+    string var() { return names[pick(static_cast<unsigned>(names.size()))]; }
+
+    string num() {
+        unsigned kind = pick(8);
+        if (kind == 0) {
+            return to_string(pick(100)) + "." + to_string(pick(1000));
+        } else if (kind == 1) {
+            return to_string(pick(10) + 1) + "e" + to_string(pick(10));
+        }
+        return to_string(pick(100000));
+    }
+
+    // "x<i>", padded with letters to length when given
+    string name(size_t i, unsigned length) {
+        string text = "x" + to_string(i);
+        static const char letters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+        while (text.size() < length) {
+            text += letters[pick(sizeof(letters) - 1)];
+        }
+        return text;
+    }
+
+    // The program header and count declarations (until the size is reached
+    // when count is SIZE_MAX). The array "a" is always declared.
+    void declare(size_t count, unsigned length) {
+        put("Program corpus {\n");
+        put("int a[100];\n");
+        for (size_t i = 0; i < count && !full(); i++) {
+            string n = name(i, length);
+            names.push_back(n);
+            if (pick(10) == 0) {
+                put("float " + n + ";\n");
+            } else {
+                put("int " + n + ";\n");
+            }
+        }
+        put("\n");
+    }
+
+    string condition() {
+        static const char* const relops[] = {"<", "<=", ">", ">=", "==", "!="};
+        return var() + " " + relops[pick(6)] + " " + num();
+    }
+
+    void nested(unsigned depth) {
+        string indent;
+        for (unsigned i = 0; i < depth; i++) {
+            if (i % 2 == 0) {
+                put(indent + "if (" + condition() + ") {\n");
+            } else {
+                put(indent + "while (" + condition() + ") {\n");
+            }
+            indent += ' ';
+        }
+        put(indent + var() + " = " + var() + " - 1\n");
+        for (unsigned i = depth; i-- > 0;) {
+            indent.pop_back();
+            put(indent + "}\n");
+        }
+    }
+
+    void chain() {
+        string line = var() + " = " + var();
+        for (unsigned i = 1; i < config.chain; i++) {
+            line += pick(2) ? " + " : " * ";
+            line += pick(4) ? var() : num();
+        }
+        put(line + "\n");
+    }
+
+    void comment() {
+        string text = "/*";
+        unsigned words = pick(40) + 10;
+        for (unsigned i = 0; i < words; i++) {
+            text += i % 12 == 11 ? "\n * " : " ";
+            text += "comment";
+        }
+        put(text + " */\n");
+    }
+
+    void mixed() {
+        switch (pick(5)) {
+            case 0:
+                put(var() + " = " + var() + " + " + var() + " * " + num() + "\n");
+                break;
+            case 1:
+                put("if (" + condition() + ") { " + var() + " = " + var() + " - 1 } else { " + var() +
+                    " = 2 }\n");
+                break;
+            case 2:
+                put("while (" + condition() + ") { " + var() + " = " + var() + " / 2 }\n");
+                break;
+            case 3:
+                put("a[" + var() + "] = (" + var() + " + " + var() + ") * a[" + to_string(pick(100)) + "]\n");
+                break;
+            default:
+                put("/* update */ " + var() + " = " + var() + "\n");
+                break;
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    Config config;
+    config.size = 4 * 1024 * 1024;
+    config.seed = 1;
+    config.depth = 200;
+    config.chain = 1000;
+    config.idLength = 64;
+    const char* output = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--shape=", 8) == 0) {
+            config.shape = argv[i] + 8;
+        } else if (strncmp(argv[i], "--size=", 7) == 0) {
+            config.size = strtoull(argv[i] + 7, nullptr, 10);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            config.seed = static_cast<unsigned>(strtoul(argv[i] + 7, nullptr, 10));
+        } else if (strncmp(argv[i], "--depth=", 8) == 0) {
+            config.depth = static_cast<unsigned>(strtoul(argv[i] + 8, nullptr, 10));
+        } else if (strncmp(argv[i], "--chain=", 8) == 0) {
+            config.chain = static_cast<unsigned>(strtoul(argv[i] + 8, nullptr, 10));
+        } else if (strncmp(argv[i], "--id-length=", 12) == 0) {
+            config.idLength = static_cast<unsigned>(strtoul(argv[i] + 12, nullptr, 10));
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            config.shape.clear();
+            break;
+        }
+    }
+    if (config.shape.empty() || config.chain == 0) {
+        fprintf(stderr,
+                "Usage: %s --shape=NAME [--size=BYTES] [--seed=N] [--depth=N] [--chain=N] [--id-length=N] "
+                "[-o FILE]\n"
+                "Shapes: decls statements nested chains comments identifiers mixed\n",
+                argv[0]);
+        return 1;
+    }
+
+    FILE* out = output ? fopen(output, "wb") : stdout;
+    if (!out) {
+        fprintf(stderr, "Error: Cannot create file '%s'\n", output);
+        return 1;
+    }
+    Generator generator(config, out);
+    bool ok = generator.run();
+    if (output && fclose(out) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: Unknown shape '%s' or write failure\n", config.shape.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+// Library embedding check and benchmark: parses each input many times
+// through cminusParse(), whose per-thread Parser is reset and reused, and
+// compares every tree (or first error) with a parse by a freshly built
+// Parser. Then times both ways of parsing each input and counts the heap
+// allocations per parse. The inputs are parsed round robin, so the reused
+// parser keeps switching between sizes.
+//
+// Usage: embed_bench [--iterations=N] [--ast] <input_file>...
+
+#include "BenchCommon.h"
+#include "CMinus.h"
+#include "InputBuffer.h"
+#include "TokenBuffer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Count heap allocations by interposing the C allocator; operator new and
+// the arenas both end up here
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void __libc_free(void* p);
+
+static size_t allocationCount = 0;
+
+void* malloc(size_t size) {
+    allocationCount++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    allocationCount++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) {
+    allocationCount++;
+    return __libc_realloc(p, size);
+}
+
+void free(void* p) {
+    __libc_free(p);
+}
+}
+
+// What a caller without the library does: copy, lex and parse with a new
+// parser each time
+static bool parseFresh(const string& text, const ParserOptions& options, bool ast) {
+    InputBuffer input;
+    input.copy(text.data(), text.size());
+    TokenBuffer tokens;
+    tokens.tokenize(input, options.lexerBackend, false);
+    Parser parser(tokens, options);
+    return ast ? parser.parseAst() != nullptr : parser.parse() != nullptr;
+}
+
+static bool parseReused(const string& text, const ParserOptions& options, bool ast) {
+    ParseResult result = ast ? cminusParseAst(text.data(), text.size(), options)
+                             : cminusParse(text.data(), text.size(), options);
+    return ast ? result.ast != nullptr : result.tree != nullptr;
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = 20000;
+    bool ast = false;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--iterations=", 13) == 0) {
+            iterations = strtoul(argv[i] + 13, nullptr, 10);
+        } else if (strcmp(argv[i], "--ast") == 0) {
+            ast = true;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty() || iterations == 0) {
+        fprintf(stderr, "Usage: %s [--iterations=N] [--ast] <input_file>...\n", argv[0]);
+        return 1;
+    }
+
+    vector<string> texts;
+    for (const string& file : files) {
+        InputBuffer input;
+        if (!readInput(file, input)) {
+            return 1;
+        }
+        texts.push_back(string(input.data(), input.size()));
+    }
+
+    // Check: the reused parser, switching inputs and tree shapes, against
+    // a fresh parser
+    int status = 0;
+    for (size_t round = 0; round < 4; round++) {
+        for (size_t f = 0; f < texts.size(); f++) {
+            ParserOptions options;
+            options.flattenLists = round % 2 == 1;
+            ParseResult result = cminusParse(texts[f].data(), texts[f].size(), options);
+
+            InputBuffer input;
+            input.copy(texts[f].data(), texts[f].size());
+            TokenBuffer tokens;
+            tokens.tokenize(input, options.lexerBackend, false);
+            Parser parser(tokens, options);
+            ParseTreeNode* expected = parser.parse();
+
+            bool same = (result.tree == nullptr) == (expected == nullptr) &&
+                        result.parser->getErrorMessage() == parser.getErrorMessage() &&
+                        (!expected || sameTree(result.tree, result.parser->getSymbols(), expected,
+                                               parser.getSymbols()));
+            if (!same) {
+                fprintf(stderr, "MISMATCH %s (round %zu)\n", files[f].c_str(), round);
+                status = 1;
+            }
+        }
+    }
+
+    printf("%-28s %8s %12s %12s %14s %14s\n", "file", "bytes", "fresh us", "reused us", "fresh allocs",
+           "reused allocs");
+    ParserOptions options;
+    for (size_t f = 0; f < texts.size(); f++) {
+        // Warm the reused parser on every input first, as a long-running
+        // process would be
+        for (const string& text : texts) {
+            parseReused(text, options, ast);
+        }
+
+        size_t before = allocationCount;
+        auto start = chrono::steady_clock::now();
+        for (size_t n = 0; n < iterations; n++) {
+            parseFresh(texts[f], options, ast);
+        }
+        double freshSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        size_t freshAllocations = allocationCount - before;
+
+        before = allocationCount;
+        start = chrono::steady_clock::now();
+        for (size_t n = 0; n < iterations; n++) {
+            parseReused(texts[f], options, ast);
+        }
+        double reusedSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        size_t reusedAllocations = allocationCount - before;
+
+        printf("%-28s %8zu %12.2f %12.2f %14.1f %14.1f\n", files[f].c_str(), texts[f].size(),
+               freshSeconds / iterations * 1e6, reusedSeconds / iterations * 1e6,
+               static_cast<double>(freshAllocations) / iterations,
+               static_cast<double>(reusedAllocations) / iterations);
+    }
+    return status;
+}
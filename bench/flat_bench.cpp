@@ -0,0 +1,247 @@
+// Flat tree check and benchmark: parses each input, flattens the tree into
+// a FlatTree and checks it node by node against the pointer tree (parents,
+// siblings and child iteration included), checks that writeFlatGraphviz()
+// writes the same .dot file as writeGraphviz() and that loading the .ptree
+// file gives the same arrays. Then times a full traversal (nodes per rule
+// and maximum depth) over the pointer tree and over the flat tree, both as
+// a plain scan and through the visitor, and the two .dot writers.
+//
+// Usage: flat_bench [--runs=N] <input_file>...
+
+#include "BenchCommon.h"
+#include "FlatTree.h"
+#include "GraphvizWriter.h"
+#include "InputBuffer.h"
+#include "Parser.h"
+#include "TokenBuffer.h"
+#include "TreeFile.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+// Nodes per rule and token type, and the maximum depth: the kind of
+// summary a pass over the whole tree computes
+struct Summary {
+    size_t rules[RULE_COUNT];
+    size_t terminals;
+    size_t maxDepth;
+
+    Summary() : rules(), terminals(0), maxDepth(0) {}
+
+    bool operator==(const Summary& other) const {
+        return memcmp(rules, other.rules, sizeof(rules)) == 0 && terminals == other.terminals &&
+               maxDepth == other.maxDepth;
+    }
+};
+
+static Summary summarizePointers(const ParseTreeNode* root) {
+    Summary summary;
+    vector<pair<const ParseTreeNode*, size_t>> stack;
+    stack.push_back(make_pair(root, size_t(1)));
+    while (!stack.empty()) {
+        const ParseTreeNode* node = stack.back().first;
+        size_t depth = stack.back().second;
+        stack.pop_back();
+        if (node->kind == NODE_NONTERMINAL) {
+            summary.rules[node->rule]++;
+        } else if (node->kind == NODE_TERMINAL) {
+            summary.terminals++;
+        }
+        summary.maxDepth = max(summary.maxDepth, depth);
+        for (const ParseTreeNode* child = node->firstChild; child; child = child->nextSibling) {
+            stack.push_back(make_pair(child, depth + 1));
+        }
+    }
+    return summary;
+}
+
+// Counts from a linear scan; the depth from the parent column
+static Summary summarizeScan(const FlatTree& tree) {
+    Summary summary;
+    vector<uint32_t> depth(tree.size());
+    for (uint32_t i = 0; i < tree.size(); i++) {
+        if (tree.kind(i) == NODE_NONTERMINAL) {
+            summary.rules[tree.rule(i)]++;
+        } else if (tree.kind(i) == NODE_TERMINAL) {
+            summary.terminals++;
+        }
+        depth[i] = tree.parent(i) == FlatTree::NO_NODE ? 1 : depth[tree.parent(i)] + 1;
+        summary.maxDepth = max<size_t>(summary.maxDepth, depth[i]);
+    }
+    return summary;
+}
+
+struct SummaryVisitor {
+    const FlatTree& tree;
+    Summary summary;
+    size_t depth;
+
+    explicit SummaryVisitor(const FlatTree& t) : tree(t), depth(0) {}
+
+    bool enter(uint32_t i) {
+        if (tree.kind(i) == NODE_NONTERMINAL) {
+            summary.rules[tree.rule(i)]++;
+        } else if (tree.kind(i) == NODE_TERMINAL) {
+            summary.terminals++;
+        }
+        depth++;
+        summary.maxDepth = max(summary.maxDepth, depth);
+        return true;
+    }
+
+    void leave(uint32_t) { depth--; }
+};
+
+// Check every node against the pointer tree, walking both in preorder
+static bool sameTree(const ParseTreeNode* root, const FlatTree& tree) {
+    struct Frame {
+        const ParseTreeNode* node;
+        uint32_t parent;
+    };
+    vector<Frame> stack;
+    stack.push_back(Frame{root, FlatTree::NO_NODE});
+    uint32_t index = 0;
+    while (!stack.empty()) {
+        Frame frame = stack.back();
+        stack.pop_back();
+        const ParseTreeNode* node = frame.node;
+        if (index >= tree.size() || tree.kind(index) != node->kind || tree.parent(index) != frame.parent ||
+            (node->kind == NODE_NONTERMINAL && tree.rule(index) != node->rule) ||
+            (node->kind == NODE_TERMINAL && (tree.token(index) != node->tokenType() ||
+                                             tree.symbol(index) != node->symbol))) {
+            return false;
+        }
+
+        // The children through the iterator, firstChild() and nextSibling()
+        vector<const ParseTreeNode*> children;
+        for (const ParseTreeNode* child = node->firstChild; child; child = child->nextSibling) {
+            children.push_back(child);
+        }
+        size_t n = 0;
+        uint32_t sibling = tree.firstChild(index);
+        for (uint32_t child : tree.children(index)) {
+            if (n >= children.size() || child != sibling || tree.parent(child) != index) {
+                return false;
+            }
+            sibling = tree.nextSibling(child);
+            n++;
+        }
+        if (n != children.size() || sibling != FlatTree::NO_NODE) {
+            return false;
+        }
+
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            stack.push_back(Frame{*it, index});
+        }
+        index++;
+    }
+    return index == tree.size();
+}
+
+static bool sameArrays(const FlatTree& a, const FlatTree& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (uint32_t i = 0; i < a.size(); i++) {
+        if (a.kind(i) != b.kind(i) || a.rule(i) != b.rule(i) || a.symbol(i) != b.symbol(i) ||
+            a.subtreeSize(i) != b.subtreeSize(i) || a.parent(i) != b.parent(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static string readFile(const string& path) {
+    ifstream stream(path, ios::binary);
+    return string(istreambuf_iterator<char>(stream), istreambuf_iterator<char>());
+}
+
+int main(int argc, char** argv) {
+    unsigned runs = 5;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--runs=", 7) == 0) {
+            runs = max(1u, static_cast<unsigned>(strtoul(argv[i] + 7, nullptr, 10)));
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        fprintf(stderr, "Usage: %s [--runs=N] <input_file>...\n", argv[0]);
+        return 1;
+    }
+
+    char directory[] = "/tmp/flat_benchXXXXXX";
+    if (!mkdtemp(directory)) {
+        fprintf(stderr, "Error: Cannot create a temporary directory\n");
+        return 1;
+    }
+    string dotA = string(directory) + "/pointer.dot";
+    string dotB = string(directory) + "/flat.dot";
+    string ptree = string(directory) + "/tree.ptree";
+
+    int status = 0;
+    printf("%-28s %10s %10s %10s %10s %10s %10s %10s\n", "file", "nodes", "build ns", "walk ns", "scan ns",
+           "visit ns", "dot ms", "flat dot");
+    for (const string& file : files) {
+        InputBuffer input;
+        if (!readInput(file, input)) {
+            return 1;
+        }
+
+        TokenBuffer tokens;
+        tokens.tokenize(input, DEFAULT_LEXER_BACKEND, false);
+        Parser parser(tokens);
+        ParseTreeNode* root = parser.parse();
+        if (!root) {
+            printf("%-28s %10s\n", file.c_str(), "(syntax error)");
+            continue;
+        }
+
+        FlatTree tree;
+        tree.build(root);
+        FlatTree loaded;
+        TreeFile treeFile;
+        bool ok = sameTree(root, tree) && summarizePointers(root) == summarizeScan(tree);
+        SummaryVisitor visitor(tree);
+        tree.walk(visitor);
+        ok = ok && visitor.summary == summarizeScan(tree) && visitor.depth == 0;
+        ok = ok && writeGraphviz(root, parser.getSymbols(), dotA) &&
+             writeFlatGraphviz(tree, parser.getSymbols(), dotB) && readFile(dotA) == readFile(dotB);
+        ok = ok && writeTreeFile(root, parser.getSymbols(), ptree) && treeFile.open(ptree) &&
+             loaded.load(treeFile) && sameArrays(tree, loaded);
+        if (!ok) {
+            fprintf(stderr, "MISMATCH %s\n", file.c_str());
+            status = 1;
+        }
+
+        double nodes = tree.size();
+        double buildSeconds = bestSeconds(runs, [&] { tree.build(root); });
+        Summary sink;
+        double walkSeconds = bestSeconds(runs, [&] { sink = summarizePointers(root); });
+        double scanSeconds = bestSeconds(runs, [&] { sink = summarizeScan(tree); });
+        double visitSeconds = bestSeconds(runs, [&] {
+            SummaryVisitor v(tree);
+            tree.walk(v);
+            sink = v.summary;
+        });
+        double dotSeconds = bestSeconds(runs, [&] { writeGraphviz(root, parser.getSymbols(), dotA); });
+        double flatDotSeconds = bestSeconds(runs, [&] { writeFlatGraphviz(tree, parser.getSymbols(), dotB); });
+        printf("%-28s %10u %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n", file.c_str(), tree.size(),
+               buildSeconds / nodes * 1e9, walkSeconds / nodes * 1e9, scanSeconds / nodes * 1e9,
+               visitSeconds / nodes * 1e9, dotSeconds * 1e3, flatDotSeconds * 1e3);
+    }
+
+    unlink(dotA.c_str());
+    unlink(dotB.c_str());
+    unlink(ptree.c_str());
+    rmdir(directory);
+    return status;
+}
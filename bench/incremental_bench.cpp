@@ -0,0 +1,174 @@
+// Incremental reparsing check and benchmark: applies random edits to each
+// input through an IncrementalParser and, after every edit, compares its
+// token stream, tree and error message with a full parse of the same text.
+// Reports how many edits fell back to a full parse, the mean latency of the
+// others, and the mean time of the reference full parse.
+//
+// Usage: incremental_bench [--edits=N] [--seed=N] [--flat-lists] <input_file>...
+
+#include "BenchCommon.h"
+#include "IncrementalParser.h"
+#include "InputBuffer.h"
+#include "TokenBuffer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Edits that keep a program valid, plus a share of arbitrary ones so the
+// error paths are exercised too
+static TextEdit randomEdit(const IncrementalParser& doc, mt19937& rng) {
+    static const char* const snippets[] = {
+        " ", "\n", "/* c */", "1", "x", "+ 1", "* (x)", "if", "}", "{", ";", "[", "x = 1\n",
+    };
+    const TokenBuffer& tokens = doc.tokenStream();
+    size_t size = doc.text().size();
+    TextEdit edit;
+    edit.offset = 0;
+    edit.length = 0;
+
+    size_t count = tokens.size() - 1;
+    size_t index = count > 0 ? rng() % count : 0;
+    switch (rng() % 6) {
+        case 0:
+        case 1:
+            // Change an identifier or number in place
+            if (count > 0 && (tokens.type(index) == ID || tokens.type(index) == NUM)) {
+                edit.offset = tokens.offset(index);
+                edit.length = tokens.length(index);
+                edit.text = tokens.type(index) == ID ? "v" + to_string(rng() % 50) : to_string(rng() % 1000);
+                return edit;
+            }
+            // Fall through
+        case 2:
+            // Whitespace or a comment between tokens
+            edit.offset = count > 0 ? tokens.offset(index) : 0;
+            edit.text = rng() % 2 ? " " : "/* edit */\n";
+            return edit;
+        case 3:
+            // Swap an additive operator
+            if (count > 0 && (tokens.type(index) == PLUS || tokens.type(index) == MINUS)) {
+                edit.offset = tokens.offset(index);
+                edit.length = 1;
+                edit.text = tokens.type(index) == PLUS ? "-" : "+";
+                return edit;
+            }
+            // Fall through
+        case 4:
+            // Delete a few bytes anywhere
+            edit.offset = size > 0 ? rng() % size : 0;
+            edit.length = min<size_t>(size - edit.offset, rng() % 4);
+            return edit;
+        default:
+            // Insert a snippet anywhere
+            edit.offset = size > 0 ? rng() % (size + 1) : 0;
+            edit.text = snippets[rng() % (sizeof(snippets) / sizeof(snippets[0]))];
+            return edit;
+    }
+}
+
+static bool sameTokens(const TokenBuffer& a, const TokenBuffer& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a.type(i) != b.type(i) || a.offset(i) != b.offset(i) || a.length(i) != b.length(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    size_t editCount = 1000;
+    unsigned seed = 1;
+    ParserOptions options;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--edits=", 8) == 0) {
+            editCount = strtoul(argv[i] + 8, nullptr, 10);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            seed = static_cast<unsigned>(strtoul(argv[i] + 7, nullptr, 10));
+        } else if (strcmp(argv[i], "--flat-lists") == 0) {
+            options.flattenLists = true;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        fprintf(stderr, "Usage: %s [--edits=N] [--seed=N] [--flat-lists] <input_file>...\n", argv[0]);
+        return 1;
+    }
+
+    int status = 0;
+    printf("%-28s %7s %10s %8s %14s %14s\n", "file", "edits", "mismatches", "full", "incremental us",
+           "full parse us");
+    for (const string& file : files) {
+        InputBuffer input;
+        if (!readInput(file, input)) {
+            return 1;
+        }
+
+        mt19937 rng(seed);
+        IncrementalParser doc(options);
+        doc.parse(string_view(input.data(), input.size()));
+
+        size_t mismatches = 0;
+        size_t fullReparses = 0;
+        double incrementalSeconds = 0;
+        double fullSeconds = 0;
+        TextEdit undo;
+        bool broken = false;
+        for (size_t n = 0; n < editCount; n++) {
+            // An edit that broke the program is undone by the next one, so
+            // most edits start from a valid tree
+            vector<TextEdit> edits(1, broken ? undo : randomEdit(doc, rng));
+            undo.offset = edits[0].offset;
+            undo.length = edits[0].text.size();
+            undo.text = string(doc.text().substr(edits[0].offset, edits[0].length));
+
+            auto start = chrono::steady_clock::now();
+            doc.applyEdits(edits);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (doc.lastStats().fullReparses > 0) {
+                fullReparses++;
+            } else {
+                incrementalSeconds += seconds;
+            }
+            broken = doc.hadError() && !broken;
+
+            // Reference: lex and parse the edited text from scratch
+            InputBuffer text;
+            text.copy(doc.text().data(), doc.text().size());
+            start = chrono::steady_clock::now();
+            TokenBuffer tokens;
+            tokens.tokenize(text, options.lexerBackend, false);
+            Parser parser(tokens, options);
+            ParseTreeNode* tree = parser.parse();
+            fullSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            bool same = sameTokens(doc.tokenStream(), tokens) && doc.hadError() == (tree == nullptr) &&
+                        doc.getErrorMessage() == parser.getErrorMessage() &&
+                        (!tree || sameTree(doc.tree(), doc.getSymbols(), tree, parser.getSymbols()));
+            if (!same) {
+                if (mismatches == 0) {
+                    fprintf(stderr, "MISMATCH %s: edit %zu (offset %zu, -%zu, +\"%s\")\n", file.c_str(), n,
+                            edits[0].offset, edits[0].length, edits[0].text.c_str());
+                }
+                mismatches++;
+                status = 1;
+                doc.parse(doc.text());
+            }
+        }
+
+        printf("%-28s %7zu %10zu %8zu %14.1f %14.1f\n", file.c_str(), editCount, mismatches, fullReparses,
+               fullReparses < editCount ? incrementalSeconds / (editCount - fullReparses) * 1e6 : 0.0,
+               fullSeconds / editCount * 1e6);
+    }
+    return status;
+}
@@ -0,0 +1,115 @@
+// Scanner throughput benchmark: lexes the same inputs with every built-in
+// backend and reports tokens/sec. The token streams of the backends are
+// also compared, so a mismatch between them is caught here first.
+//
+// Usage: lexer_bench [--min-time=SECONDS] <input_file>...
+
+#include "BenchCommon.h"
+#include "InputBuffer.h"
+#include "Lexer.h"
+#include "TokenBuffer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct BenchResult {
+    size_t tokens;
+    size_t bytes;
+    double seconds;
+};
+
+// Lex every input repeatedly until at least minTime seconds have passed
+static BenchResult runBackend(const vector<unique_ptr<InputBuffer>>& inputs, LexerBackend backend,
+                              double minTime) {
+    BenchResult result = {0, 0, 0};
+    auto start = chrono::steady_clock::now();
+    do {
+        for (const auto& input : inputs) {
+            Lexer lexer(*input, backend);
+            lexer.setPrintErrors(false);
+            while (lexer.next() != 0) {
+                result.tokens++;
+            }
+            result.bytes += input->size();
+        }
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (result.seconds < minTime);
+    return result;
+}
+
+// Index of the first token where two backends disagree, or -1
+static long firstMismatch(const InputBuffer& input, LexerBackend a, LexerBackend b) {
+    Lexer left(input, a);
+    Lexer right(input, b);
+    left.setPrintErrors(false);
+    right.setPrintErrors(false);
+    for (long index = 0;; index++) {
+        int t1 = left.next();
+        int t2 = right.next();
+        if (t1 != t2 || left.lexeme() != right.lexeme() || left.offset() != right.offset() ||
+            left.line() != right.line() || left.col() != right.col() ||
+            strcmp(left.errorMessage(), right.errorMessage()) != 0) {
+            return index;
+        }
+        if (t1 == 0) {
+            return -1;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    double minTime = 1.0;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--min-time=", 11) == 0) {
+            minTime = atof(argv[i] + 11);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        fprintf(stderr, "Usage: %s [--min-time=SECONDS] <input_file>...\n", argv[0]);
+        return 1;
+    }
+
+    vector<unique_ptr<InputBuffer>> inputs;
+    for (const string& file : files) {
+        unique_ptr<InputBuffer> input(new InputBuffer());
+        if (!readInput(file, *input)) {
+            return 1;
+        }
+        inputs.push_back(move(input));
+    }
+
+    vector<LexerBackend> backends;
+    LexerBackend backend;
+    if (parseLexerBackend("flex", backend)) {
+        backends.push_back(backend);
+    }
+    backends.push_back(LexerBackend::Hand);
+
+    int status = 0;
+    if (backends.size() > 1) {
+        for (size_t i = 0; i < inputs.size(); i++) {
+            long mismatch = firstMismatch(*inputs[i], backends[0], backends[1]);
+            if (mismatch >= 0) {
+                fprintf(stderr, "MISMATCH %s: backends differ at token %ld\n", files[i].c_str(), mismatch);
+                status = 1;
+            }
+        }
+    }
+
+    printf("%-6s %12s %10s %14s %10s\n", "lexer", "tokens", "seconds", "tokens/s", "MB/s");
+    for (LexerBackend b : backends) {
+        BenchResult r = runBackend(inputs, b, minTime);
+        printf("%-6s %12zu %10.3f %14.0f %10.1f\n", lexerBackendName(b), r.tokens, r.seconds,
+               r.tokens / r.seconds, r.bytes / r.seconds / (1024.0 * 1024.0));
+    }
+    return status;
+}
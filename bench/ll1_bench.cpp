@@ -0,0 +1,138 @@
+// Table-driven LL(1) engine check and benchmark: parses each input with
+// both the recursive descent parser and the table-driven engine (--ll1),
+// with and without flattened lists, and compares the trees node by node.
+// Then deletes random tokens one at a time and compares the first error
+// each engine reports. Prints both engines' parse throughput (best of the
+// runs, from the same token buffer) and exits 1 on any mismatch.
+//
+// Usage: ll1_bench [--runs=N] [--mutations=N] [--seed=N] <input_file>...
+
+#include "BenchCommon.h"
+#include "InputBuffer.h"
+#include "Parser.h"
+#include "TokenBuffer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static size_t countNodes(const ParseTreeNode* root) {
+    size_t count = 0;
+    vector<const ParseTreeNode*> stack;
+    if (root) {
+        stack.push_back(root);
+    }
+    while (!stack.empty()) {
+        const ParseTreeNode* node = stack.back();
+        stack.pop_back();
+        count++;
+        for (const ParseTreeNode* child = node->firstChild; child; child = child->nextSibling) {
+            stack.push_back(child);
+        }
+    }
+    return count;
+}
+
+// Parse tokens with both engines; true if they agree on the tree or, for
+// invalid input, on the error
+static bool sameResult(const TokenBuffer& tokens, ParserOptions options) {
+    options.tableDriven = false;
+    Parser recursive(tokens, options);
+    ParseTreeNode* expected = recursive.parse();
+    options.tableDriven = true;
+    Parser table(tokens, options);
+    ParseTreeNode* actual = table.parse();
+    if (!expected || !actual) {
+        return !expected && !actual && recursive.getErrorMessage() == table.getErrorMessage();
+    }
+    return sameTree(expected, recursive.getSymbols(), actual, table.getSymbols());
+}
+
+// Best parse time of runs parses of tokens
+static double bestParseSeconds(const TokenBuffer& tokens, const ParserOptions& options, unsigned runs) {
+    double best = 0;
+    for (unsigned run = 0; run < runs; run++) {
+        auto start = chrono::steady_clock::now();
+        Parser parser(tokens, options);
+        parser.parse();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (run == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    unsigned runs = 5;
+    size_t mutationCount = 200;
+    unsigned seed = 1;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--runs=", 7) == 0) {
+            runs = max(1u, static_cast<unsigned>(strtoul(argv[i] + 7, nullptr, 10)));
+        } else if (strncmp(argv[i], "--mutations=", 12) == 0) {
+            mutationCount = strtoul(argv[i] + 12, nullptr, 10);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            seed = static_cast<unsigned>(strtoul(argv[i] + 7, nullptr, 10));
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        fprintf(stderr, "Usage: %s [--runs=N] [--mutations=N] [--seed=N] <input_file>...\n", argv[0]);
+        return 1;
+    }
+
+    int status = 0;
+    printf("%-28s %10s %10s %16s %16s %8s\n", "file", "nodes", "mutations", "recursive nodes/s",
+           "table nodes/s", "speedup");
+    for (const string& file : files) {
+        InputBuffer input;
+        if (!readInput(file, input)) {
+            return 1;
+        }
+
+        ParserOptions options;
+        TokenBuffer tokens;
+        tokens.tokenize(input, options.lexerBackend, false);
+
+        for (int flat = 0; flat < 2; flat++) {
+            options.flattenLists = flat != 0;
+            if (!sameResult(tokens, options)) {
+                fprintf(stderr, "MISMATCH %s%s\n", file.c_str(), flat ? " (flat lists)" : "");
+                status = 1;
+            }
+        }
+        options.flattenLists = false;
+
+        // Delete one token (blank it out) and compare the errors
+        size_t mismatches = 0;
+        size_t mutations = deleteTokens(file, input, tokens, seed, mutationCount, 2000000,
+                                        [&](const InputBuffer& mutated) {
+                                            TokenBuffer mutatedTokens;
+                                            mutatedTokens.tokenize(mutated, options.lexerBackend, false);
+                                            return sameResult(mutatedTokens, options);
+                                        },
+                                        mismatches);
+        if (mismatches > 0) {
+            status = 1;
+        }
+
+        Parser counter(tokens, options);
+        size_t nodes = countNodes(counter.parse());
+        options.tableDriven = false;
+        double recursiveSeconds = bestParseSeconds(tokens, options, runs);
+        options.tableDriven = true;
+        double tableSeconds = bestParseSeconds(tokens, options, runs);
+        printf("%-28s %10zu %10zu %16.0f %16.0f %7.2fx\n", file.c_str(), nodes, mutations,
+               recursiveSeconds > 0 ? nodes / recursiveSeconds : 0.0, tableSeconds > 0 ? nodes / tableSeconds : 0.0,
+               tableSeconds > 0 ? recursiveSeconds / tableSeconds : 0.0);
+    }
+    return status;
+}
@@ -0,0 +1,144 @@
+// Parallel parsing check and benchmark: parses each input sequentially and
+// with its top-level statement-list split over --jobs threads, with and
+// without flattened lists, and compares the trees node by node, symbol IDs
+// included. Then deletes random tokens one at a time and compares the
+// errors. Prints the best sequential and parallel parse times of the runs
+// (from the same token buffer) and exits 1 on any mismatch.
+//
+// Usage: parallel_bench [--jobs=N] [--runs=N] [--mutations=N] [--seed=N] <input_file>...
+
+#include "BenchCommon.h"
+#include "InputBuffer.h"
+#include "Parser.h"
+#include "TokenBuffer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Both parsers intern the same symbols in the same order, so their
+// interners must match entry for entry
+static bool sameSymbols(const StringInterner& a, const StringInterner& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (uint32_t id = 0; id < a.size(); id++) {
+        if (a.str(id) != b.str(id)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Parse tokens sequentially and in parallel; true if they agree on the
+// tree or, for invalid input, on every error
+static bool sameResult(const TokenBuffer& tokens, ParserOptions options, unsigned jobs) {
+    options.jobs = 1;
+    Parser sequential(tokens, options);
+    ParseTreeNode* expected = sequential.parse();
+    options.jobs = jobs;
+    Parser parallel(tokens, options);
+    ParseTreeNode* actual = parallel.parse();
+    if (!expected || !actual) {
+        if (expected || actual || sequential.getDiagnostics().size() != parallel.getDiagnostics().size()) {
+            return false;
+        }
+        for (size_t i = 0; i < sequential.getDiagnostics().size(); i++) {
+            if (sequential.getDiagnostics()[i].message != parallel.getDiagnostics()[i].message) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return sameTree(expected, sequential.getSymbols(), actual, parallel.getSymbols()) &&
+           sameSymbols(sequential.getSymbols(), parallel.getSymbols());
+}
+
+// Best parse time of runs parses of tokens
+static double bestParseSeconds(const TokenBuffer& tokens, const ParserOptions& options, unsigned runs) {
+    double best = 0;
+    for (unsigned run = 0; run < runs; run++) {
+        auto start = chrono::steady_clock::now();
+        Parser parser(tokens, options);
+        parser.parse();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (run == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    unsigned jobs = 4;
+    unsigned runs = 5;
+    size_t mutationCount = 20;
+    unsigned seed = 1;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            jobs = max(2u, static_cast<unsigned>(strtoul(argv[i] + 7, nullptr, 10)));
+        } else if (strncmp(argv[i], "--runs=", 7) == 0) {
+            runs = max(1u, static_cast<unsigned>(strtoul(argv[i] + 7, nullptr, 10)));
+        } else if (strncmp(argv[i], "--mutations=", 12) == 0) {
+            mutationCount = strtoul(argv[i] + 12, nullptr, 10);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            seed = static_cast<unsigned>(strtoul(argv[i] + 7, nullptr, 10));
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        fprintf(stderr, "Usage: %s [--jobs=N] [--runs=N] [--mutations=N] [--seed=N] <input_file>...\n", argv[0]);
+        return 1;
+    }
+
+    int status = 0;
+    printf("%-28s %10s %10s %14s %14s %8s\n", "file", "tokens", "mutations", "sequential ms", "parallel ms",
+           "speedup");
+    for (const string& file : files) {
+        InputBuffer input;
+        if (!readInput(file, input)) {
+            return 1;
+        }
+
+        ParserOptions options;
+        TokenBuffer tokens;
+        tokens.tokenize(input, options.lexerBackend, false);
+
+        for (int flat = 0; flat < 2; flat++) {
+            options.flattenLists = flat != 0;
+            if (!sameResult(tokens, options, jobs)) {
+                fprintf(stderr, "MISMATCH %s%s\n", file.c_str(), flat ? " (flat lists)" : "");
+                status = 1;
+            }
+        }
+        options.flattenLists = false;
+
+        // Delete one token (blank it out) and compare the errors
+        size_t mismatches = 0;
+        size_t mutations = deleteTokens(file, input, tokens, seed, mutationCount, 20000000,
+                                        [&](const InputBuffer& mutated) {
+                                            TokenBuffer mutatedTokens;
+                                            mutatedTokens.tokenize(mutated, options.lexerBackend, false);
+                                            return sameResult(mutatedTokens, options, jobs);
+                                        },
+                                        mismatches);
+        if (mismatches > 0) {
+            status = 1;
+        }
+
+        options.jobs = 1;
+        double sequentialSeconds = bestParseSeconds(tokens, options, runs);
+        options.jobs = jobs;
+        double parallelSeconds = bestParseSeconds(tokens, options, runs);
+        printf("%-28s %10zu %10zu %14.2f %14.2f %7.2fx\n", file.c_str(), tokens.size(), mutations,
+               sequentialSeconds * 1e3, parallelSeconds * 1e3,
+               parallelSeconds > 0 ? sequentialSeconds / parallelSeconds : 0.0);
+    }
+    return status;
+}
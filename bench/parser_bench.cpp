@@ -0,0 +1,375 @@
+// Phase benchmark: for each input reports lexing throughput (tokens/sec),
+// parsing throughput (tree nodes/sec), Graphviz writing throughput (MB/s)
+// and the peak resident set size, each phase measured on its own. Results
+// can be saved as a JSON baseline and later runs compared against it; a
+// phase slower (or an RSS larger) than the baseline by more than the
+// threshold fails the run.
+//
+// Usage: parser_bench [--runs=N] [--threshold=PERCENT] [--baseline=FILE]
+//                     [--save-baseline=FILE] <input_file>...
+//
+// Every input is measured in a forked child so that its peak RSS is not
+// inflated by the inputs before it.
+
+#include "GraphvizWriter.h"
+#include "InputBuffer.h"
+#include "Parser.h"
+#include "TokenBuffer.h"
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Measured in the child and sent to the parent through a pipe
+struct PhaseResult {
+    int ok;
+    size_t tokens;
+    size_t nodes;
+    size_t dotBytes;
+    double lexSeconds;      // Best of the runs
+    double parseSeconds;
+    double dotSeconds;
+};
+
+// Metric names, in report and JSON order. Throughputs must not drop below
+// the baseline, RSS must not rise above it.
+static const char* const METRICS[] = {"lex_tokens_per_sec", "parse_nodes_per_sec", "dot_mb_per_sec",
+                                      "peak_rss_kb"};
+static const int METRIC_COUNT = 4;
+
+typedef map<string, map<string, double>> Results;
+
+static double seconds(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static size_t countNodes(const ParseTreeNode* root) {
+    size_t count = 0;
+    vector<const ParseTreeNode*> stack;
+    if (root) {
+        stack.push_back(root);
+    }
+    while (!stack.empty()) {
+        const ParseTreeNode* node = stack.back();
+        stack.pop_back();
+        count++;
+        for (const ParseTreeNode* child = node->firstChild; child; child = child->nextSibling) {
+            stack.push_back(child);
+        }
+    }
+    return count;
+}
+
+// Run every phase runs times on one input
+static PhaseResult measure(const string& file, int runs, const string& dotPath) {
+    PhaseResult result = {0, 0, 0, 0, 1e30, 1e30, 1e30};
+    InputBuffer input;
+    if (!input.mapFile(file)) {
+        fprintf(stderr, "Error: Cannot read file '%s'\n", file.c_str());
+        return result;
+    }
+
+    for (int run = 0; run < runs; run++) {
+        auto start = chrono::steady_clock::now();
+        TokenBuffer tokens;
+        if (!tokens.tokenize(input, DEFAULT_LEXER_BACKEND, false)) {
+            fprintf(stderr, "Error: '%s' is too large\n", file.c_str());
+            return result;
+        }
+        result.lexSeconds = min(result.lexSeconds, seconds(start));
+        result.tokens = tokens.size();
+
+        start = chrono::steady_clock::now();
+        Parser parser(tokens);
+        ParseTreeNode* tree = parser.parse();
+        result.parseSeconds = min(result.parseSeconds, seconds(start));
+        if (!tree) {
+            fprintf(stderr, "Error: %s: %s\n", file.c_str(), parser.getErrorMessage().c_str());
+            return result;
+        }
+        result.nodes = countNodes(tree);
+
+        start = chrono::steady_clock::now();
+        if (!writeGraphviz(tree, parser.getSymbols(), dotPath)) {
+            fprintf(stderr, "Error: Cannot write '%s'\n", dotPath.c_str());
+            return result;
+        }
+        result.dotSeconds = min(result.dotSeconds, seconds(start));
+    }
+
+    struct stat info;
+    if (stat(dotPath.c_str(), &info) == 0) {
+        result.dotBytes = static_cast<size_t>(info.st_size);
+    }
+    result.ok = 1;
+    return result;
+}
+
+// Measure one input in a child process. Returns false if it failed.
+static bool runChild(const string& file, int runs, map<string, double>& metrics) {
+    char dotPath[] = "/tmp/parser_bench_XXXXXX";
+    int dotFd = mkstemp(dotPath);
+    int fds[2];
+    if (dotFd < 0 || pipe(fds) != 0) {
+        perror("parser_bench");
+        return false;
+    }
+    close(dotFd);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        PhaseResult r = measure(file, runs, dotPath);
+        ssize_t written = write(fds[1], &r, sizeof(r));
+        _exit(written == static_cast<ssize_t>(sizeof(r)) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    PhaseResult r;
+    bool received = read(fds[0], &r, sizeof(r)) == static_cast<ssize_t>(sizeof(r));
+    close(fds[0]);
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    unlink(dotPath);
+    if (!received || !r.ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return false;
+    }
+
+    metrics[METRICS[0]] = r.tokens / r.lexSeconds;
+    metrics[METRICS[1]] = r.nodes / r.parseSeconds;
+    metrics[METRICS[2]] = r.dotBytes / r.dotSeconds / (1024.0 * 1024.0);
+    metrics[METRICS[3]] = static_cast<double>(usage.ru_maxrss);  // Kilobytes on Linux
+
+    printf("%-28s %10zu %12.0f %10zu %12.0f %10.1f %10ld\n", file.c_str(), r.tokens, metrics[METRICS[0]],
+           r.nodes, metrics[METRICS[1]], metrics[METRICS[2]], usage.ru_maxrss);
+    return true;
+}
+
+// Key used in the baseline: the file name without directory
+static string corpusName(const string& file) {
+    size_t slash = file.rfind('/');
+    return slash == string::npos ? file : file.substr(slash + 1);
+}
+
+static bool saveBaseline(const string& path, const Results& results) {
+    FILE* out = fopen(path.c_str(), "w");
+    if (!out) {
+        return false;
+    }
+    fprintf(out, "{\n  \"version\": 1,\n  \"results\": {");
+    const char* separator = "\n";
+    for (const auto& corpus : results) {
+        fprintf(out, "%s    \"%s\": {", separator, corpus.first.c_str());
+        for (int i = 0; i < METRIC_COUNT; i++) {
+            fprintf(out, "%s\n      \"%s\": %.1f", i ? "," : "", METRICS[i], corpus.second.at(METRICS[i]));
+        }
+        fprintf(out, "\n    }");
+        separator = ",\n";
+    }
+    fprintf(out, "\n  }\n}\n");
+    return fclose(out) == 0;
+}
+
+/*
+ * Reader for the baseline files written above: objects, strings without
+ * escapes and numbers. Only results.<corpus>.<metric> numbers are kept;
+ * other top-level members such as the version are skipped.
+ */
+class BaselineReader {
+public:
+    explicit BaselineReader(const string& t) : text(t), pos(0) {}
+
+    bool read(Results& results) {
+        return object(results, "", 0) && (skipSpace(), pos == text.size());
+    }
+
+private:
+    const string& text;
+    size_t pos;
+
+    void skipSpace() {
+        while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos]))) {
+            pos++;
+        }
+    }
+
+    bool literal(char c) {
+        skipSpace();
+        if (pos < text.size() && text[pos] == c) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    bool str(string& out) {
+        if (!literal('"')) {
+            return false;
+        }
+        size_t end = text.find('"', pos);
+        if (end == string::npos) {
+            return false;
+        }
+        out = text.substr(pos, end - pos);
+        pos = end + 1;
+        return true;
+    }
+
+    // depth 0 is the top level, 1 the results object, 2 one corpus
+    bool object(Results& results, const string& corpus, int depth) {
+        if (!literal('{')) {
+            return false;
+        }
+        if (literal('}')) {
+            return true;
+        }
+        do {
+            string key;
+            if (!str(key) || !literal(':')) {
+                return false;
+            }
+            skipSpace();
+            if (pos < text.size() && text[pos] == '{') {
+                if (depth >= 2 || !object(results, depth == 1 ? key : corpus, depth + 1)) {
+                    return false;
+                }
+            } else {
+                char* end;
+                double value = strtod(text.c_str() + pos, &end);
+                if (end == text.c_str() + pos) {
+                    return false;
+                }
+                pos = end - text.c_str();
+                if (depth == 2) {
+                    results[corpus][key] = value;
+                }
+            }
+        } while (literal(','));
+        return literal('}');
+    }
+};
+
+static bool loadBaseline(const string& path, Results& results) {
+    FILE* in = fopen(path.c_str(), "r");
+    if (!in) {
+        return false;
+    }
+    string text;
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+        text.append(chunk, n);
+    }
+    fclose(in);
+    BaselineReader reader(text);
+    if (!reader.read(results)) {
+        fprintf(stderr, "Error: Malformed baseline '%s'\n", path.c_str());
+        exit(1);
+    }
+    return true;
+}
+
+// Print every metric that regressed past threshold (a fraction). Returns
+// the number of regressions.
+static int compare(const Results& results, const Results& baseline, double threshold) {
+    int regressions = 0;
+    for (const auto& corpus : results) {
+        auto base = baseline.find(corpus.first);
+        if (base == baseline.end()) {
+            printf("%s: not in baseline\n", corpus.first.c_str());
+            continue;
+        }
+        for (int i = 0; i < METRIC_COUNT; i++) {
+            auto expected = base->second.find(METRICS[i]);
+            if (expected == base->second.end() || expected->second <= 0) {
+                continue;
+            }
+            double actual = corpus.second.at(METRICS[i]);
+            double change = (actual - expected->second) / expected->second;
+            bool lowerIsBetter = i == METRIC_COUNT - 1;
+            if (lowerIsBetter ? change > threshold : change < -threshold) {
+                printf("REGRESSION %s %s: %.1f vs baseline %.1f (%+.1f%%)\n", corpus.first.c_str(), METRICS[i],
+                       actual, expected->second, change * 100);
+                regressions++;
+            }
+        }
+    }
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    int runs = 3;
+    double threshold = 10;
+    string baselinePath;
+    string savePath;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--runs=", 7) == 0) {
+            runs = atoi(argv[i] + 7);
+        } else if (strncmp(argv[i], "--threshold=", 12) == 0) {
+            threshold = atof(argv[i] + 12);
+        } else if (strncmp(argv[i], "--baseline=", 11) == 0) {
+            baselinePath = argv[i] + 11;
+        } else if (strncmp(argv[i], "--save-baseline=", 16) == 0) {
+            savePath = argv[i] + 16;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty() || runs < 1) {
+        fprintf(stderr,
+                "Usage: %s [--runs=N] [--threshold=PERCENT] [--baseline=FILE] [--save-baseline=FILE] "
+                "<input_file>...\n",
+                argv[0]);
+        return 1;
+    }
+
+    printf("%-28s %10s %12s %10s %12s %10s %10s\n", "input", "tokens", "tokens/s", "nodes", "nodes/s",
+           "dot MB/s", "RSS KB");
+    Results results;
+    int status = 0;
+    for (const string& file : files) {
+        map<string, double> metrics;
+        if (!runChild(file, runs, metrics)) {
+            fprintf(stderr, "FAILED %s\n", file.c_str());
+            status = 1;
+            continue;
+        }
+        results[corpusName(file)] = metrics;
+    }
+
+    if (!baselinePath.empty()) {
+        Results baseline;
+        if (!loadBaseline(baselinePath, baseline)) {
+            printf("No baseline at '%s'; run with --save-baseline to create one\n", baselinePath.c_str());
+        } else if (compare(results, baseline, threshold / 100) > 0) {
+            status = 1;
+        } else {
+            printf("No phase regressed more than %.0f%% against '%s'\n", threshold, baselinePath.c_str());
+        }
+    }
+
+    if (!savePath.empty()) {
+        if (!saveBaseline(savePath, results)) {
+            fprintf(stderr, "Error: Cannot write baseline '%s'\n", savePath.c_str());
+            return 1;
+        }
+        printf("Baseline saved to '%s'\n", savePath.c_str());
+    }
+    return status;
+}
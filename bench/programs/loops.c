@@ -0,0 +1,23 @@
+Program Loops {
+    int i;
+    int j;
+    int x;
+    int sum;
+    int n;
+
+    n = 2000
+    sum = 0
+    i = 0
+    while (i < n) {
+        j = 0
+        while (j < n) {
+            x = 1
+            while (x < 100) {
+                x = x * 2
+            }
+            sum = sum + (i * j - x) / 3
+            j = j + 1
+        }
+        i = i + 1
+    }
+}.
@@ -0,0 +1,32 @@
+Program Numeric {
+    float x;
+    float h;
+    float area;
+    float root;
+    float next;
+    int i;
+    int n;
+    int k;
+
+    n = 2000000
+    h = 1.0 / n
+    area = 0
+    i = 0
+    while (i < n) {
+        x = (i + 0.5) * h
+        area = area + 4.0 / (1.0 + x * x) * h
+        i = i + 1
+    }
+
+    k = 1
+    root = 0
+    while (k <= 200000) {
+        root = k
+        next = (root + k / root) / 2
+        while (root - next > 0.000001) {
+            root = next
+            next = (root + k / root) / 2
+        }
+        k = k + 1
+    }
+}.
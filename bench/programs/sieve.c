@@ -0,0 +1,32 @@
+Program Sieve {
+    int flags[1000000];
+    int n;
+    int i;
+    int j;
+    int count;
+    int pass;
+
+    n = 1000000
+    pass = 0
+    while (pass < 3) {
+        i = 0
+        while (i < n) {
+            flags[i] = 1
+            i = i + 1
+        }
+        count = 0
+        i = 2
+        while (i < n) {
+            if (flags[i] == 1) {
+                count = count + 1
+                j = i + i
+                while (j < n) {
+                    flags[j] = 0
+                    j = j + i
+                }
+            }
+            i = i + 1
+        }
+        pass = pass + 1
+    }
+}.
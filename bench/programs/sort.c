@@ -0,0 +1,41 @@
+Program Sort {
+    int a[3000];
+    int n;
+    int i;
+    int j;
+    int t;
+    int seed;
+    int sorted;
+
+    n = 3000
+    seed = 12345
+    i = 0
+    while (i < n) {
+        seed = (seed * 1103515245 + 12345) - (seed * 1103515245 + 12345) / 2147483648 * 2147483648
+        a[i] = seed / 65536
+        i = i + 1
+    }
+
+    i = 0
+    while (i < n - 1) {
+        j = 0
+        while (j < n - 1 - i) {
+            if (a[j] > a[j + 1]) {
+                t = a[j]
+                a[j] = a[j + 1]
+                a[j + 1] = t
+            }
+            j = j + 1
+        }
+        i = i + 1
+    }
+
+    sorted = 1
+    i = 1
+    while (i < n) {
+        if (a[i - 1] > a[i]) {
+            sorted = 0
+        }
+        i = i + 1
+    }
+}.
@@ -0,0 +1,284 @@
+// Semantic check and benchmark: parses each input and runs SemanticChecker
+// on it, and on copies with random declarations blanked out (so uses go
+// undeclared), and compares every diagnostic with a straightforward
+// reference: a walk of the pointer tree with the declarations in
+// an unordered_map keyed by name, the way a script over the tree would do
+// it. Prints the best times of the runs for the reference, the checker on
+// a flat tree it is given, and the checker including flattening, and exits
+// 1 on any mismatch.
+//
+// Usage: semantic_bench [--runs=N] [--mutations=N] [--seed=N] <input_file>...
+
+#include "BenchCommon.h"
+#include "InputBuffer.h"
+#include "Parser.h"
+#include "Semantic.h"
+#include "TokenBuffer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// The reference checker; same rules and messages as SemanticChecker
+class ReferenceChecker {
+public:
+    ReferenceChecker(const StringInterner& s, const TokenBuffer& t) : symbols(s), tokens(t), token(0) {}
+
+    vector<string> run(const ParseTreeNode* root) {
+        visit(root);
+        return messages;
+    }
+
+private:
+    struct Declaration {
+        bool isFloat;
+        uint64_t arraySize;
+        size_t token;
+    };
+
+    const StringInterner& symbols;
+    const TokenBuffer& tokens;
+    unordered_map<string, Declaration> declared;
+    vector<string> messages;
+    size_t token;
+
+    string text(const ParseTreeNode* terminal) const { return string(symbols.str(terminal->symbol)); }
+
+    void report(size_t at, const string& message) {
+        long long line, col;
+        tokens.position(at, line, col);
+        messages.push_back("SEMANTIC ERROR at Line " + to_string(line) + ", Col " + to_string(col) + ": " +
+                           message);
+    }
+
+    static bool isInteger(const string& s) {
+        return !s.empty() && s.size() <= 10 && s.find_first_not_of("0123456789") == string::npos &&
+               stoull(s) <= UINT32_MAX;
+    }
+
+    static void terminals(const ParseTreeNode* node, vector<const ParseTreeNode*>& out) {
+        if (node->kind == NODE_TERMINAL) {
+            out.push_back(node);
+        }
+        for (const ParseTreeNode* child = node->firstChild; child; child = child->nextSibling) {
+            terminals(child, out);
+        }
+    }
+
+    void declaration(const ParseTreeNode* node) {
+        const ParseTreeNode* keyword = node->firstChild->firstChild;
+        const ParseTreeNode* id = node->firstChild->nextSibling;
+        const ParseTreeNode* bracket = id->nextSibling->firstChild;
+        string name = text(id);
+        auto it = declared.find(name);
+        if (it != declared.end()) {
+            long long line, col;
+            tokens.position(it->second.token, line, col);
+            report(token + 1, "'" + name + "' is already declared at Line " + to_string(line));
+            return;
+        }
+        Declaration d{keyword->tokenType() == FLOAT, 0, token + 1};
+        if (bracket->tokenType() == LBRACKET) {
+            string size = text(bracket->nextSibling);
+            if (!isInteger(size) || stoull(size) == 0) {
+                report(token + 3, "size of array '" + name + "' must be a positive integer, not " + size);
+                d.arraySize = UINT32_MAX;
+            } else {
+                d.arraySize = stoull(size);
+            }
+        }
+        declared[name] = d;
+    }
+
+    void use(const ParseTreeNode* node) {
+        const ParseTreeNode* id = node->firstChild;
+        const ParseTreeNode* first = id->nextSibling->firstChild;
+        string name = text(id);
+        auto it = declared.find(name);
+        if (it == declared.end()) {
+            report(token, "'" + name + "' is not declared");
+            return;
+        }
+        const Declaration& d = it->second;
+        if (first->kind != NODE_TERMINAL) {
+            if (d.arraySize != 0) {
+                report(token, "array '" + name + "' is used without an index");
+            }
+            return;
+        }
+        if (d.arraySize == 0) {
+            report(token, "'" + name + "' is not an array");
+            return;
+        }
+        vector<const ParseTreeNode*> index;
+        terminals(first->nextSibling, index);
+        if (index.size() != 1 || index[0]->tokenType() != NUM) {
+            return;
+        }
+        string value = text(index[0]);
+        if (!isInteger(value)) {
+            report(token + 2, "index " + value + " of '" + name + "' is not an integer");
+        } else if (d.arraySize != UINT32_MAX && stoull(value) >= d.arraySize) {
+            report(token + 2, "index " + value + " is out of bounds for array '" + name + "' of size " +
+                                  to_string(d.arraySize));
+        }
+    }
+
+    // Preorder, with an explicit stack: the ' chains nest as deep as the
+    // lists are long
+    void visit(const ParseTreeNode* root) {
+        vector<const ParseTreeNode*> stack;
+        stack.push_back(root);
+        while (!stack.empty()) {
+            const ParseTreeNode* node = stack.back();
+            stack.pop_back();
+            if (!node) {
+                continue;
+            }
+            if (node->kind == NODE_TERMINAL) {
+                token++;
+            } else if (node->kind == NODE_NONTERMINAL && node->rule == RULE_VAR_DECLARATION) {
+                declaration(node);
+            } else if (node->kind == NODE_NONTERMINAL && node->rule == RULE_VAR) {
+                use(node);
+            }
+            stack.push_back(node->nextSibling);
+            stack.push_back(node->firstChild);
+        }
+    }
+};
+
+static bool sameDiagnostics(const SemanticChecker& checker, const vector<string>& expected) {
+    if (checker.getDiagnostics().size() != expected.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (checker.getDiagnostics()[i].message != expected[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Parse input and compare the checker with the reference; false on a
+// mismatch, and skipped (true) if the input does not parse
+static bool sameResult(const InputBuffer& input, SemanticChecker& checker, size_t& errors) {
+    TokenBuffer tokens;
+    tokens.tokenize(input, DEFAULT_LEXER_BACKEND, false);
+    Parser parser(tokens);
+    ParseTreeNode* root = parser.parse();
+    if (!root) {
+        return true;
+    }
+    checker.check(root, parser.getSymbols(), &tokens);
+    ReferenceChecker reference(parser.getSymbols(), tokens);
+    vector<string> expected = reference.run(root);
+    errors = expected.size();
+    return sameDiagnostics(checker, expected);
+}
+
+int main(int argc, char** argv) {
+    unsigned runs = 5;
+    size_t mutationCount = 20;
+    unsigned seed = 1;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--runs=", 7) == 0) {
+            runs = max(1u, static_cast<unsigned>(strtoul(argv[i] + 7, nullptr, 10)));
+        } else if (strncmp(argv[i], "--mutations=", 12) == 0) {
+            mutationCount = strtoul(argv[i] + 12, nullptr, 10);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            seed = static_cast<unsigned>(strtoul(argv[i] + 7, nullptr, 10));
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        fprintf(stderr, "Usage: %s [--runs=N] [--mutations=N] [--seed=N] <input_file>...\n", argv[0]);
+        return 1;
+    }
+
+    int status = 0;
+    SemanticChecker checker;
+    printf("%-28s %8s %8s %8s %16s %12s %10s %10s\n", "file", "decls", "uses", "errors", "mutation errors",
+           "reference ms", "flat ms", "check ms");
+    for (const string& file : files) {
+        InputBuffer input;
+        if (!readInput(file, input)) {
+            return 1;
+        }
+
+        TokenBuffer tokens;
+        tokens.tokenize(input, DEFAULT_LEXER_BACKEND, false);
+        Parser parser(tokens);
+        ParseTreeNode* root = parser.parse();
+        if (!root) {
+            printf("%-28s %8s\n", file.c_str(), "(syntax error)");
+            continue;
+        }
+
+        size_t errors = 0;
+        if (!sameResult(input, checker, errors)) {
+            fprintf(stderr, "MISMATCH %s\n", file.c_str());
+            status = 1;
+        }
+
+        // Blank out random declarations (the type keyword through the
+        // ";"), keeping at least one, so their uses are reported. Large
+        // inputs get fewer mutations, since each one reparses the file.
+        vector<size_t> declarations;
+        for (size_t i = 0; i < tokens.size(); i++) {
+            if (tokens.type(i) == INT || tokens.type(i) == FLOAT) {
+                declarations.push_back(i);
+            }
+        }
+        mt19937 rng(seed);
+        size_t mutations = declarations.size() > 1
+                               ? min(mutationCount, max<size_t>(1, 20000000 / (input.size() + 1)))
+                               : 0;
+        size_t mismatches = 0;
+        size_t mutatedErrors = 0;
+        for (size_t n = 0; n < mutations; n++) {
+            string text(input.data(), input.size());
+            size_t drop = 1 + rng() % min<size_t>(8, declarations.size() - 1);
+            for (size_t k = 0; k < drop; k++) {
+                size_t first = declarations[1 + rng() % (declarations.size() - 1)];
+                size_t last = first;
+                while (tokens.type(last) != SEMI) {
+                    last++;
+                }
+                size_t begin = tokens.offset(first);
+                size_t end = tokens.offset(last) + tokens.length(last);
+                text.replace(begin, end - begin, end - begin, ' ');
+            }
+            InputBuffer mutated;
+            mutated.copy(text.data(), text.size());
+            size_t found = 0;
+            if (!sameResult(mutated, checker, found)) {
+                if (mismatches == 0) {
+                    fprintf(stderr, "MISMATCH %s: mutation %zu\n", file.c_str(), n);
+                }
+                mismatches++;
+                status = 1;
+            }
+            mutatedErrors += found;
+        }
+
+        FlatTree tree;
+        tree.build(root);
+        double referenceSeconds = bestSeconds(runs, [&] {
+            ReferenceChecker reference(parser.getSymbols(), tokens);
+            reference.run(root);
+        });
+        double flatSeconds = bestSeconds(runs, [&] { checker.check(tree, parser.getSymbols(), &tokens); });
+        double checkSeconds = bestSeconds(runs, [&] { checker.check(root, parser.getSymbols(), &tokens); });
+        printf("%-28s %8zu %8zu %8zu %16zu %12.2f %10.2f %10.2f\n", file.c_str(), checker.declarations(),
+               checker.uses(), errors, mutatedErrors, referenceSeconds * 1e3, flatSeconds * 1e3, checkSeconds * 1e3);
+    }
+    return status;
+}
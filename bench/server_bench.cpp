@@ -0,0 +1,244 @@
+// Parse server check and benchmark: starts "parser --serve" on a pair of
+// pipes and sends it each input, checking the response status against the
+// exit code of "parser --emit=bin" run on the same file, and the returned
+// tree bytes against the .ptree file it writes. Then times requests to the
+// server against starting a parser process per file (the way an editor or
+// build tool without the server runs it) and prints p50/p99 latencies.
+//
+// Usage: server_bench [--parser=PATH] [--requests=N] [--jobs=N] <input_file>...
+
+#include "Server.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+extern char** environ;
+
+static bool readFully(int fd, void* buffer, size_t size) {
+    char* p = static_cast<char*>(buffer);
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool writeFully(int fd, const void* buffer, size_t size) {
+    const char* p = static_cast<const char*>(buffer);
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+struct Response {
+    ServerResponse header;
+    string diagnostics;
+    string tree;
+};
+
+// A running "parser --serve" and the two ends of its pipes
+struct ServerProcess {
+    pid_t pid = -1;
+    int requests = -1;
+    int responses = -1;
+
+    bool start(const string& parser, unsigned jobs) {
+        int toServer[2];
+        int fromServer[2];
+        if (pipe(toServer) != 0 || pipe(fromServer) != 0) {
+            return false;
+        }
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, toServer[0], 0);
+        posix_spawn_file_actions_adddup2(&actions, fromServer[1], 1);
+        posix_spawn_file_actions_addclose(&actions, toServer[1]);
+        posix_spawn_file_actions_addclose(&actions, fromServer[0]);
+        string jobsArg = "--jobs=" + to_string(jobs);
+        char* argv[] = {const_cast<char*>(parser.c_str()), const_cast<char*>("--serve"),
+                        const_cast<char*>(jobsArg.c_str()), nullptr};
+        int error = posix_spawn(&pid, parser.c_str(), &actions, nullptr, argv, environ);
+        posix_spawn_file_actions_destroy(&actions);
+        close(toServer[0]);
+        close(fromServer[1]);
+        requests = toServer[1];
+        responses = fromServer[0];
+        return error == 0;
+    }
+
+    bool request(uint32_t id, uint32_t flags, const string& source, Response& response) {
+        ServerRequest header;
+        header.magic = SERVER_REQUEST_MAGIC;
+        header.id = id;
+        header.flags = flags;
+        header.maxErrors = 1;
+        header.sourceSize = static_cast<uint32_t>(source.size());
+        if (!writeFully(requests, &header, sizeof(header)) || !writeFully(requests, source.data(), source.size()) ||
+            !readFully(responses, &response.header, sizeof(response.header)) ||
+            response.header.magic != SERVER_RESPONSE_MAGIC || response.header.id != id) {
+            return false;
+        }
+        response.diagnostics.resize(response.header.diagnosticsSize);
+        response.tree.resize(response.header.treeSize);
+        return readFully(responses, &response.diagnostics[0], response.diagnostics.size()) &&
+               readFully(responses, &response.tree[0], response.tree.size());
+    }
+
+    // Closing the request pipe ends the server
+    int stop() {
+        close(requests);
+        close(responses);
+        int status = 0;
+        waitpid(pid, &status, 0);
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+};
+
+// Run "parser --emit=bin file output" with its console output discarded;
+// returns the exit code
+static int runProcess(const string& parser, const string& file, const string& output) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+    char* argv[] = {const_cast<char*>(parser.c_str()), const_cast<char*>("--emit=bin"),
+                    const_cast<char*>(file.c_str()), const_cast<char*>(output.c_str()), nullptr};
+    pid_t pid;
+    int error = posix_spawn(&pid, parser.c_str(), &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (error != 0) {
+        return -1;
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static bool readFile(const string& file, string& text) {
+    ifstream stream(file, ios::binary);
+    if (!stream) {
+        return false;
+    }
+    text.assign(istreambuf_iterator<char>(stream), istreambuf_iterator<char>());
+    return true;
+}
+
+static double percentile(vector<double> samples, double p) {
+    sort(samples.begin(), samples.end());
+    size_t index = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+    return samples[index];
+}
+
+int main(int argc, char** argv) {
+    string parser = "./parser";
+    size_t requestCount = 200;
+    unsigned jobs = 1;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--parser=", 9) == 0) {
+            parser = argv[i] + 9;
+        } else if (strncmp(argv[i], "--requests=", 11) == 0) {
+            requestCount = strtoul(argv[i] + 11, nullptr, 10);
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            jobs = static_cast<unsigned>(strtoul(argv[i] + 7, nullptr, 10));
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty() || requestCount == 0) {
+        fprintf(stderr, "Usage: %s [--parser=PATH] [--requests=N] [--jobs=N] <input_file>...\n", argv[0]);
+        return 1;
+    }
+
+    vector<string> texts(files.size());
+    for (size_t f = 0; f < files.size(); f++) {
+        if (!readFile(files[f], texts[f])) {
+            fprintf(stderr, "Error: Cannot read file '%s'\n", files[f].c_str());
+            return 1;
+        }
+    }
+
+    char directory[] = "/tmp/server_benchXXXXXX";
+    if (!mkdtemp(directory)) {
+        fprintf(stderr, "Error: Cannot create a temporary directory\n");
+        return 1;
+    }
+    string output = string(directory) + "/tree.ptree";
+
+    ServerProcess server;
+    if (!server.start(parser, jobs)) {
+        fprintf(stderr, "Error: Cannot start '%s --serve'\n", parser.c_str());
+        return 1;
+    }
+
+    // Check: same verdict and the same tree bytes as the command line
+    int status = 0;
+    uint32_t id = 0;
+    Response response;
+    for (size_t f = 0; f < files.size(); f++) {
+        unlink(output.c_str());
+        int exitCode = runProcess(parser, files[f], output);
+        string expectedTree;
+        readFile(output, expectedTree);
+        if (!server.request(++id, SERVER_SEND_TREE, texts[f], response)) {
+            fprintf(stderr, "Error: Server did not answer request %u\n", id);
+            server.stop();
+            return 1;
+        }
+        bool ok = response.header.status == SERVER_OK;
+        if (ok != (exitCode == 0) || (ok && response.tree != expectedTree)) {
+            fprintf(stderr, "MISMATCH %s: server status %u, exit code %d\n", files[f].c_str(),
+                    response.header.status, exitCode);
+            status = 1;
+        }
+    }
+
+    // Time both ways round robin, so they see the same mix of inputs
+    vector<double> serverSamples;
+    vector<double> processSamples;
+    for (size_t n = 0; n < requestCount; n++) {
+        size_t f = n % files.size();
+        auto start = chrono::steady_clock::now();
+        server.request(++id, SERVER_SEND_TREE, texts[f], response);
+        serverSamples.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+
+        start = chrono::steady_clock::now();
+        runProcess(parser, files[f], output);
+        processSamples.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    if (server.stop() != 0) {
+        fprintf(stderr, "Error: Server exited with an error\n");
+        status = 1;
+    }
+    unlink(output.c_str());
+    rmdir(directory);
+
+    printf("%-20s %10s %10s %10s\n", "mode", "requests", "p50 us", "p99 us");
+    printf("%-20s %10zu %10.1f %10.1f\n", "server", serverSamples.size(), percentile(serverSamples, 0.5) * 1e6,
+           percentile(serverSamples, 0.99) * 1e6);
+    printf("%-20s %10zu %10.1f %10.1f\n", "process per file", processSamples.size(),
+           percentile(processSamples, 0.5) * 1e6, percentile(processSamples, 0.99) * 1e6);
+    return status;
+}
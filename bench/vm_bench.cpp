@@ -0,0 +1,348 @@
+// Bytecode check and benchmark: compiles each input with BytecodeCompiler,
+// runs it in the Interpreter, and compares the final value of every
+// variable and array element, bit for bit, with a straightforward
+// reference: an evaluator that walks the pointer tree and keeps each
+// variable in a map keyed by name, with the same typing rules. Prints the
+// instructions executed and the best times of the runs for the
+// interpreter and the reference, and exits 1 on any mismatch.
+//
+// Inputs should terminate: nothing bounds the reference's loops.
+//
+// Usage: vm_bench [--runs=N] <input_file>...
+
+#include "BenchCommon.h"
+#include "Bytecode.h"
+#include "InputBuffer.h"
+#include "Interpreter.h"
+#include "Parser.h"
+#include "TokenBuffer.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// The reference evaluator
+class TreeWalker {
+public:
+    struct Variable {
+        bool isFloat;
+        bool isArray;
+        Value value;
+        vector<Value> elements;
+    };
+
+    explicit TreeWalker(const StringInterner& s) : symbols(s) {}
+
+    // False on a runtime error
+    bool run(const ParseTreeNode* root) {
+        variables.clear();
+        order.clear();
+        try {
+            for (const ParseTreeNode* child = root->firstChild; child; child = child->nextSibling) {
+                if (child->kind != NODE_NONTERMINAL) {
+                    continue;
+                }
+                if (child->rule == RULE_DECLARATION_LIST) {
+                    forEach(child, RULE_DECLARATION_LIST_PRIME,
+                            [this](const ParseTreeNode* d) { declare(d->firstChild); });
+                } else if (child->rule == RULE_STATEMENT_LIST) {
+                    forEach(child, RULE_STATEMENT_LIST_PRIME, [this](const ParseTreeNode* s) { statement(s); });
+                }
+            }
+        } catch (const RuntimeError&) {
+            return false;
+        }
+        return true;
+    }
+
+    // Variables in declaration order
+    const Variable& variable(size_t i) const { return variables.at(order[i]); }
+
+private:
+    struct Typed {
+        Value value;
+        bool isFloat;
+    };
+    struct RuntimeError {};
+
+    const StringInterner& symbols;
+    unordered_map<string, Variable> variables;
+    vector<string> order;
+
+    string text(const ParseTreeNode* terminal) const { return string(symbols.str(terminal->symbol)); }
+
+    template <typename Visit>
+    static void forEach(const ParseTreeNode* owner, RuleId prime, Visit visit) {
+        const ParseTreeNode* child = owner->firstChild;
+        while (child) {
+            if (child->kind == NODE_NONTERMINAL && child->rule == prime) {
+                child = child->firstChild;
+                continue;
+            }
+            if (child->kind != NODE_EPSILON) {
+                visit(child);
+            }
+            child = child->nextSibling;
+        }
+    }
+
+    // var-declaration ::= type-specifier ID var-declaration'
+    void declare(const ParseTreeNode* node) {
+        const ParseTreeNode* id = node->firstChild->nextSibling;
+        const ParseTreeNode* bracket = id->nextSibling->firstChild;
+        Variable v;
+        v.isFloat = node->firstChild->firstChild->tokenType() == FLOAT;
+        v.isArray = bracket->tokenType() == LBRACKET;
+        v.value.i = 0;
+        if (v.isArray) {
+            Value zero;
+            zero.i = 0;
+            v.elements.assign(stoull(text(bracket->nextSibling)), zero);
+        }
+        order.push_back(text(id));
+        variables[order.back()] = v;
+    }
+
+    void statement(const ParseTreeNode* node) {
+        const ParseTreeNode* child = node->firstChild;
+        if (child->rule == RULE_ASSIGNMENT_STMT) {
+            assign(child->firstChild, evaluate(child->firstChild->nextSibling->nextSibling));
+        } else if (child->rule == RULE_COMPOUND_STMT) {
+            forEach(child->firstChild->nextSibling, RULE_STATEMENT_LIST_PRIME,
+                    [this](const ParseTreeNode* s) { statement(s); });
+        } else if (child->rule == RULE_SELECTION_STMT) {
+            const ParseTreeNode* condition = child->firstChild->nextSibling->nextSibling;
+            const ParseTreeNode* thenStmt = condition->nextSibling->nextSibling;
+            const ParseTreeNode* elsePart = thenStmt->nextSibling->firstChild;
+            if (truth(evaluate(condition))) {
+                statement(thenStmt);
+            } else if (elsePart->kind == NODE_TERMINAL) {
+                statement(elsePart->nextSibling);
+            }
+        } else {
+            const ParseTreeNode* condition = child->firstChild->nextSibling->nextSibling;
+            const ParseTreeNode* body = condition->nextSibling->nextSibling;
+            while (truth(evaluate(condition))) {
+                statement(body);
+            }
+        }
+    }
+
+    static bool truth(Typed x) { return x.isFloat ? x.value.f != 0.0 : x.value.i != 0; }
+
+    static int64_t toInt(double f) {
+        if (!(f >= -9223372036854775808.0 && f < 9223372036854775808.0)) {
+            throw RuntimeError();
+        }
+        return static_cast<int64_t>(f);
+    }
+
+    // The variable, and the element for an indexed var
+    Value& location(const ParseTreeNode* var) {
+        Variable& v = variables.at(text(var->firstChild));
+        const ParseTreeNode* bracket = var->firstChild->nextSibling->firstChild;
+        if (bracket->kind != NODE_TERMINAL) {
+            return v.value;
+        }
+        int64_t index = evaluate(bracket->nextSibling).value.i;
+        if (index < 0 || static_cast<uint64_t>(index) >= v.elements.size()) {
+            throw RuntimeError();
+        }
+        return v.elements[index];
+    }
+
+    void assign(const ParseTreeNode* var, Typed x) {
+        bool isFloat = variables.at(text(var->firstChild)).isFloat;
+        Value& target = location(var);
+        if (isFloat) {
+            target.f = x.isFloat ? x.value.f : static_cast<double>(x.value.i);
+        } else {
+            target.i = x.isFloat ? toInt(x.value.f) : x.value.i;
+        }
+    }
+
+    static Typed apply(TokenType op, Typed x, Typed y) {
+        Typed r;
+        r.isFloat = false;
+        if (x.isFloat || y.isFloat) {
+            double a = x.isFloat ? x.value.f : static_cast<double>(x.value.i);
+            double b = y.isFloat ? y.value.f : static_cast<double>(y.value.i);
+            switch (op) {
+                case PLUS:   r.isFloat = true; r.value.f = a + b; break;
+                case MINUS:  r.isFloat = true; r.value.f = a - b; break;
+                case TIMES:  r.isFloat = true; r.value.f = a * b; break;
+                case DIVIDE: r.isFloat = true; r.value.f = a / b; break;
+                case LT:     r.value.i = a < b; break;
+                case LTE:    r.value.i = a <= b; break;
+                case GT:     r.value.i = a > b; break;
+                case GTE:    r.value.i = a >= b; break;
+                case EQ:     r.value.i = a == b; break;
+                default:     r.value.i = a != b; break;
+            }
+            return r;
+        }
+        uint64_t a = static_cast<uint64_t>(x.value.i);
+        uint64_t b = static_cast<uint64_t>(y.value.i);
+        switch (op) {
+            case PLUS:  r.value.i = static_cast<int64_t>(a + b); break;
+            case MINUS: r.value.i = static_cast<int64_t>(a - b); break;
+            case TIMES: r.value.i = static_cast<int64_t>(a * b); break;
+            case DIVIDE:
+                if (y.value.i == 0) {
+                    throw RuntimeError();
+                }
+                r.value.i = y.value.i == -1 ? static_cast<int64_t>(0 - a) : x.value.i / y.value.i;
+                break;
+            case LT:  r.value.i = x.value.i < y.value.i; break;
+            case LTE: r.value.i = x.value.i <= y.value.i; break;
+            case GT:  r.value.i = x.value.i > y.value.i; break;
+            case GTE: r.value.i = x.value.i >= y.value.i; break;
+            case EQ:  r.value.i = x.value.i == y.value.i; break;
+            default:  r.value.i = x.value.i != y.value.i; break;
+        }
+        return r;
+    }
+
+    // expression, additive-expression, term or factor
+    Typed evaluate(const ParseTreeNode* node) {
+        if (node->rule == RULE_FACTOR) {
+            return factor(node);
+        }
+        RuleId prime = node->rule == RULE_EXPRESSION            ? RULE_EXPRESSION_PRIME
+                       : node->rule == RULE_ADDITIVE_EXPRESSION ? RULE_ADDITIVE_EXPRESSION_PRIME
+                                                                : RULE_TERM_PRIME;
+        Typed result;
+        bool first = true;
+        TokenType op = ERROR;
+        forEach(node, prime, [&](const ParseTreeNode* element) {
+            if (element->rule == RULE_RELOP || element->rule == RULE_ADDOP || element->rule == RULE_MULOP) {
+                op = element->firstChild->tokenType();
+            } else if (first) {
+                result = evaluate(element);
+                first = false;
+            } else {
+                result = apply(op, result, evaluate(element));
+            }
+        });
+        return result;
+    }
+
+    Typed factor(const ParseTreeNode* node) {
+        const ParseTreeNode* child = node->firstChild;
+        Typed r;
+        if (child->kind != NODE_TERMINAL) {
+            r.isFloat = variables.at(text(child->firstChild)).isFloat;
+            r.value = location(child);
+            return r;
+        }
+        if (child->tokenType() != NUM) {
+            return evaluate(child->nextSibling);
+        }
+        string s = text(child);
+        if (s.find_first_not_of("0123456789") == string::npos) {
+            errno = 0;
+            r.value.i = strtoll(s.c_str(), nullptr, 10);
+            if (errno == 0) {
+                r.isFloat = false;
+                return r;
+            }
+        }
+        r.isFloat = true;
+        r.value.f = strtod(s.c_str(), nullptr);
+        return r;
+    }
+};
+
+static bool sameValue(Value a, Value b) {
+    return memcmp(&a, &b, sizeof(Value)) == 0;
+}
+
+// Whether the interpreter's final state matches the reference's
+static bool sameState(const BytecodeProgram& program, const Interpreter& interpreter, const TreeWalker& walker) {
+    for (size_t i = 0; i < program.variables.size(); i++) {
+        const VariableInfo& variable = program.variables[i];
+        const TreeWalker::Variable& expected = walker.variable(i);
+        if (!variable.isArray) {
+            if (!sameValue(interpreter.getFrame()[variable.slot], expected.value)) {
+                return false;
+            }
+            continue;
+        }
+        const ArrayInfo& array = program.arrays[variable.slot];
+        if (array.size != expected.elements.size()) {
+            return false;
+        }
+        for (uint32_t k = 0; k < array.size; k++) {
+            if (!sameValue(interpreter.getArrays()[array.base + k], expected.elements[k])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    unsigned runs = 3;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--runs=", 7) == 0) {
+            runs = max(1u, static_cast<unsigned>(strtoul(argv[i] + 7, nullptr, 10)));
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        fprintf(stderr, "Usage: %s [--runs=N] <input_file>...\n", argv[0]);
+        return 1;
+    }
+
+    int status = 0;
+    printf("%s dispatch\n", Interpreter::threaded() ? "Threaded" : "Switch");
+    printf("%-28s %8s %14s %10s %12s %12s %10s\n", "file", "code", "instructions", "vm ms", "M instr/s",
+           "walker ms", "speedup");
+    for (const string& file : files) {
+        InputBuffer input;
+        if (!readInput(file, input)) {
+            return 1;
+        }
+
+        TokenBuffer tokens;
+        tokens.tokenize(input, DEFAULT_LEXER_BACKEND, false);
+        Parser parser(tokens);
+        ParseTreeNode* root = parser.parse();
+        if (!root) {
+            printf("%-28s %8s\n", file.c_str(), "(syntax error)");
+            continue;
+        }
+        BytecodeCompiler compiler;
+        BytecodeProgram program;
+        if (!compiler.compile(root, parser.getSymbols(), &tokens, program)) {
+            printf("%-28s %8s\n", file.c_str(), "(semantic error)");
+            continue;
+        }
+
+        Interpreter interpreter;
+        TreeWalker walker(parser.getSymbols());
+        bool ok = interpreter.run(program, &tokens);
+        if (ok != walker.run(root) || (ok && !sameState(program, interpreter, walker))) {
+            fprintf(stderr, "MISMATCH %s\n", file.c_str());
+            status = 1;
+        }
+        if (!ok) {
+            fprintf(stderr, "%s: %s\n", file.c_str(), interpreter.getError().c_str());
+        }
+
+        double vmSeconds = bestSeconds(runs, [&] { interpreter.run(program, &tokens); });
+        double walkerSeconds = bestSeconds(runs, [&] { walker.run(root); });
+        double rate = vmSeconds > 0 ? interpreter.instructions() / vmSeconds / 1e6 : 0.0;
+        printf("%-28s %8zu %14llu %10.2f %12.1f %12.2f %9.1fx\n", file.c_str(), program.code.size(),
+               static_cast<unsigned long long>(interpreter.instructions()), vmSeconds * 1e3, rate,
+               walkerSeconds * 1e3, vmSeconds > 0 ? walkerSeconds / vmSeconds : 0.0);
+    }
+    return status;
+}
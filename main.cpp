@@ -1,75 +1,469 @@
 #include "Parser.h"
+#include "Batch.h"
+#include "Server.h"
+#include "ThreadPool.h"
+#include "GraphvizWriter.h"
+#include "Semantic.h"
+#include "Bytecode.h"
+#include "Interpreter.h"
+#include "TreeFile.h"
+#include "Stats.h"
 #include <iostream>
-#include <fstream>
 #include <cstdio>
+#include <cstdlib>
+#include <cinttypes>
+#include <chrono>
+#include <memory>
+#include <vector>
 
 using namespace std;
 
-void generateGraphviz(shared_ptr<ParseTreeNode> root, const string& filename) {
-    ofstream out(filename);
-    if (!out.is_open()) {
-        cerr << "Error: Could not open file '" << filename << "' for writing\n";
+void generateGraphviz(ParseTreeNode* root, const StringInterner& symbols, const string& filename,
+                      DotOutputMode mode) {
+    if (!writeGraphviz(root, symbols, filename, mode)) {
+        cerr << "Error: Could not write file '" << filename << "'\n";
         return;
     }
 
-    // Assign unique IDs to all nodes
-    ParseTreeNode::nodeCounter = 0;
-    root->assignIds();
+    cout << "Parse tree saved to: " << filename << endl;
+    cout << "To visualize: dot -Tpng " << filename << " -o parse_tree.png" << endl;
+}
 
-    // Write Graphviz header
-    out << "digraph ParseTree {\n";
-    out << "  node [shape=box, fontname=\"Arial\"];\n";
-    out << "  edge [fontname=\"Arial\"];\n\n";
+void saveTreeFile(ParseTreeNode* root, const StringInterner& symbols, const string& filename,
+                  const ParserOptions& options) {
+    uint32_t flags = options.flattenLists ? TREE_FILE_FLAT_LISTS : 0;
+    if (!writeTreeFile(root, symbols, filename, flags)) {
+        cerr << "Error: Could not write file '" << filename << "'\n";
+        return;
+    }
 
-    // Generate nodes and edges
-    root->toGraphviz(out);
+    cout << "Parse tree saved to: " << filename << endl;
+}
+
+void generateAstGraphviz(AstNode* root, const StringInterner& symbols, const string& filename,
+                         DotOutputMode mode) {
+    if (!writeAstGraphviz(root, symbols, filename, mode)) {
+        cerr << "Error: Could not write file '" << filename << "'\n";
+        return;
+    }
 
-    // Write footer
-    out << "}\n";
+    cout << "AST saved to: " << filename << endl;
+    cout << "To visualize: dot -Tpng " << filename << " -o ast.png" << endl;
+}
 
-    out.close();
-    cout << "Parse tree saved to: " << filename << endl;
-    cout << "To visualize: dot -Tpng " << filename << " -o parse_tree.png" << endl;
+// Write whichever tree was built (the AST is always written as .dot)
+void writeOutput(const Parser& parser, ParseTreeNode* parseTree, AstNode* ast, const string& filename,
+                 const ParserOptions& options, bool emitBinary, DotOutputMode dotMode) {
+    if (ast) {
+        generateAstGraphviz(ast, parser.getSymbols(), filename, dotMode);
+    } else if (emitBinary) {
+        saveTreeFile(parseTree, parser.getSymbols(), filename, options);
+    } else {
+        generateGraphviz(parseTree, parser.getSymbols(), filename, dotMode);
+    }
+}
+
+// Print a variable's final value; arrays show their first elements
+static void printVariable(const VariableInfo& variable, const BytecodeProgram& program,
+                          const Interpreter& interpreter, const StringInterner& symbols) {
+    auto format = [&](Value value) {
+        char text[32];
+        if (variable.type == TYPE_INT) {
+            snprintf(text, sizeof(text), "%" PRId64, value.i);
+        } else {
+            snprintf(text, sizeof(text), "%.9g", value.f);
+        }
+        return string(text);
+    };
+    static const uint32_t SHOWN_ELEMENTS = 8;
+
+    cout << (variable.type == TYPE_INT ? "int " : "float ") << symbols.str(variable.symbol);
+    if (!variable.isArray) {
+        cout << " = " << format(interpreter.getFrame()[variable.slot]) << "\n";
+        return;
+    }
+    const ArrayInfo& array = program.arrays[variable.slot];
+    cout << "[" << array.size << "] = {";
+    for (uint32_t i = 0; i < array.size && i < SHOWN_ELEMENTS; i++) {
+        cout << (i > 0 ? ", " : "") << format(interpreter.getArrays()[array.base + i]);
+    }
+    cout << (array.size > SHOWN_ELEMENTS ? ", ...}\n" : "}\n");
+}
+
+// Compile the tree to bytecode, run it and report the variables and the
+// instruction rate
+static int runBytecode(const Parser& parser, const ParseTreeNode* tree, const TokenBuffer& tokens,
+                       bool showBytecode) {
+    auto start = chrono::steady_clock::now();
+    BytecodeCompiler compiler;
+    BytecodeProgram program;
+    if (!compiler.compile(tree, parser.getSymbols(), &tokens, program)) {
+        for (const Diagnostic& d : compiler.getDiagnostics()) {
+            cerr << d.message << endl;
+        }
+        return 1;
+    }
+    double compileSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (showBytecode) {
+        program.disassemble(cout);
+        cout << "\n";
+    }
+
+    Interpreter interpreter;
+    start = chrono::steady_clock::now();
+    bool ok = interpreter.run(program, &tokens);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (!ok) {
+        cerr << interpreter.getError() << endl;
+    }
+    for (const VariableInfo& variable : program.variables) {
+        printVariable(variable, program, interpreter, parser.getSymbols());
+    }
+    cout << "\nCompiled " << program.code.size() << " instructions in " << compileSeconds * 1000 << " ms\n";
+    cout << "Executed " << interpreter.instructions() << " instructions in " << seconds * 1000 << " ms ("
+         << (seconds > 0 ? interpreter.instructions() / seconds / 1e6 : 0.0) << " M instructions/s, "
+         << (Interpreter::threaded() ? "threaded" : "switch") << " dispatch)\n";
+    return ok ? 0 : 1;
+}
+
+void printUsage(const char* prog) {
+    cerr << "Usage: " << prog << " [options] <input_file> [output_file]\n";
+    cerr << "Example: " << prog << " tests/test_input.c parse_tree.dot\n";
+    cerr << "\nOptions:\n";
+    cerr << "  --check         Only check the syntax: build no tree and write no output file\n";
+    cerr << "  --semantic      Also check declarations, array sizes and indexing (lexes first)\n";
+    cerr << "  --run           Compile to bytecode and run it: print the variables and the instruction rate\n";
+    cerr << "                  (lexes first; no output file)\n";
+    cerr << "  --bytecode      With --run, print the bytecode listing first\n";
+    cerr << "  --flat-lists    Build list rules as one node per list instead of ' chains\n";
+    cerr << "  --ast           Build an abstract syntax tree instead of the parse tree (.dot output)\n";
+    cerr << "  --ll1           Parse with the generated LL(1) tables instead of recursive descent\n";
+    cerr << "  --parallel      Lex first, then parse the top-level statements on --jobs=N threads\n";
+    cerr << "  --stream        Read input through stdio instead of memory-mapping it\n";
+    cerr << "  --tokens        Lex the whole input into a token buffer before parsing\n";
+    cerr << "  --emit=FORMAT   Output format: dot (Graphviz, default) or bin (binary .ptree)\n";
+    cerr << "  --dot-mmap      Write the .dot file through a shared memory mapping\n";
+    cerr << "  --lexer=NAME    Scanner backend: flex or hand (default: "
+         << lexerBackendName(DEFAULT_LEXER_BACKEND) << ")\n";
+    cerr << "  --max-errors=N  Recover from syntax errors and report up to N of them (default: 1)\n";
+    cerr << "  --stats[=json]  Print phase times, token/node counts and memory use to stderr\n";
+    cerr << "                  (needs a build with make STATS=1)\n";
+    cerr << "\nBatch mode (no .dot output, one status line per file):\n";
+    cerr << "  " << prog << " --batch [--jobs=N] <input_file>...\n";
+    cerr << "  " << prog << " --file-list=<list_file> [--jobs=N] [<input_file>...]\n";
+    cerr << "  --cache-dir=DIR   Reuse results of unchanged inputs from an on-disk cache\n";
+    cerr << "  --cache-size=MB   Evict least recently used entries beyond this size (default: 256)\n";
+    cerr << "  --cache-trees     Also store each parsed tree in the cache as a .ptree file\n";
+    cerr << "\nServer mode (framed requests, see Server.h; parsers stay warm between requests):\n";
+    cerr << "  " << prog << " --serve [--jobs=N]          Serve requests on stdin, respond on stdout\n";
+    cerr << "  " << prog << " --socket=PATH [--jobs=N]    Serve connections on a Unix domain socket\n";
 }
 
 int main(int argc, char** argv) {
-    if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <input_file> [output_dot_file]\n";
-        cerr << "Example: " << argv[0] << " tests/test_input.c parse_tree.dot\n";
+    ParserOptions options;
+    vector<string> positional;
+    bool batchMode = false;
+    bool useMmap = true;
+    bool lexFirst = false;
+    DotOutputMode dotMode = DOT_WRITE;
+    bool emitBinary = false;
+    bool buildAst = false;
+    unsigned jobs = 0;
+    string cacheDir;
+    uint64_t cacheMegabytes = 256;
+    bool cacheTrees = false;
+    bool printStats = false;
+    bool statsJson = false;
+    bool parallel = false;
+    bool checkOnly = false;
+    bool semantic = false;
+    bool runProgram = false;
+    bool showBytecode = false;
+    bool serveStdio = false;
+    string socketPath;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--flat-lists") {
+            options.flattenLists = true;
+        } else if (arg == "--ast") {
+            buildAst = true;
+        } else if (arg == "--ll1") {
+            options.tableDriven = true;
+        } else if (arg == "--check") {
+            checkOnly = true;
+        } else if (arg == "--semantic") {
+            semantic = true;
+        } else if (arg == "--run") {
+            runProgram = true;
+        } else if (arg == "--bytecode") {
+            runProgram = true;
+            showBytecode = true;
+        } else if (arg == "--parallel") {
+            parallel = true;
+        } else if (arg == "--stream") {
+            useMmap = false;
+        } else if (arg == "--tokens") {
+            lexFirst = true;
+        } else if (arg.compare(0, 7, "--emit=") == 0) {
+            string format = arg.substr(7);
+            if (format != "dot" && format != "bin") {
+                cerr << "Error: Unknown output format '" << format << "'\n";
+                return 1;
+            }
+            emitBinary = format == "bin";
+        } else if (arg == "--dot-mmap") {
+            dotMode = DOT_MMAP;
+        } else if (arg.compare(0, 8, "--lexer=") == 0) {
+            if (!parseLexerBackend(arg.c_str() + 8, options.lexerBackend)) {
+                cerr << "Error: Unknown or unavailable lexer '" << arg.substr(8) << "'\n";
+                return 1;
+            }
+        } else if (arg.compare(0, 13, "--max-errors=") == 0) {
+            long count = atol(arg.c_str() + 13);
+            if (count < 1) {
+                cerr << "Error: --max-errors needs a positive count\n";
+                return 1;
+            }
+            options.maxErrors = static_cast<unsigned>(count);
+        } else if (arg == "--stats" || arg == "--stats=text" || arg == "--stats=json") {
+            if (!statsAvailable()) {
+                cerr << "Error: --stats needs a build with statistics (make STATS=1)\n";
+                return 1;
+            }
+            printStats = true;
+            statsJson = arg == "--stats=json";
+        } else if (arg == "--batch") {
+            batchMode = true;
+        } else if (arg.compare(0, 12, "--file-list=") == 0) {
+            batchMode = true;
+            if (!readFileList(arg.substr(12), positional)) {
+                cerr << "Error: Cannot open file list '" << arg.substr(12) << "'\n";
+                return 1;
+            }
+        } else if (arg.compare(0, 7, "--jobs=") == 0) {
+            jobs = static_cast<unsigned>(atoi(arg.c_str() + 7));
+        } else if (arg.compare(0, 12, "--cache-dir=") == 0) {
+            cacheDir = arg.substr(12);
+        } else if (arg.compare(0, 13, "--cache-size=") == 0) {
+            cacheMegabytes = strtoull(arg.c_str() + 13, nullptr, 10);
+        } else if (arg == "--cache-trees") {
+            cacheTrees = true;
+        } else if (arg == "--serve") {
+            serveStdio = true;
+        } else if (arg.compare(0, 9, "--socket=") == 0) {
+            socketPath = arg.substr(9);
+        } else if (arg.compare(0, 2, "--") == 0) {
+            cerr << "Error: Unknown option '" << arg << "'\n";
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (options.tableDriven && (buildAst || options.maxErrors > 1)) {
+        cerr << "Error: --ll1 cannot be combined with --ast or --max-errors\n";
+        return 1;
+    }
+
+    if (parallel) {
+        if (buildAst || options.tableDriven || options.maxErrors > 1 || batchMode || serveStdio ||
+            !socketPath.empty()) {
+            cerr << "Error: --parallel cannot be combined with --ast, --ll1, --max-errors, batch or server mode\n";
+            return 1;
+        }
+        // Chunks are cut from the token buffer
+        options.jobs = jobs == 0 ? WorkStealingPool::hardwareThreads() : jobs;
+        lexFirst = true;
+    }
+
+    if (serveStdio || !socketPath.empty()) {
+        // Per-request options come with each request
+        if (batchMode || printStats || !positional.empty() || (serveStdio && !socketPath.empty())) {
+            cerr << "Error: --serve and --socket take no input files and no batch or --stats options\n";
+            return 1;
+        }
+        return serveStdio ? serveStream(0, 1, jobs, options.lexerBackend)
+                          : serveSocket(socketPath, jobs, options.lexerBackend);
+    }
+
+    if (batchMode) {
+        if (printStats) {
+            cerr << "Error: --stats is not available in batch mode\n";
+            return 1;
+        }
+        if (positional.empty()) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        unique_ptr<ParseCache> cache;
+        if (!cacheDir.empty()) {
+            cache.reset(new ParseCache(cacheDir, cacheMegabytes * 1024 * 1024, cacheTrees));
+            if (!cache->open()) {
+                cerr << "Error: Cannot use cache directory '" << cacheDir << "'\n";
+                return 1;
+            }
+        }
+        return runBatch(positional, options, jobs, useMmap, cache.get());
+    }
+
+    if (positional.empty() || positional.size() > 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (buildAst && emitBinary) {
+        cerr << "Error: --ast output is only available as .dot\n";
         return 1;
     }
 
-    string inputFile = argv[1];
-    string outputFile = (argc >= 3) ? argv[2] : "parse_tree.dot";
+    if (checkOnly && (buildAst || positional.size() > 1)) {
+        cerr << "Error: --check builds no tree and takes no output file\n";
+        return 1;
+    }
+
+    if (semantic) {
+        if (buildAst || checkOnly) {
+            cerr << "Error: --semantic checks the parse tree; not available with --ast or --check\n";
+            return 1;
+        }
+        // Error positions come from the token buffer
+        lexFirst = true;
+    }
+
+    if (runProgram) {
+        if (buildAst || checkOnly || positional.size() > 1) {
+            cerr << "Error: --run needs the parse tree and takes no output file; not available with --ast or --check\n";
+            return 1;
+        }
+        // Error positions come from the token buffer
+        lexFirst = true;
+    }
+
+    string inputFile = positional[0];
+    string outputFile = (positional.size() >= 2) ? positional[1]
+                                                  : (emitBinary ? "parse_tree.ptree" : "parse_tree.dot");
+
+    // Phase timers and counters for --stats (no-ops unless built with them)
+    StatsReport stats;
 
-    // Open input file
-    FILE* file = fopen(inputFile.c_str(), "r");
-    if (!file) {
+    // Open input file (memory-mapped unless --stream or not a regular file)
+    SourceFile source;
+    stats.begin(PHASE_OPEN);
+    if (!source.open(inputFile, useMmap)) {
         cerr << "Error: Cannot open file '" << inputFile << "'\n";
         return 1;
     }
+    stats.end(PHASE_OPEN);
 
-    cout << "=============================================================\n";
-    cout << "           Parser for C- Language (Enhanced Grammar)\n";
-    cout << "=============================================================\n\n";
-    cout << "Input file: " << inputFile << "\n";
-    cout << "Output file: " << outputFile << "\n\n";
+    if (!checkOnly && !runProgram) {
+        cout << "=============================================================\n";
+        cout << "           Parser for C- Language (Enhanced Grammar)\n";
+        cout << "=============================================================\n\n";
+        cout << "Input file: " << inputFile << "\n";
+        cout << "Output file: " << outputFile << "\n\n";
+    }
 
-    // Set lexer input
-    yyin = file;
+    // Create parser and parse. By default the parser owns a lexer reading
+    // the input; with --tokens the input is lexed completely first.
+    InputBuffer streamed;
+    TokenBuffer tokenBuffer;
+    unique_ptr<Parser> parserPtr;
+    double lexSeconds = 0;
 
-    // Create parser and parse
-    Parser parser;
-    auto parseTree = parser.parse();
+    if (lexFirst) {
+        if (!source.isMapped() && !streamed.readStream(source.file())) {
+            cerr << "Error: Cannot read file '" << inputFile << "'\n";
+            return 1;
+        }
+        const InputBuffer& input = source.isMapped() ? source.buffer() : streamed;
 
-    fclose(file);
+        auto lexStart = chrono::steady_clock::now();
+        stats.begin(PHASE_LEX);
+        if (!tokenBuffer.tokenize(input, options.lexerBackend)) {
+            cerr << "Error: Input is too large for --tokens (4 GB limit)\n";
+            return 1;
+        }
+        stats.end(PHASE_LEX);
+        lexSeconds = chrono::duration<double>(chrono::steady_clock::now() - lexStart).count();
+        parserPtr.reset(new Parser(tokenBuffer, options));
+    } else if (source.isMapped()) {
+        parserPtr.reset(new Parser(source.buffer(), options));
+    } else {
+        parserPtr.reset(new Parser(source.file(), options));
+    }
+
+    Parser& parser = *parserPtr;
+    auto parseStart = chrono::steady_clock::now();
+    ParseTreeNode* parseTree = nullptr;
+    AstNode* ast = nullptr;
+    bool valid = false;
+    stats.begin(PHASE_PARSE);
+    if (checkOnly) {
+        valid = parser.check();
+    } else if (buildAst) {
+        ast = parser.parseAst();
+    } else {
+        parseTree = parser.parse();
+    }
+    stats.end(PHASE_PARSE);
+    bool haveTree = parseTree || ast;
+    double parseSeconds = chrono::duration<double>(chrono::steady_clock::now() - parseStart).count();
+
+    // --check: the exit status and the errors, nothing else
+    if (checkOnly) {
+        for (const Diagnostic& d : parser.getDiagnostics()) {
+            cerr << d.message << endl;
+        }
+        if (options.maxErrors > 1 && parser.reachedErrorLimit()) {
+            cerr << "Too many errors, stopped after " << options.maxErrors << endl;
+        }
+        if (printStats) {
+            stats.collect(parser, lexFirst ? &tokenBuffer : nullptr, nullptr, nullptr);
+            stats.print(cerr, statsJson);
+        }
+        return valid ? 0 : 1;
+    }
+
+    // --run: the program's results and the execution rate
+    if (runProgram) {
+        if (parser.hadError() || !parseTree) {
+            for (const Diagnostic& d : parser.getDiagnostics()) {
+                cerr << d.message << endl;
+            }
+            return 1;
+        }
+        return runBytecode(parser, parseTree, tokenBuffer, showBytecode);
+    }
+
+    if (lexFirst) {
+        cout << "Lexed " << tokenBuffer.size() << " tokens in " << lexSeconds * 1000 << " ms, "
+             << "parsed in " << parseSeconds * 1000 << " ms\n";
+    }
 
     // Check for errors
-    if (parser.hadError() || !parseTree) {
+    if (parser.hadError() || !haveTree) {
         cout << "\n=============================================================\n";
         cout << "                    PARSING FAILED\n";
         cout << "=============================================================\n\n";
-        cerr << parser.getErrorMessage() << endl;
+        for (const Diagnostic& d : parser.getDiagnostics()) {
+            cerr << d.message << endl;
+        }
+        if (options.maxErrors > 1 && parser.reachedErrorLimit()) {
+            cerr << "Too many errors, stopped after " << options.maxErrors << endl;
+        }
+
+        // With recovery the partial tree (error nodes included) is written
+        if (haveTree) {
+            stats.begin(PHASE_OUTPUT);
+            writeOutput(parser, parseTree, ast, outputFile, options, emitBinary, dotMode);
+            stats.end(PHASE_OUTPUT);
+        }
+        if (printStats) {
+            stats.collect(parser, lexFirst ? &tokenBuffer : nullptr, parseTree, ast);
+            stats.print(cerr, statsJson);
+        }
         return 1;
     }
 
@@ -78,8 +472,28 @@ int main(int argc, char** argv) {
     cout << "                  PARSING SUCCESSFUL\n";
     cout << "=============================================================\n\n";
 
-    // Generate Graphviz output
-    generateGraphviz(parseTree, outputFile);
+    // Declarations and uses; the tree is written either way
+    bool semanticOk = true;
+    if (semantic) {
+        auto start = chrono::steady_clock::now();
+        SemanticChecker checker;
+        semanticOk = checker.check(parseTree, parser.getSymbols(), &tokenBuffer);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Checked " << checker.declarations() << " declarations and " << checker.uses()
+             << " uses in " << seconds * 1000 << " ms: " << checker.getDiagnostics().size() << " errors\n\n";
+        for (const Diagnostic& d : checker.getDiagnostics()) {
+            cerr << d.message << endl;
+        }
+    }
+
+    // Generate Graphviz or binary output
+    stats.begin(PHASE_OUTPUT);
+    writeOutput(parser, parseTree, ast, outputFile, options, emitBinary, dotMode);
+    stats.end(PHASE_OUTPUT);
 
-    return 0;
+    if (printStats) {
+        stats.collect(parser, lexFirst ? &tokenBuffer : nullptr, parseTree, ast);
+        stats.print(cerr, statsJson);
+    }
+    return semanticOk ? 0 : 1;
 }
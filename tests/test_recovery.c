@@ -0,0 +1,14 @@
+Program Recovery {
+    int a;
+    int b c;
+    float d[;
+    int y
+    x = 1 +
+    a = 2
+    if (a < ) b = 1
+    while (a > 1 { a = a - 1 }
+    c = (3 + )
+    b = 4 5
+    { d = 1 + }
+    a = a *
+} end
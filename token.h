@@ -48,19 +48,49 @@ typedef enum {
     ERROR
 } TokenType;
 
+/*
+ * Per-scanner lexer state. Every reentrant flex scanner carries one of
+ * these as its extra data, so several scanners can run side by side.
+ *
+ * The token text is not copied: token_text points either into the input
+ * buffer (in-place scanning), into flex's own buffer (stream input, valid
+ * until the next yylex call) or at a static keyword spelling. Offsets and
+ * positions are 64-bit so inputs larger than 2 GB are tracked correctly.
+ */
+typedef struct LexerState {
+    const char* token_text;     /* Text of the last token, not NUL-terminated */
+    size_t token_length;
+    size_t token_offset;        /* Byte offset of the last matched text */
+    size_t offset;              /* Bytes consumed so far */
+    long long line_num;         /* Position after the last token */
+    long long col_num;
+    long long comment_start_line;
+    long long comment_start_col;
+    int print_errors;           /* Echo lexical errors to stderr */
+    char error_message[256];    /* Last lexical error, "" if none */
+} LexerState;
+
 /* External declarations from lexer */
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* Flex-generated declarations */
-extern int yylex(void);
-extern FILE* yyin;
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+
+struct yy_buffer_state;
+
+/* Flex-generated declarations (reentrant scanner) */
+extern int yylex(yyscan_t yyscanner);
+extern int yylex_init_extra(LexerState* user_defined, yyscan_t* scanner);
+extern int yylex_destroy(yyscan_t yyscanner);
+extern void yyset_in(FILE* in_str, yyscan_t yyscanner);
+extern struct yy_buffer_state* yy_scan_buffer(char* base, size_t size, yyscan_t yyscanner);
 
-/* Our custom declarations */
-extern char token_lexeme[256];
-extern int line_num;
-extern int col_num;
+/* Reset position tracking and error state (defined in Lexer.cpp) */
+extern void lexer_state_init(LexerState* state);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,426 @@
+// LL(1) table generator: reads grammar_enhanced.ebnf, computes the FIRST
+// and FOLLOW sets, reports LL(1) conflicts and writes the predictive parse
+// table used by Parser::parseTable() (TableParser.cpp) as a header of
+// constexpr arrays.
+//
+// Usage: ll1_gen <grammar.ebnf> <output.h>
+//
+// Grammar format: one rule per line, "name ::= alt | alt ...", '#' starts
+// a comment line. In an alternative, "quoted" symbols and bare names that
+// have no rule of their own are terminals, "empty" is the empty string.
+// Terminals are mapped to their TokenType by spelling (see TERMINALS),
+// rule names to RuleId by spelling ("var-declaration'" is
+// RULE_VAR_DECLARATION_PRIME); the generated header checks both against
+// the enums when it is compiled.
+//
+// A FIRST/FOLLOW conflict between an empty and a non-empty alternative
+// (the dangling else) is resolved in favour of the non-empty one, as the
+// recursive descent parser does, and reported as a warning. Any other
+// conflict is an error and no header is written.
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// TokenType enumerators in enum order (IF first) with their grammar
+// spelling; the column of a terminal in the table is its position here
+static const char* const TERMINALS[][2] = {
+    {"IF", "if"},        {"ELSE", "else"},     {"WHILE", "while"},  {"INT", "int"},
+    {"FLOAT", "float"},  {"RETURN", "return"}, {"VOID", "void"},    {"PROGRAM", "Program"},
+    {"ID", "ID"},        {"NUM", "NUM"},       {"PLUS", "+"},       {"MINUS", "-"},
+    {"TIMES", "*"},      {"DIVIDE", "/"},      {"LT", "<"},         {"LTE", "<="},
+    {"GT", ">"},         {"GTE", ">="},        {"EQ", "=="},        {"NEQ", "!="},
+    {"ASSIGN", "="},     {"SEMI", ";"},        {"COMMA", ","},      {"LPAREN", "("},
+    {"RPAREN", ")"},     {"LBRACKET", "["},    {"RBRACKET", "]"},   {"LBRACE", "{"},
+    {"RBRACE", "}"},     {"DOT", "."},         {"ENDOFFILE", nullptr}, {"ERROR", nullptr},
+};
+static const int TERMINAL_COUNT = sizeof(TERMINALS) / sizeof(TERMINALS[0]);
+static const int END_OF_FILE = TERMINAL_COUNT - 2;
+
+// A grammar symbol: terminal index into TERMINALS, or nonterminal index
+struct Symbol {
+    bool terminal;
+    int index;
+};
+
+struct Production {
+    int rule;
+    vector<Symbol> rhs;
+};
+
+struct Grammar {
+    vector<string> rules;                   // Nonterminal names, in file order
+    vector<Production> productions;
+    vector<vector<int>> ruleProductions;    // Productions of each rule
+};
+
+static string trim(const string& text) {
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == string::npos) {
+        return "";
+    }
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+static int terminalIndex(const string& spelling) {
+    for (int i = 0; i < TERMINAL_COUNT; i++) {
+        if (TERMINALS[i][1] && spelling == TERMINALS[i][1]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// "var-declaration'" -> "RULE_VAR_DECLARATION_PRIME"
+static string ruleEnumerator(const string& name) {
+    string out = "RULE_";
+    for (char c : name) {
+        if (c == '-') {
+            out += '_';
+        } else if (c == '\'') {
+            out += "_PRIME";
+        } else {
+            out += static_cast<char>(toupper(static_cast<unsigned char>(c)));
+        }
+    }
+    return out;
+}
+
+static bool readGrammar(const char* path, Grammar& grammar) {
+    ifstream in(path);
+    if (!in) {
+        fprintf(stderr, "ll1_gen: cannot open '%s'\n", path);
+        return false;
+    }
+
+    // First pass: rule names, so bare names can be told apart from terminals
+    vector<pair<string, string>> lines;
+    map<string, int> ruleIndex;
+    string line;
+    while (getline(in, line)) {
+        string text = trim(line);
+        size_t arrow = text.find("::=");
+        if (text.empty() || text[0] == '#' || arrow == string::npos) {
+            continue;
+        }
+        string name = trim(text.substr(0, arrow));
+        if (ruleIndex.count(name)) {
+            fprintf(stderr, "ll1_gen: rule '%s' defined twice\n", name.c_str());
+            return false;
+        }
+        ruleIndex[name] = static_cast<int>(grammar.rules.size());
+        grammar.rules.push_back(name);
+        lines.push_back(make_pair(name, text.substr(arrow + 3)));
+    }
+    grammar.ruleProductions.resize(grammar.rules.size());
+
+    for (const auto& rule : lines) {
+        int lhs = ruleIndex[rule.first];
+        Production current{lhs, {}};
+        istringstream words(rule.second);
+        string word;
+        bool sawEmpty = false;
+        auto finish = [&]() {
+            grammar.ruleProductions[lhs].push_back(static_cast<int>(grammar.productions.size()));
+            grammar.productions.push_back(current);
+            current.rhs.clear();
+            sawEmpty = false;
+        };
+        while (words >> word) {
+            if (word == "|") {
+                finish();
+                continue;
+            }
+            if (word == "empty") {
+                sawEmpty = true;
+                continue;
+            }
+            bool quoted = word.size() >= 2 && word.front() == '"' && word.back() == '"';
+            string spelling = quoted ? word.substr(1, word.size() - 2) : word;
+            if (!quoted && ruleIndex.count(spelling)) {
+                current.rhs.push_back(Symbol{false, ruleIndex[spelling]});
+                continue;
+            }
+            int terminal = terminalIndex(spelling);
+            if (terminal < 0) {
+                fprintf(stderr, "ll1_gen: %s: unknown terminal '%s'\n", rule.first.c_str(), spelling.c_str());
+                return false;
+            }
+            current.rhs.push_back(Symbol{true, terminal});
+        }
+        if (sawEmpty && !current.rhs.empty()) {
+            fprintf(stderr, "ll1_gen: %s: 'empty' mixed with other symbols\n", rule.first.c_str());
+            return false;
+        }
+        finish();
+    }
+    return !grammar.rules.empty();
+}
+
+typedef set<int> TerminalSet;
+
+struct Sets {
+    vector<bool> nullable;
+    vector<TerminalSet> first;
+    vector<TerminalSet> follow;
+};
+
+// FIRST of a symbol string; *nullable tells whether it can derive empty
+static TerminalSet firstOf(const vector<Symbol>& rhs, size_t from, const Sets& sets, bool* nullable) {
+    TerminalSet out;
+    for (size_t i = from; i < rhs.size(); i++) {
+        if (rhs[i].terminal) {
+            out.insert(rhs[i].index);
+            *nullable = false;
+            return out;
+        }
+        const TerminalSet& f = sets.first[rhs[i].index];
+        out.insert(f.begin(), f.end());
+        if (!sets.nullable[rhs[i].index]) {
+            *nullable = false;
+            return out;
+        }
+    }
+    *nullable = true;
+    return out;
+}
+
+static void computeSets(const Grammar& grammar, Sets& sets) {
+    size_t n = grammar.rules.size();
+    sets.nullable.assign(n, false);
+    sets.first.assign(n, TerminalSet());
+    sets.follow.assign(n, TerminalSet());
+    sets.follow[0].insert(END_OF_FILE);
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const Production& p : grammar.productions) {
+            bool nullable;
+            TerminalSet f = firstOf(p.rhs, 0, sets, &nullable);
+            size_t before = sets.first[p.rule].size();
+            sets.first[p.rule].insert(f.begin(), f.end());
+            if (sets.first[p.rule].size() != before || (nullable && !sets.nullable[p.rule])) {
+                sets.nullable[p.rule] = sets.nullable[p.rule] || nullable;
+                changed = true;
+            }
+        }
+    }
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const Production& p : grammar.productions) {
+            for (size_t i = 0; i < p.rhs.size(); i++) {
+                if (p.rhs[i].terminal) {
+                    continue;
+                }
+                TerminalSet& follow = sets.follow[p.rhs[i].index];
+                size_t before = follow.size();
+                bool restNullable;
+                TerminalSet rest = firstOf(p.rhs, i + 1, sets, &restNullable);
+                follow.insert(rest.begin(), rest.end());
+                if (restNullable) {
+                    follow.insert(sets.follow[p.rule].begin(), sets.follow[p.rule].end());
+                }
+                changed = changed || follow.size() != before;
+            }
+        }
+    }
+}
+
+static string productionText(const Grammar& grammar, const Production& p) {
+    string text = grammar.rules[p.rule] + " ::=";
+    if (p.rhs.empty()) {
+        text += " empty";
+    }
+    for (const Symbol& s : p.rhs) {
+        text += ' ';
+        text += s.terminal ? TERMINALS[s.index][1] : grammar.rules[s.index];
+    }
+    return text;
+}
+
+static string setText(const TerminalSet& set) {
+    string text;
+    for (int t : set) {
+        text += text.empty() ? "" : " ";
+        text += TERMINALS[t][1] ? TERMINALS[t][1] : TERMINALS[t][0];
+    }
+    return text;
+}
+
+static const int NO_PRODUCTION = 255;
+
+// Fill the table; returns false on a conflict that cannot be resolved
+static bool buildTable(const Grammar& grammar, const Sets& sets, vector<vector<int>>& table) {
+    table.assign(grammar.rules.size(), vector<int>(TERMINAL_COUNT, NO_PRODUCTION));
+    bool ok = true;
+    for (size_t index = 0; index < grammar.productions.size(); index++) {
+        const Production& p = grammar.productions[index];
+        bool nullable;
+        TerminalSet predict = firstOf(p.rhs, 0, sets, &nullable);
+        if (nullable) {
+            predict.insert(sets.follow[p.rule].begin(), sets.follow[p.rule].end());
+        }
+        for (int t : predict) {
+            int& cell = table[p.rule][t];
+            if (cell == NO_PRODUCTION) {
+                cell = static_cast<int>(index);
+                continue;
+            }
+            const Production& other = grammar.productions[cell];
+            bool otherEmpty = other.rhs.empty();
+            const char* name = TERMINALS[t][1] ? TERMINALS[t][1] : TERMINALS[t][0];
+            if (otherEmpty != p.rhs.empty()) {
+                const Production& kept = otherEmpty ? p : other;
+                fprintf(stderr, "ll1_gen: warning: LL(1) conflict in %s on '%s', resolved as %s\n",
+                        grammar.rules[p.rule].c_str(), name, productionText(grammar, kept).c_str());
+                if (otherEmpty) {
+                    cell = static_cast<int>(index);
+                }
+            } else {
+                fprintf(stderr, "ll1_gen: error: LL(1) conflict in %s on '%s': %s / %s\n",
+                        grammar.rules[p.rule].c_str(), name, productionText(grammar, other).c_str(),
+                        productionText(grammar, p).c_str());
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+static bool writeHeader(const char* path, const char* grammarPath, const Grammar& grammar, const Sets& sets,
+                        const vector<vector<int>>& table) {
+    if (grammar.productions.size() >= NO_PRODUCTION) {
+        fprintf(stderr, "ll1_gen: too many productions\n");
+        return false;
+    }
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "ll1_gen: cannot create '%s'\n", path);
+        return false;
+    }
+
+    fprintf(out, "// Generated by tools/ll1_gen from %s. Do not edit.\n\n", grammarPath);
+    fprintf(out, "#ifndef LL1TABLES_H\n#define LL1TABLES_H\n\n#include \"ParseTree.h\"\n#include <cstdint>\n\n");
+
+    fprintf(out, "/*\n * FIRST and FOLLOW sets\n *\n");
+    for (size_t r = 0; r < grammar.rules.size(); r++) {
+        fprintf(out, " * %s\n *   FIRST  = %s%s\n *   FOLLOW = %s\n", grammar.rules[r].c_str(),
+                setText(sets.first[r]).c_str(), sets.nullable[r] ? " empty" : "",
+                setText(sets.follow[r]).c_str());
+    }
+    fprintf(out, " */\n\n");
+
+    // The generator's numbering must be the enums' numbering
+    for (int t = 0; t < TERMINAL_COUNT; t++) {
+        fprintf(out, "static_assert(%s == IF + %d, \"TokenType order\");\n", TERMINALS[t][0], t);
+    }
+    for (size_t r = 0; r < grammar.rules.size(); r++) {
+        fprintf(out, "static_assert(%s == %zu, \"RuleId order\");\n", ruleEnumerator(grammar.rules[r]).c_str(), r);
+    }
+    fprintf(out, "static_assert(RULE_COUNT == %zu, \"every RuleId has a rule\");\n\n", grammar.rules.size());
+
+    fprintf(out, "const int LL1_TOKEN_COUNT = %d;\n", TERMINAL_COUNT);
+    fprintf(out, "const uint8_t LL1_NO_PRODUCTION = %d;\n", NO_PRODUCTION);
+    fprintf(out, "const RuleId LL1_START = %s;\n\n", ruleEnumerator(grammar.rules[0]).c_str());
+
+    fprintf(out, "// Right-hand sides back to back. A symbol below RULE_COUNT is a RuleId,\n"
+                 "// any other a TokenType.\n");
+    fprintf(out, "constexpr uint16_t LL1_SYMBOLS[] = {\n");
+    size_t symbolCount = 0;
+    for (const Production& p : grammar.productions) {
+        for (const Symbol& s : p.rhs) {
+            fprintf(out, "    %s,\n", s.terminal ? TERMINALS[s.index][0] : ruleEnumerator(grammar.rules[s.index]).c_str());
+            symbolCount++;
+        }
+    }
+    if (symbolCount == 0) {
+        fprintf(out, "    0,\n");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "struct LL1Production {\n    uint8_t rule;\n    uint8_t length;     // 0 for empty\n"
+                 "    uint16_t first;     // Index of the first symbol in LL1_SYMBOLS\n};\n\n");
+    fprintf(out, "constexpr LL1Production LL1_PRODUCTIONS[] = {\n");
+    size_t first = 0;
+    for (size_t i = 0; i < grammar.productions.size(); i++) {
+        const Production& p = grammar.productions[i];
+        fprintf(out, "    {%s, %zu, %zu},  // %zu: %s\n", ruleEnumerator(grammar.rules[p.rule]).c_str(), p.rhs.size(),
+                first, i, productionText(grammar, p).c_str());
+        first += p.rhs.size();
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "// Production to expand a rule with, by lookahead token (column = TokenType - IF)\n");
+    fprintf(out, "constexpr uint8_t LL1_TABLE[RULE_COUNT][LL1_TOKEN_COUNT] = {\n");
+    for (size_t r = 0; r < grammar.rules.size(); r++) {
+        fprintf(out, "    {");
+        for (int t = 0; t < TERMINAL_COUNT; t++) {
+            fprintf(out, "%s%d", t ? ", " : "", table[r][t]);
+        }
+        fprintf(out, "},  // %s\n", grammar.rules[r].c_str());
+    }
+    fprintf(out, "};\n\n");
+
+    // A rule without a choice is expanded whatever the lookahead, and a
+    // rule with an empty alternative takes it when nothing else matches,
+    // so errors surface at the same token as in the recursive parser
+    fprintf(out, "// Production taken when the lookahead has no entry, LL1_NO_PRODUCTION\n"
+                 "// for a syntax error\n");
+    fprintf(out, "constexpr uint8_t LL1_DEFAULT[RULE_COUNT] = {\n");
+    for (size_t r = 0; r < grammar.rules.size(); r++) {
+        const vector<int>& alternatives = grammar.ruleProductions[r];
+        int fallback = alternatives.size() == 1 ? alternatives[0] : NO_PRODUCTION;
+        for (int p : alternatives) {
+            if (grammar.productions[p].rhs.empty()) {
+                fallback = p;
+            }
+        }
+        fprintf(out, "    %d,  // %s\n", fallback, grammar.rules[r].c_str());
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "// Right-recursive list tails (a production ends in the rule itself),\n"
+                 "// merged into their owner with ParserOptions::flattenLists\n");
+    fprintf(out, "constexpr bool LL1_LIST_RULE[RULE_COUNT] = {\n");
+    for (size_t r = 0; r < grammar.rules.size(); r++) {
+        bool list = false;
+        for (int p : grammar.ruleProductions[r]) {
+            const vector<Symbol>& rhs = grammar.productions[p].rhs;
+            list = list || (!rhs.empty() && !rhs.back().terminal && rhs.back().index == static_cast<int>(r));
+        }
+        fprintf(out, "    %s,  // %s\n", list ? "true" : "false", grammar.rules[r].c_str());
+    }
+    fprintf(out, "};\n\n#endif /* LL1TABLES_H */\n");
+
+    return fclose(out) == 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <grammar.ebnf> <output.h>\n", argv[0]);
+        return 1;
+    }
+
+    Grammar grammar;
+    if (!readGrammar(argv[1], grammar)) {
+        return 1;
+    }
+    Sets sets;
+    computeSets(grammar, sets);
+
+    vector<vector<int>> table;
+    if (!buildTable(grammar, sets, table)) {
+        return 1;
+    }
+    return writeHeader(argv[2], argv[1], grammar, sets, table) ? 0 : 1;
+}